@@ -1,44 +1,206 @@
 #include "benchmark.h"
 #include "board.h"
 #include "chess_ai.h"
+#include "nnue.h"
+#include "bitbase.h"
 #include <iostream>
 #include <chrono>
 #include <vector>
 #include <string>
 #include <iomanip>
+#include <iterator>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 
-struct BenchmarkPosition {
-    std::string name;
-    std::string fen;
+// Taken during static initialisation, so startup time covers everything main() does first
+static const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+
+static long long peakRssMB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return (long long)(pmc.PeakWorkingSetSize / (1024 * 1024));
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024 * 1024); // Bytes on macOS
+#else
+    return usage.ru_maxrss / 1024;          // Kilobytes on Linux
+#endif
+#endif
+}
+
+// Fixed bench set: the classic test positions, ten openings sampled every nine moves of a
+// depth-5 self-play game, and a few endgames. Changing it changes the bench signature.
+static const BenchmarkPosition BENCH_POSITIONS[] = {
+    {"Start Position", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"},
+    {"Kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
+    {"Middlegame", "r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/2N2N2/PPPP1PPP/R1BQK2R w KQkq - 6 5"},
+    {"Endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"},
+    {"Perft 4", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"},
+    {"Perft 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"},
+    {"Ruy Lopez 6", "r2qkbnr/1pp2ppp/p1p5/4p3/4P1b1/5N1P/PPPP1PP1/RNBQ1RK1 b kq - 0 6"},
+    {"Ruy Lopez 15", "r2q1rk1/1pp3pp/p1p5/4RP2/3P4/7P/PPP2P2/R1BQ2K1 b - - 0 15"},
+    {"Ruy Lopez 24", "3r2k1/1p3rpp/p1p5/2R2P2/1q1P4/1PP1B2P/P3QP2/4R1K1 b - - 0 24"},
+    {"Ruy Lopez 33", "4rk2/1p1r3p/p1p1RB2/5PR1/3P4/1PP4P/P7/6K1 b - - 0 33"},
+    {"QGD 6", "rnbqk2r/ppp2ppp/3B1n2/3p4/3P4/2N5/PP2PPPP/R2QKBNR b KQkq - 0 6"},
+    {"QGD 15", "r4rk1/pp3ppp/3q1n2/1p1p1Q2/1P1P4/2N2P1P/1P3PP1/2KR3R b - - 0 15"},
+    {"QGD 24", "4r1k1/pp3ppp/8/1p1Q4/1P1P2P1/5P2/KPq2P2/5R2 b - - 6 24"},
+    {"QGD 33", "8/R5pk/5p2/1p5P/1P6/3r1P2/KP3P2/8 b - - 4 33"},
+    {"Sicilian 7", "rn1qkb1r/pp1B1ppp/3p1n2/4p3/3NP3/2N5/PPP2PPP/R1BQK2R b KQkq - 0 7"},
+    {"Sicilian 16", "r3k3/pp3p1p/2n5/8/3Bp3/8/PPP2PrP/2KR3R b q - 2 16"},
+    {"Sicilian 25", "2k5/p7/1p6/5p2/1P2p1np/4B3/P1P1KP1r/6R1 b - - 1 25"},
+    {"Sicilian 34", "2k5/p7/1p6/1P6/4p3/6K1/P1P1rp1p/7R b - - 1 34"},
+    {"King's Indian 7", "rnbqk2r/ppp2pbp/5np1/4p3/2P1P3/2NB1N2/PP3PPP/R1BQK2R b KQkq - 1 7"},
+    {"King's Indian 16", "1rbqNrk1/pp3pb1/2p3pp/8/2PpPQ2/3B4/PP3PPP/R4RK1 b - - 3 16"},
+    {"King's Indian 25", "4r1k1/5pb1/2Q3pp/2P5/4P3/8/P1b2PPP/6K1 b - - 0 25"},
+    {"King's Indian 34", "8/5p1k/2P1b1p1/4b2p/5P2/3Q2P1/5K1P/r7 b - - 0 34"},
+    {"French 6", "rnbqk1nr/ppp2p1p/4p1p1/3pP3/3P2Q1/2P5/P1P2PPP/R1B1KBNR b KQkq - 0 6"},
+    {"French 15", "r1bqr1k1/ppp2p2/6pQ/3pPpNp/2nP4/B1P5/P1P2PPP/R4RK1 b - - 3 15"},
+    {"French 24", "3rr1k1/p4p2/1pp3p1/1n1pPb1p/3P1Q2/1RP5/P1P2PPP/2R3K1 b - - 3 24"},
+    {"French 33", "3rr1k1/1R3p2/p3n1pQ/3pPb1p/p1pP4/2P2P2/1RP3PP/6K1 b - - 1 33"},
+    {"English 6", "rnbq1rk1/ppp2ppp/3b1n2/3Pp3/3P4/2N3P1/PP2PPBP/R1BQK1NR b KQ - 2 6"},
+    {"English 15", "r1b2rk1/pp1n1ppp/5n2/3p4/4pB2/2N1P1P1/PP3PBP/3R1RK1 b - - 0 15"},
+    {"English 24", "2r3k1/rp1n1ppp/3Rb3/3p4/4p3/2N1P1P1/PP3P1P/2R2BK1 b - - 2 24"},
+    {"English 33", "3r2k1/1p4p1/4b3/1B1pnp2/3Np2p/P3P1PP/1P3PK1/3R4 b - - 1 33"},
+    {"Caro-Kann 6", "r2qkbnr/pp2pppp/n1p5/3pP3/3P4/3Q1N2/PPP2PPP/RNB1K2R b KQkq - 2 6"},
+    {"Caro-Kann 15", "r3kbnr/ppq1p1pp/2p5/4P3/1P2Q3/2P5/P4PPP/RNB2RK1 b kq - 0 15"},
+    {"Caro-Kann 24", "1k1r1r2/pp2q1p1/2pNp2p/3nP3/1P2Q3/2P3P1/P4P1P/2RR2K1 b - - 0 24"},
+    {"Caro-Kann 33", "1k1r4/pp3rp1/2pnp1qp/4P3/1P5P/P1PR2P1/3Q1P2/3R2K1 b - - 3 33"},
+    {"London 6", "r1bqkb1r/1p2pppp/p1n2n2/2pp4/3P1B2/2NBPN2/PPP2PPP/R2QK2R b KQkq - 1 6"},
+    {"London 15", "2r1kb1r/1p2p2p/p3Npp1/2pqP3/8/4P2Q/PPP2PPP/R3K2R b KQk - 1 15"},
+    {"London 24", "3rk2r/1p2p1bp/p5p1/5p2/8/qPpNP2Q/P1P1RPPP/1K1R4 b k - 8 24"},
+    {"London 33", "5rk1/4p2p/3r1bp1/p7/1pQ5/qPpN4/P1P1RPPP/1K2R3 b - - 5 33"},
+    {"Reti 6", "rnbqk2r/pp3ppp/2pbpn2/3p2B1/3P4/5NP1/PPP1PPBP/RN1Q1RK1 b kq - 2 6"},
+    {"Reti 15", "r1b2rk1/pp1n1pp1/2pb1n1p/1q1p4/N2Pp2N/2P1B1PP/PPQ1PPB1/R4RK1 b - - 1 15"},
+    {"Reti 24", "4rrk1/pp3pp1/1q5p/3R4/2pP4/4P1bP/PPQBP3/3R2K1 b - - 0 24"},
+    {"Reti 33", "6k1/pp6/3P3p/6p1/2p5/2B3bP/PP2r3/3R2K1 b - - 0 33"},
+    {"Scandinavian 6", "rnb1kb1r/ppp1pppp/8/q7/3Pn3/2N2N2/PPPB1PPP/R2QKB1R b KQkq - 4 6"},
+    {"Scandinavian 15", "3r1b1r/pk2pppp/6b1/qB6/3N4/8/NPPQ1PPP/2KR3R b - - 0 15"},
+    {"Scandinavian 24", "5b1r/2k2ppp/1p4b1/4p3/4B3/4K3/1PPR1PPP/R7 b - - 3 24"},
+    {"Scandinavian 33", "2k2r2/6R1/3R4/1p2p1pp/8/2P1bPK1/1P4PP/8 b - - 2 33"},
+    {"KPK Draw", "8/8/8/8/8/3k4/3P4/3K4 w - - 0 1"},
+    {"Lucena", "1K1k4/1P6/8/8/8/8/r7/2R5 w - - 0 1"},
+    {"KRK", "8/8/8/4k3/8/8/8/R3K3 w - - 0 1"},
+    {"Fine 70", "8/k7/3p4/p2P1p2/P2P1P2/8/8/K7 w - - 0 1"},
 };
 
+const std::vector<BenchmarkPosition>& benchPositions() {
+    static const std::vector<BenchmarkPosition> positions(std::begin(BENCH_POSITIONS), std::end(BENCH_POSITIONS));
+    return positions;
+}
+
+// Evaluations per second over every position reached by one legal move (make/evaluate/undo)
+static double measureEvalThroughput(const std::vector<BenchmarkPosition>& positions, bool useNNUE, int rounds) {
+    NNUE::enabled = useNNUE;
+    long long evals = 0;
+    volatile int sink = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const auto& pos : positions) {
+        Board board;
+        Color turn = board.loadFEN(pos.fen);
+        Board::MoveList moves;
+        board.generateLegalMoves(turn, moves);
+        sink = sink + board.evaluate();
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < moves.size(); i++) {
+                GameState prevState = board.gameState;
+                Piece captured = board.getPiece(moves[i].toX, moves[i].toY);
+                board.makeMove(moves[i]);
+                sink = sink + board.evaluate();
+                board.undoMove(moves[i], captured, prevState);
+                evals++;
+            }
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    NNUE::enabled = false;
+    return evals / std::chrono::duration<double>(end - start).count();
+}
+
+static double measureSearchNps(const std::vector<BenchmarkPosition>& positions, ChessAI& ai, int depth, bool useNNUE) {
+    NNUE::enabled = useNNUE;
+    long long nodes = 0;
+    double seconds = 0.0;
+    for (const auto& pos : positions) {
+        Board board;
+        Color turn = board.loadFEN(pos.fen);
+        ai.tt.clear();
+        auto start = std::chrono::high_resolution_clock::now();
+        (void)ai.getBestMove(board, turn, depth);
+        auto end = std::chrono::high_resolution_clock::now();
+        nodes += ai.nodesExplored;
+        seconds += std::chrono::duration<double>(end - start).count();
+    }
+    NNUE::enabled = false;
+    return nodes / seconds;
+}
+
 void benchmark(int argc, char* argv[]) {
     ChessAI ai;
+    double startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart).count();
+    long long startupRssMB = peakRssMB();
     ai.timeLimitMs = 1000000; // Disable time limit for benchmark testing
+    bool compareNNUE = false;
+    bool benchKPK = false;
+    std::string nnueFile;
+    
+    // Positional arguments come first: depth, threads, hash size
+    int depth = DEFAULT_BENCH_DEPTH;
+    int threads = 1;
+    int hashMB = DEFAULT_BENCH_HASH_MB;
+    int firstFlag = 2;
+    int* positional[] = {&depth, &threads, &hashMB};
+    for (int* value : positional) {
+        if (firstFlag >= argc || !std::isdigit((unsigned char)argv[firstFlag][0])) break;
+        *value = std::max(1, std::atoi(argv[firstFlag++]));
+    }
+    if (threads != 1) {
+        std::cout << "Search is single-threaded; benchmarking with 1 thread" << std::endl;
+        threads = 1;
+    }
+    ai.tt.resize(hashMB);
+    ai.tt.prefault(); // Keep page faults of the lazily allocated TT out of the timed searches
     
     // Parse ablation flags
-    for (int i = 2; i < argc; ++i) {
+    for (int i = firstFlag; i < argc; ++i) {
         std::string arg = argv[i];
+        if (arg == "-nnue") {
+            compareNNUE = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') nnueFile = argv[++i];
+        }
         if (arg == "-no-null") ai.enableNullMove = false;
         if (arg == "-no-lmr") ai.enableLMR = false;
         if (arg == "-no-killer") ai.enableKiller = false;
         if (arg == "-no-history") ai.enableHistory = false;
+        if (arg == "-no-delta") ai.enableDeltaPruning = false;
+        if (arg == "-no-qfutility") ai.enableQFutility = false;
+        if (arg == "-no-qsee") ai.enableQSee = false;
+        if (arg == "-no-qchecks") ai.enableQChecks = false;
+        if (arg == "-no-lazy") ai.enableLazyEval = false;
+        if (arg == "-kpk") benchKPK = true;
+        if (arg == "-tb" && i + 1 < argc) {
+            std::string dir = argv[++i];
+            std::cout << Tablebases::load(dir) << " tablebases loaded from " << dir << std::endl;
+        }
     }
 
+    const std::vector<BenchmarkPosition>& positions = benchPositions();
     
-    std::vector<BenchmarkPosition> positions = {
-        {"Start Position", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"},
-        {"Kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
-        {"Middlegame", "r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/2N2N2/PPPP1PPP/R1BQK2R w KQkq - 6 5"},
-        {"Endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"}
-    };
-    
-    int depth = 4;
     long long totalNodes = 0;
     double totalTime = 0.0;
 
     std::cout << "--- Starting Search Benchmark ---" << std::endl;
-    std::cout << "Search Depth: " << depth << std::endl << std::endl;
+    std::cout << "Search Depth: " << depth << " | Threads: " << threads << " | Hash: " << hashMB
+              << " MB | Positions: " << positions.size() << std::endl << std::endl;
     
     std::cout << std::left << std::setw(20) << "Position"
               << std::setw(15) << "Nodes"
@@ -52,6 +214,7 @@ void benchmark(int argc, char* argv[]) {
     for (const auto& pos : positions) {
         Board board;
         Color turn = board.loadFEN(pos.fen);
+        ai.tt.clear(); // Each position is searched from scratch, so its count does not depend on the others
         
         auto start = std::chrono::high_resolution_clock::now();
         (void)ai.getBestMove(board, turn, depth);
@@ -81,6 +244,19 @@ void benchmark(int argc, char* argv[]) {
         totalStats.nullCutoffs += ai.stats.nullCutoffs;
         totalStats.killerHits += ai.stats.killerHits;
         totalStats.historyHits += ai.stats.historyHits;
+        totalStats.qTTProbes += ai.stats.qTTProbes;
+        totalStats.qTTHits += ai.stats.qTTHits;
+        totalStats.qTTCutoffs += ai.stats.qTTCutoffs;
+        totalStats.qTTStores += ai.stats.qTTStores;
+        totalStats.qEvalsSaved += ai.stats.qEvalsSaved;
+        totalStats.qDeltaPrunes += ai.stats.qDeltaPrunes;
+        totalStats.qFutilityPrunes += ai.stats.qFutilityPrunes;
+        totalStats.qSeePrunes += ai.stats.qSeePrunes;
+        totalStats.qChecks += ai.stats.qChecks;
+        totalStats.mateDistancePrunes += ai.stats.mateDistancePrunes;
+        totalStats.cycleCutoffs += ai.stats.cycleCutoffs;
+        totalStats.lazyEvals += ai.stats.lazyEvals;
+        totalStats.tbHits += ai.stats.tbHits;
         
         double nps = nodes / duration;
         
@@ -96,6 +272,8 @@ void benchmark(int argc, char* argv[]) {
               << std::setw(15) << std::fixed << std::setprecision(4) << totalTime
               << std::setw(15) << static_cast<long long>(totalNodes / totalTime) << "  (Avg NPS)" << std::endl;
     std::cout << std::string(65, '-') << std::endl;
+    std::cout << "Startup: " << std::setprecision(2) << startupMs << " ms | RSS at startup: " << startupRssMB
+              << " MB | Peak RSS: " << peakRssMB() << " MB | TT: " << ai.tt.getSizeMB() << " MB" << std::endl;
     
     // Programmatic telemetry block
     std::cout << "\n[TELEMETRY]" << std::endl;
@@ -118,5 +296,73 @@ void benchmark(int argc, char* argv[]) {
     std::cout << "NullCutoffs: " << totalStats.nullCutoffs << std::endl;
     std::cout << "KillerHits: " << totalStats.killerHits << std::endl;
     std::cout << "HistoryHits: " << totalStats.historyHits << std::endl;
+    std::cout << "QTTProbes: " << totalStats.qTTProbes << std::endl;
+    std::cout << "QTTHits: " << totalStats.qTTHits << std::endl;
+    std::cout << "QTTHitRate: " << (totalStats.qTTProbes ? totalStats.qTTHits * 100 / totalStats.qTTProbes : 0) << std::endl;
+    std::cout << "QTTCutoffs: " << totalStats.qTTCutoffs << std::endl;
+    std::cout << "QTTStores: " << totalStats.qTTStores << std::endl;
+    std::cout << "QEvalsSaved: " << totalStats.qEvalsSaved << std::endl;
+    std::cout << "QDeltaPrunes: " << totalStats.qDeltaPrunes << std::endl;
+    std::cout << "QFutilityPrunes: " << totalStats.qFutilityPrunes << std::endl;
+    std::cout << "QSeePrunes: " << totalStats.qSeePrunes << std::endl;
+    std::cout << "QChecks: " << totalStats.qChecks << std::endl;
+    std::cout << "MateDistancePrunes: " << totalStats.mateDistancePrunes << std::endl;
+    std::cout << "CycleCutoffs: " << totalStats.cycleCutoffs << std::endl;
+    std::cout << "LazyEvals: " << totalStats.lazyEvals << std::endl;
+    std::cout << "TBHits: " << totalStats.tbHits << std::endl;
+    std::cout << "NsPerNode: " << static_cast<long long>(totalTime * 1e9 / totalNodes) << std::endl;
     std::cout << "[/TELEMETRY]" << std::endl;
+    
+    // Total nodes is a functional signature: any change to it means the search itself changed
+    std::cout << "\nBench signature: " << totalNodes << std::endl;
+    
+    if (benchKPK) {
+        // Bitbase generation time, and the search effort it saves on a drawn KPK position
+        std::cout << "\n[KPK]" << std::endl;
+        const int runs = 5;
+        int wins = 0;
+        auto genStart = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < runs; i++) wins = Bitbases::generate();
+        double genMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - genStart).count() / runs;
+        std::cout << "Positions: " << Bitbases::KPK_SIZE << " (" << Bitbases::KPK_SIZE / 8 / 1024 << " KB)" << std::endl;
+        std::cout << "Wins: " << wins << std::endl;
+        std::cout << "GenerationMs: " << std::fixed << std::setprecision(2) << genMs << std::endl;
+        
+        const int kpkDepth = 14;
+        for (int pass = 0; pass < 2; pass++) {
+            Bitbases::enabled = pass == 0;
+            ai.tt.clear();
+            Board board;
+            Color turn = board.loadFEN("8/8/8/8/8/3k4/3P4/3K4 w - - 0 1");
+            ai.getBestMove(board, turn, kpkDepth);
+            std::cout << (pass == 0 ? "NodesWithBitbase: " : "NodesWithoutBitbase: ") << ai.nodesExplored << std::endl;
+        }
+        Bitbases::enabled = true;
+        std::cout << "[/KPK]" << std::endl;
+    }
+    
+    if (!compareNNUE) return;
+    
+    // Classical vs NNUE comparison. Without a network file a synthetic one is used,
+    // which gives meaningful speed numbers but meaningless evaluations.
+    std::cout << "\n[NNUE]" << std::endl;
+    if (nnueFile.empty() || !NNUE::load(nnueFile)) {
+        if (!nnueFile.empty()) std::cout << "Failed to load " << nnueFile << ", ";
+        std::cout << "Using synthetic network (speed comparison only)" << std::endl;
+        NNUE::initRandom(1337);
+    } else {
+        std::cout << "Network: " << nnueFile << std::endl;
+    }
+    std::cout << "SIMD: " << NNUE::simdName() << std::endl;
+    
+    double classicalEps = measureEvalThroughput(positions, false, 200);
+    double nnueEps = measureEvalThroughput(positions, true, 200);
+    std::cout << "ClassicalEvalsPerSec: " << static_cast<long long>(classicalEps) << std::endl;
+    std::cout << "NNUEEvalsPerSec: " << static_cast<long long>(nnueEps) << std::endl;
+    
+    double classicalNps = measureSearchNps(positions, ai, depth, false);
+    double nnueNps = measureSearchNps(positions, ai, depth, true);
+    std::cout << "ClassicalNPS: " << static_cast<long long>(classicalNps) << std::endl;
+    std::cout << "NNUENPS: " << static_cast<long long>(nnueNps) << std::endl;
+    std::cout << "[/NNUE]" << std::endl;
 }
\ No newline at end of file
@@ -1,6 +1,22 @@
 #ifndef BENCHMARK_H
 #define BENCHMARK_H
 
+#include <string>
+#include <vector>
+
+struct BenchmarkPosition {
+    std::string name;
+    std::string fen;
+};
+
+// The fixed bench set, also the position corpus of the microbenchmarks
+const std::vector<BenchmarkPosition>& benchPositions();
+
+// Defaults give the reference bench signature; other depths and hash sizes give other totals
+const int DEFAULT_BENCH_DEPTH = 7;
+const int DEFAULT_BENCH_HASH_MB = 16;
+
+// Usage: ./chess bench [depth [threads [hashMB]]] [-no-null ...] [-kpk] [-tb dir] [-nnue [file]]
 void benchmark(int argc, char* argv[]);
 
 #endif // BENCHMARK_H
\ No newline at end of file
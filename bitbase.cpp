@@ -0,0 +1,112 @@
+#include "bitbase.h"
+#include "board.h"
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <mutex>
+
+namespace Bitbases {
+    bool enabled = true;
+
+    static uint32_t kpkBits[KPK_SIZE / 32];
+    static std::once_flag initFlag;
+
+    // Results are bit flags so the children of a position can be OR-ed together
+    enum Result : uint8_t { INVALID = 0, UNKNOWN = 1, DRAW = 2, WIN = 4 };
+
+    // Squares are rank * 8 + file; the pawn square is stored as (file 0-3, 6 - rank)
+    static inline int kpkIndex(int us, int blackKingSq, int whiteKingSq, int pawnSq) {
+        return whiteKingSq | (blackKingSq << 6) | (us << 12) | ((pawnSq & 7) << 13) | ((6 - (pawnSq >> 3)) << 15);
+    }
+
+    static inline int distance(int a, int b) {
+        return std::max(std::abs((a >> 3) - (b >> 3)), std::abs((a & 7) - (b & 7)));
+    }
+
+    struct KPKPosition {
+        uint8_t us;
+        uint8_t ksq[2];
+        uint8_t psq;
+        Result result;
+
+        void init(int idx) {
+            ksq[WHITE] = (uint8_t)(idx & 63);
+            ksq[BLACK] = (uint8_t)((idx >> 6) & 63);
+            us = (uint8_t)((idx >> 12) & 1);
+            psq = (uint8_t)((6 - ((idx >> 15) & 7)) * 8 + ((idx >> 13) & 3));
+
+            int push = psq + 8;
+            if (distance(ksq[WHITE], ksq[BLACK]) <= 1 || ksq[WHITE] == psq || ksq[BLACK] == psq
+                || (us == WHITE && (Attacks::pawnAttacks[WHITE][psq] & setBit(ksq[BLACK])))) {
+                result = INVALID; // Overlapping pieces, touching kings or Black in check with White to move
+            } else if (us == WHITE && (psq >> 3) == 6 && ksq[WHITE] != push && ksq[BLACK] != push
+                       && (distance(ksq[BLACK], push) > 1 || distance(ksq[WHITE], push) == 1)) {
+                result = WIN; // The pawn promotes and the queen cannot be taken
+            } else if (us == BLACK
+                       && (!(Attacks::kingAttacks[ksq[BLACK]] & ~(Attacks::kingAttacks[ksq[WHITE]] | Attacks::pawnAttacks[WHITE][psq]))
+                           || (Attacks::kingAttacks[ksq[BLACK]] & setBit(psq) & ~Attacks::kingAttacks[ksq[WHITE]]))) {
+                result = DRAW; // Stalemate, or the undefended pawn is captured
+            } else {
+                result = UNKNOWN;
+            }
+        }
+
+        // White wins if any move wins; Black draws if any move draws. Otherwise the position
+        // is decided once every move is (a loss for the side to move), else stays unknown.
+        Result classify(const std::vector<KPKPosition>& db) {
+            int them = us ^ 1;
+            int r = INVALID;
+            for (Bitboard b = Attacks::kingAttacks[ksq[us]]; b; b &= b - 1) {
+                int to = __builtin_ctzll(b);
+                r |= us == WHITE ? db[kpkIndex(them, ksq[BLACK], to, psq)].result
+                                 : db[kpkIndex(them, to, ksq[WHITE], psq)].result;
+            }
+            if (us == WHITE) {
+                if ((psq >> 3) < 6) r |= db[kpkIndex(them, ksq[BLACK], ksq[WHITE], psq + 8)].result;
+                if ((psq >> 3) == 1 && psq + 8 != ksq[WHITE] && psq + 8 != ksq[BLACK]) {
+                    r |= db[kpkIndex(them, ksq[BLACK], ksq[WHITE], psq + 16)].result;
+                }
+            }
+
+            const int good = us == WHITE ? WIN : DRAW;
+            const int bad = us == WHITE ? DRAW : WIN;
+            result = (r & good) ? (Result)good : ((r & UNKNOWN) ? UNKNOWN : (Result)bad);
+            return result;
+        }
+    };
+
+    int generate() {
+        std::vector<KPKPosition> db(KPK_SIZE);
+        for (int idx = 0; idx < KPK_SIZE; idx++) db[idx].init(idx);
+
+        // Iterate until no unknown position can be resolved; whatever remains is a draw
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int idx = 0; idx < KPK_SIZE; idx++) {
+                if (db[idx].result == UNKNOWN && db[idx].classify(db) != UNKNOWN) changed = true;
+            }
+        }
+
+        int wins = 0;
+        std::fill(kpkBits, kpkBits + KPK_SIZE / 32, 0u);
+        for (int idx = 0; idx < KPK_SIZE; idx++) {
+            if (db[idx].result == WIN) {
+                kpkBits[idx >> 5] |= 1u << (idx & 31);
+                wins++;
+            }
+        }
+        return wins;
+    }
+
+    void init() {
+        // Search threads may reach their first KPK ending together; the table is built once
+        std::call_once(initFlag, []() { generate(); });
+    }
+
+    bool probeKPK(int whiteKingSq, int whitePawnSq, int blackKingSq, Color sideToMove) {
+        init();
+        int idx = kpkIndex(sideToMove, blackKingSq, whiteKingSq, whitePawnSq);
+        return (kpkBits[idx >> 5] >> (idx & 31)) & 1;
+    }
+}
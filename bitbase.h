@@ -0,0 +1,22 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include "piece.h"
+
+// King and pawn versus king bitbase: one bit per position (win / draw), generated by
+// retrograde iteration on the first probe. Positions are normalised so the pawn is White's and
+// on files a-d; the caller mirrors Black-pawn and e-h file positions first.
+namespace Bitbases {
+    // 24 pawn squares (files a-d, ranks 2-7) x 64 x 64 king squares x 2 sides to move
+    const int KPK_SIZE = 24 * 64 * 64 * 2;
+
+    // Set false to fall back to the general evaluation in KPK, e.g. to check verdicts against search
+    extern bool enabled;
+
+    void init();   // Thread-safe; generates the table on the first call only (probeKPK calls it)
+    int generate(); // Regenerates the table and returns the number of won positions
+
+    bool probeKPK(int whiteKingSq, int whitePawnSq, int blackKingSq, Color sideToMove);
+}
+
+#endif // BITBASE_H
@@ -1,210 +1,82 @@
 #include "board.h"
 #include <iostream>
+#include <algorithm>
 #include <vector>
 #include <sstream>
+#include <cstring>
 #include "zobrist.h"
+#include "eval_params.h"
+#include "endgame.h"
 
-const int Board::MG_VALUE[7] = { 0, 82, 337, 365, 477, 1025, 0 };
-const int Board::EG_VALUE[7] = { 0, 94, 281, 297, 512, 936, 0 };
-
-const int Board::PAWN_MG[8][8] = {
-    {  0,   0,   0,   0,   0,   0,   0,   0},
-    { 98, 134,  61,  95,  68, 126,  34, -11},
-    {-6,   7,  26,  31,  62,  11,   8, -24},
-    {-14,  13,   6,  21,  23,  12,  17, -23},
-    {-27,  -2,  -5,  12,  17,   6,  10, -25},
-    {-26,  -4,  -4, -10,   3,   3,  33, -12},
-    {-35,  -1, -20, -23, -15,  24,  38, -22},
-    {  0,   0,   0,   0,   0,   0,   0,   0}
-};
-
-const int Board::PAWN_EG[8][8] = {
-    {  0,   0,   0,   0,   0,   0,   0,   0},
-    {178, 173, 158, 134, 147, 132, 165, 187},
-    { 94, 100,  85,  67,  56,  53,  82,  84},
-    { 32,  24,  13,   5,  -2,   4,  17,  17},
-    { 13,   9,  -3,  -7,  -7,  -8,   3,  -1},
-    {  4,   7,  -6,   1,   0,  -5,  -1,  -8},
-    { 13,   8,   8,  10,  13,   0,   2,  -7},
-    {  0,   0,   0,   0,   0,   0,   0,   0}
-};
-
-const int Board::KNIGHT_MG[8][8] = {
-    {-167, -89, -34, -49,  61, -97, -15, -107},
-    { -73, -41,  72,  36,  23,  62,   7,  -17},
-    { -47,  60,  37,  65,  84, 129,  73,   44},
-    {  -9,  17,  19,  53,  37,  69,  18,   22},
-    { -13,   4,  16,  13,  28,  19,  21,   -8},
-    { -23,  -9,  12,  10,  19,  17,  25,  -16},
-    { -29, -53, -12,  -3,  -1,  18, -14,  -19},
-    {-105, -21, -58, -33, -17, -28, -19,  -23}
-};
-
-const int Board::KNIGHT_EG[8][8] = {
-    {-58, -38, -13, -28, -31, -27, -63, -99},
-    {-25,  -8, -25,  -2,  -9, -25, -24, -52},
-    {-24, -20,  10,   9,  -1,  -9, -19, -41},
-    {-17,   3,  22,  22,  22,  11,   8, -18},
-    {-18,  -6,  16,  25,  16,  17,   4, -18},
-    {-23,  -3,  -1,  15,  10,  -3, -20, -22},
-    {-42, -20, -10,  -5,  -2, -20, -23, -44},
-    {-29, -51, -23, -38, -29, -27, -43, -36}
-};
-
-const int Board::BISHOP_MG[8][8] = {
-    {-29,   4, -82, -37, -25, -42,   7,  -8},
-    {-26,  16, -18, -13,  30,  59,  18, -47},
-    {-16,  37,  43,  40,  35,  50,  37,  -2},
-    { -4,   5,  19,  50,  37,  37,   7,  -2},
-    { -6,  13,  13,  26,  34,  12,  10,   4},
-    {  0,  15,  15,  15,  14,  27,  18,  10},
-    {  4,  15,  16,   0,   7,  21,  33,   1},
-    {-33,  -3, -14, -21, -13, -12, -39, -21}
-};
-
-const int Board::BISHOP_EG[8][8] = {
-    {-14, -21, -11,  -8,  -7,  -9, -17, -24},
-    { -8,  -4,   7, -12,  -3, -13,  -4, -14},
-    {  2,  -8,   0,  -1,  -2,   6,   0,   4},
-    { -3,   9,  12,   9,  14,  10,   3,   2},
-    { -6,   3,  13,  19,   7,  10,  -3,  -9},
-    {-12,  -3,   8,  10,  13,   3,  -7, -15},
-    {-14, -18,  -7,  -1,   4,  -9, -15, -27},
-    {-23,  -9, -23,  -5,  -9, -16,  -5, -17}
-};
-
-const int Board::ROOK_MG[8][8] = {
-    { 32,  42,  32,  51,  63,   9,  31,  43},
-    { 27,  32,  58,  62,  80,  67,  26,  44},
-    { -5,  19,  26,  36,  17,  45,  61,  16},
-    {-24, -11,   7,  26,  24,  35,  -8, -20},
-    {-36, -26, -12,  -1,   9,  -7,   6, -23},
-    {-45, -25, -16, -17,   3,   0,  -5, -33},
-    {-44, -16, -20,  -9,  -1,  11,  -6, -71},
-    {-19, -13,   1,  17,  16,   7, -37, -26}
-};
-
-const int Board::ROOK_EG[8][8] = {
-    { 13,  10,  18,  15,  12,  12,   8,   5},
-    { 11,  13,  13,  11,  -3,   3,   8,   3},
-    {  7,   7,   7,   5,   4,  -3,  -5,  -3},
-    {  4,   3,  13,   1,   2,   1,  -1,   2},
-    {  3,   5,   8,   4,  -5,  -6,  -8, -11},
-    { -4,   0,  -5,  -1,  -7, -12,  -8, -16},
-    { -6,  -6,   0,   2,  -9,  -9, -11,  -3},
-    { -9,   2,   3,  -1,  -5, -13,   4, -20}
-};
-
-const int Board::QUEEN_MG[8][8] = {
-    {-28,   0,  29,  12,  59,  44,  43,  45},
-    {-24, -39,  -5,   1, -16,  57,  28,  54},
-    {-13, -17,   7,   8,  29,  56,  47,  57},
-    {-27, -27, -16, -16,  -1,  17,  -2,   1},
-    { -9, -26,  -9, -10,  -2,  -4,   3,  -3},
-    {-14,   2, -11,  -2,  -5,   2,  14,   5},
-    {-35,  -8,  11,   0,   8,  -7,  -6,  14},
-    {-20, -27, -36, -15, -12, -21, -22, -20}
-};
-
-const int Board::QUEEN_EG[8][8] = {
-    { -9,  22,  22,  27,  27,  19,  10,  20},
-    {-17,  20,  32,  41,  58,  25,  30,   0},
-    {-20,   6,   9,  49,  47,  35,  19,   9},
-    {  3,  22,  24,  45,  57,  40,  57,  36},
-    {-18,  28,  19,  47,  31,  34,  12,  11},
-    { 16,  20,  22,  51,  25,  60,  12,  27},
-    { 25,   8,  12,  43,  43,  22,  16,  23},
-    {-14, -15, -15, -13, -10, -24, -20, -11}
-};
-
-const int Board::KING_MG[8][8] = {
-    {-65,  23,  16, -15, -56, -34,   2,  13},
-    { 29,  -1, -20,  -7,  -8,  -4, -38, -29},
-    { -9,  24,   2, -16, -20,   6,  22, -22},
-    {-17, -20, -12, -27, -30, -25, -14, -36},
-    {-49, -1, -27, -39, -46, -44, -33, -51},
-    {-14, -14, -22, -46, -44, -30, -15, -27},
-    {  1,   7,  -8, -64, -43, -16,   9,   8},
-    {-15,  36,  12, -54,   8, -28,  24,  14}
-};
-
-const int Board::KING_EG[8][8] = {
-    {-74, -35, -18, -18, -11,  15,   4, -17},
-    {-12,  17,  14,  17,  17,  38,  23,  11},
-    { 10,  17,  23,  15,  20,  45,  44,  13},
-    { -8,  22,  24,  27,  26,  33,  26,   3},
-    {-18,  -4,  21,  24,  27,  23,   9, -11},
-    {-19,  -3,  11,  21,  23,  16,   7,  -9},
-    {-27, -11,   4,  13,  14,   4,  -5, -17},
-    {-53, -34, -21, -11, -28, -14, -24, -43}
-};
+const int Board::SEE_VALUE[7] = { 0, 100, 325, 325, 500, 975, 20000 };
 
 namespace Attacks {
-    Bitboard knightAttacks[64];
-    Bitboard kingAttacks[64];
-    Bitboard pawnAttacks[2][64];
-    Bitboard rayAttacks[8][64]; // N, S, E, W, NE, NW, SE, SW
-
-    void init() {
-        for (int sq = 0; sq < 64; ++sq) {
-            int r = sq / 8;
-            int f = sq % 8;
-            
-            // Knight attacks
-            Bitboard n = 0;
-            if (r >= 2 && f >= 1) n |= (1ULL << (sq - 17));
-            if (r >= 2 && f <= 6) n |= (1ULL << (sq - 15));
-            if (r >= 1 && f >= 2) n |= (1ULL << (sq - 10));
-            if (r >= 1 && f <= 5) n |= (1ULL << (sq - 6));
-            if (r <= 6 && f >= 2) n |= (1ULL << (sq + 6));
-            if (r <= 6 && f <= 5) n |= (1ULL << (sq + 10));
-            if (r <= 5 && f >= 1) n |= (1ULL << (sq + 15));
-            if (r <= 5 && f <= 6) n |= (1ULL << (sq + 17));
-            knightAttacks[sq] = n;
-            
-            // King attacks
-            Bitboard k = 0;
-            if (r >= 1) k |= (1ULL << (sq - 8));
-            if (r <= 6) k |= (1ULL << (sq + 8));
-            if (f >= 1) k |= (1ULL << (sq - 1));
-            if (f <= 6) k |= (1ULL << (sq + 1));
-            if (r >= 1 && f >= 1) k |= (1ULL << (sq - 9));
-            if (r >= 1 && f <= 6) k |= (1ULL << (sq - 7));
-            if (r <= 6 && f >= 1) k |= (1ULL << (sq + 7));
-            if (r <= 6 && f <= 6) k |= (1ULL << (sq + 9));
-            kingAttacks[sq] = k;
-            
-            // Pawn attacks
-            Bitboard pw = 0;
-            if (r <= 6 && f >= 1) pw |= (1ULL << (sq + 7));
-            if (r <= 6 && f <= 6) pw |= (1ULL << (sq + 9));
-            pawnAttacks[WHITE][sq] = pw;
-            
-            Bitboard pb = 0;
-            if (r >= 1 && f >= 1) pb |= (1ULL << (sq - 9));
-            if (r >= 1 && f <= 6) pb |= (1ULL << (sq - 7));
-            pawnAttacks[BLACK][sq] = pb;
-            
-            // Rays
-            Bitboard ray = 0;
-            for (int i=r+1; i<8; ++i) ray |= (1ULL << (i*8 + f)); rayAttacks[0][sq] = ray; // N
-            ray = 0;
-            for (int i=r-1; i>=0; --i) ray |= (1ULL << (i*8 + f)); rayAttacks[1][sq] = ray; // S
-            ray = 0;
-            for (int i=f+1; i<8; ++i) ray |= (1ULL << (r*8 + i)); rayAttacks[2][sq] = ray; // E
-            ray = 0;
-            for (int i=f-1; i>=0; --i) ray |= (1ULL << (r*8 + i)); rayAttacks[3][sq] = ray; // W
-            ray = 0;
-            for (int i=r+1, j=f+1; i<8 && j<8; ++i, ++j) ray |= (1ULL << (i*8 + j)); rayAttacks[4][sq] = ray; // NE
-            ray = 0;
-            for (int i=r+1, j=f-1; i<8 && j>=0; ++i, --j) ray |= (1ULL << (i*8 + j)); rayAttacks[5][sq] = ray; // NW
-            ray = 0;
-            for (int i=r-1, j=f+1; i>=0 && j<8; --i, ++j) ray |= (1ULL << (i*8 + j)); rayAttacks[6][sq] = ray; // SE
-            ray = 0;
-            for (int i=r-1, j=f-1; i>=0 && j>=0; --i, --j) ray |= (1ULL << (i*8 + j)); rayAttacks[7][sq] = ray; // SW
-        }
+    // The tables are built by constexpr functions, so they are constant-initialised data in the
+    // binary and need no setup at startup or per Board.
+    constexpr Bitboard stepIf(bool onBoard, int sq) { return onBoard ? setBit(sq) : 0; }
+    
+    constexpr Bitboard knightAttack(int sq) {
+        return stepIf(sq / 8 >= 2 && sq % 8 >= 1, sq - 17) | stepIf(sq / 8 >= 2 && sq % 8 <= 6, sq - 15)
+             | stepIf(sq / 8 >= 1 && sq % 8 >= 2, sq - 10) | stepIf(sq / 8 >= 1 && sq % 8 <= 5, sq - 6)
+             | stepIf(sq / 8 <= 6 && sq % 8 >= 2, sq + 6)  | stepIf(sq / 8 <= 6 && sq % 8 <= 5, sq + 10)
+             | stepIf(sq / 8 <= 5 && sq % 8 >= 1, sq + 15) | stepIf(sq / 8 <= 5 && sq % 8 <= 6, sq + 17);
+    }
+    
+    constexpr Bitboard kingAttack(int sq) {
+        return stepIf(sq / 8 >= 1, sq - 8) | stepIf(sq / 8 <= 6, sq + 8)
+             | stepIf(sq % 8 >= 1, sq - 1) | stepIf(sq % 8 <= 6, sq + 1)
+             | stepIf(sq / 8 >= 1 && sq % 8 >= 1, sq - 9) | stepIf(sq / 8 >= 1 && sq % 8 <= 6, sq - 7)
+             | stepIf(sq / 8 <= 6 && sq % 8 >= 1, sq + 7) | stepIf(sq / 8 <= 6 && sq % 8 <= 6, sq + 9);
     }
     
+    constexpr Bitboard whitePawnAttack(int sq) {
+        return stepIf(sq / 8 <= 6 && sq % 8 >= 1, sq + 7) | stepIf(sq / 8 <= 6 && sq % 8 <= 6, sq + 9);
+    }
+    constexpr Bitboard blackPawnAttack(int sq) {
+        return stepIf(sq / 8 >= 1 && sq % 8 >= 1, sq - 9) | stepIf(sq / 8 >= 1 && sq % 8 <= 6, sq - 7);
+    }
+    
+    // Squares from (r, f) in direction (dr, df), excluding the start
+    constexpr Bitboard ray(int r, int f, int dr, int df) {
+        return (r + dr < 0 || r + dr > 7 || f + df < 0 || f + df > 7) ? 0
+             : setBit((r + dr) * 8 + f + df) | ray(r + dr, f + df, dr, df);
+    }
+    constexpr Bitboard rayN(int sq)  { return ray(sq / 8, sq % 8,  1,  0); }
+    constexpr Bitboard rayS(int sq)  { return ray(sq / 8, sq % 8, -1,  0); }
+    constexpr Bitboard rayE(int sq)  { return ray(sq / 8, sq % 8,  0,  1); }
+    constexpr Bitboard rayW(int sq)  { return ray(sq / 8, sq % 8,  0, -1); }
+    constexpr Bitboard rayNE(int sq) { return ray(sq / 8, sq % 8,  1,  1); }
+    constexpr Bitboard rayNW(int sq) { return ray(sq / 8, sq % 8,  1, -1); }
+    constexpr Bitboard raySE(int sq) { return ray(sq / 8, sq % 8, -1,  1); }
+    constexpr Bitboard raySW(int sq) { return ray(sq / 8, sq % 8, -1, -1); }
+    
+    constexpr Bitboard whiteFrontSpan(int sq) {
+        return rayN(sq) | (sq % 8 > 0 ? rayN(sq - 1) : 0) | (sq % 8 < 7 ? rayN(sq + 1) : 0);
+    }
+    constexpr Bitboard blackFrontSpan(int sq) {
+        return rayS(sq) | (sq % 8 > 0 ? rayS(sq - 1) : 0) | (sq % 8 < 7 ? rayS(sq + 1) : 0);
+    }
+    
+    constexpr Bitboard adjacentFiles(int f) {
+        return (f > 0 ? 0x0101010101010101ULL << (f - 1) : 0) | (f < 7 ? 0x0101010101010101ULL << (f + 1) : 0);
+    }
+
+#define SQ4(fn, i) fn(i), fn(i + 1), fn(i + 2), fn(i + 3)
+#define SQ16(fn, i) SQ4(fn, i), SQ4(fn, i + 4), SQ4(fn, i + 8), SQ4(fn, i + 12)
+#define SQ64(fn) SQ16(fn, 0), SQ16(fn, 16), SQ16(fn, 32), SQ16(fn, 48)
+    const Bitboard knightAttacks[64] = { SQ64(knightAttack) };
+    const Bitboard kingAttacks[64] = { SQ64(kingAttack) };
+    const Bitboard pawnAttacks[2][64] = { { SQ64(whitePawnAttack) }, { SQ64(blackPawnAttack) } };
+    const Bitboard passedPawnMask[2][64] = { { SQ64(whiteFrontSpan) }, { SQ64(blackFrontSpan) } };
+    const Bitboard adjacentFilesMask[8] = { SQ4(adjacentFiles, 0), SQ4(adjacentFiles, 4) };
+    static const Bitboard rayAttacks[8][64] = { // N, S, E, W, NE, NW, SE, SW
+        { SQ64(rayN) }, { SQ64(rayS) }, { SQ64(rayE) }, { SQ64(rayW) },
+        { SQ64(rayNE) }, { SQ64(rayNW) }, { SQ64(raySE) }, { SQ64(raySW) }
+    };
+#undef SQ64
+#undef SQ16
+#undef SQ4
+    
     Bitboard getRayAttacks(int sq, int dir, Bitboard occupied) {
         Bitboard attacks = rayAttacks[dir][sq];
         Bitboard blockers = attacks & occupied;
@@ -226,10 +98,19 @@ namespace Attacks {
     Bitboard getQueenAttacks(int sq, Bitboard occupied) {
         return getRookAttacks(sq, occupied) | getBishopAttacks(sq, occupied);
     }
+    
+    Bitboard getBetween(int s1, int s2) {
+        if (getRookAttacks(s1, 0) & setBit(s2)) {
+            return getRookAttacks(s1, setBit(s2)) & getRookAttacks(s2, setBit(s1));
+        }
+        if (getBishopAttacks(s1, 0) & setBit(s2)) {
+            return getBishopAttacks(s1, setBit(s2)) & getBishopAttacks(s2, setBit(s1));
+        }
+        return 0;
+    }
 }
 
 Board::Board() {
-    Attacks::init();
     setupBoard();
 }
 
@@ -284,16 +165,16 @@ Color Board::loadFEN(const std::string& fen) {
             int mgPsq = 0, egPsq = 0;
             int pRank = (col == WHITE) ? 7 - rank : rank;
             switch(t) {
-                case PAWN:   mgPsq = PAWN_MG[pRank][file]; egPsq = PAWN_EG[pRank][file]; break;
-                case KNIGHT: mgPsq = KNIGHT_MG[pRank][file]; egPsq = KNIGHT_EG[pRank][file]; break;
-                case BISHOP: mgPsq = BISHOP_MG[pRank][file]; egPsq = BISHOP_EG[pRank][file]; break;
-                case ROOK:   mgPsq = ROOK_MG[pRank][file]; egPsq = ROOK_EG[pRank][file]; break;
-                case QUEEN:  mgPsq = QUEEN_MG[pRank][file]; egPsq = QUEEN_EG[pRank][file]; break;
-                case KING:   mgPsq = KING_MG[pRank][file]; egPsq = KING_EG[pRank][file]; break;
+                case PAWN:   mgPsq = EvalParams::PAWN_MG[pRank][file]; egPsq = EvalParams::PAWN_EG[pRank][file]; break;
+                case KNIGHT: mgPsq = EvalParams::KNIGHT_MG[pRank][file]; egPsq = EvalParams::KNIGHT_EG[pRank][file]; break;
+                case BISHOP: mgPsq = EvalParams::BISHOP_MG[pRank][file]; egPsq = EvalParams::BISHOP_EG[pRank][file]; break;
+                case ROOK:   mgPsq = EvalParams::ROOK_MG[pRank][file]; egPsq = EvalParams::ROOK_EG[pRank][file]; break;
+                case QUEEN:  mgPsq = EvalParams::QUEEN_MG[pRank][file]; egPsq = EvalParams::QUEEN_EG[pRank][file]; break;
+                case KING:   mgPsq = EvalParams::KING_MG[pRank][file]; egPsq = EvalParams::KING_EG[pRank][file]; break;
                 default: break;
             }
-            int mgVal = MG_VALUE[t] + mgPsq;
-            int egVal = EG_VALUE[t] + egPsq;
+            int mgVal = EvalParams::MG_VALUE[t] + mgPsq;
+            int egVal = EvalParams::EG_VALUE[t] + egPsq;
             if (col == WHITE) {
                 gameState.mgScore += mgVal;
                 gameState.egScore += egVal;
@@ -310,25 +191,40 @@ Color Board::loadFEN(const std::string& fen) {
     gameState = GameState();
     gameState.mgScore = savedMgScore;
     gameState.egScore = savedEgScore;
-    gameState.whiteCanCastleKingside = castling.find('K') != std::string::npos;
-    gameState.whiteCanCastleQueenside = castling.find('Q') != std::string::npos;
-    gameState.blackCanCastleKingside = castling.find('k') != std::string::npos;
-    gameState.blackCanCastleQueenside = castling.find('q') != std::string::npos;
+    gameState.castlingRights = 0;
+    if (castling.find('K') != std::string::npos) gameState.castlingRights |= WHITE_KINGSIDE;
+    if (castling.find('Q') != std::string::npos) gameState.castlingRights |= WHITE_QUEENSIDE;
+    if (castling.find('k') != std::string::npos) gameState.castlingRights |= BLACK_KINGSIDE;
+    if (castling.find('q') != std::string::npos) gameState.castlingRights |= BLACK_QUEENSIDE;
     
     if (enPassant != "-") {
-        gameState.hasEnPassant = true;
-        gameState.enPassantX = enPassant[1] - '1';
-        gameState.enPassantY = enPassant[0] - 'a';
+        gameState.epSquare = (enPassant[1] - '1') * 8 + (enPassant[0] - 'a');
     } else {
-        gameState.hasEnPassant = false;
+        gameState.epSquare = NO_SQUARE;
     }
     
     gameState.halfmoveClock = halfmove;
     gameState.fullmoveNumber = fullmove;
     
     initCache();
+    attackInfoValid = false;
+    // The pawn key (pawns and kings) is only updated incrementally afterwards, so seed it from
+    // the position; otherwise every loaded position starts at key 0 and shares pawn hash entries.
+    for (Bitboard pawns = pieces[PAWN] | pieces[KING]; pawns; pawns &= pawns - 1) {
+        int sq = __builtin_ctzll(pawns);
+        gameState.pawnKey ^= Zobrist::pieceKeys[pieceList[sq].color][pieceList[sq].type][sq];
+    }
+    for (int c = 0; c < 2; c++) {
+        for (int t = PAWN; t <= QUEEN; t++) {
+            for (int n = 0; n < pieceCount[c][t] && n < Zobrist::MAX_PIECE_COUNT; n++) {
+                gameState.materialKey ^= Zobrist::materialKeys[c][t][n];
+            }
+        }
+    }
+    nnueDirty[WHITE] = nnueDirty[BLACK] = true;
     Color c_turn = turn == "w" ? WHITE : BLACK;
     gameState.zobristKey = Zobrist::computeHash(*this, c_turn);
+    gameState.sideToMove = c_turn;
     return c_turn;
 }
 
@@ -345,40 +241,123 @@ void Board::initCache() {
         }
     }
     historyPly = 0;
-}
-
-bool Board::isSquareUnderAttack(int sq, Color byColor) const {
-    Bitboard occ = colors[WHITE] | colors[BLACK];
-    if (Attacks::pawnAttacks[byColor == WHITE ? BLACK : WHITE][sq] & pieces[PAWN] & colors[byColor]) return true;
-    if (Attacks::knightAttacks[sq] & pieces[KNIGHT] & colors[byColor]) return true;
-    if (Attacks::getBishopAttacks(sq, occ) & (pieces[BISHOP] | pieces[QUEEN]) & colors[byColor]) return true;
-    if (Attacks::getRookAttacks(sq, occ) & (pieces[ROOK] | pieces[QUEEN]) & colors[byColor]) return true;
-    if (Attacks::kingAttacks[sq] & pieces[KING] & colors[byColor]) return true;
-    return false;
+    for (int i = 0; i < NNUE_KING_SLOTS; i++) nnueKingPly[i] = -1;
 }
 
 bool Board::isSquareUnderAttack(int x, int y, Color byColor) const {
     return isSquareUnderAttack(x * 8 + y, byColor);
 }
 
-bool Board::isInCheck(Color color) const {
-    int ksq = kingPos[color].first * 8 + kingPos[color].second;
-    return isSquareUnderAttack(ksq, color == WHITE ? BLACK : WHITE);
+const AttackInfo& Board::attacks() const {
+    if (!attackInfoValid) computeAttacks();
+    return attackInfo;
 }
 
+void Board::computeAttacks() const {
+    AttackInfo& ai = attackInfo;
+    Bitboard occ = colors[WHITE] | colors[BLACK];
+    
+    for (int c = WHITE; c <= BLACK; c++) {
+        Bitboard pawns = pieces[PAWN] & colors[c];
+        Bitboard left = (c == WHITE) ? (pawns & ~0x0101010101010101ULL) << 7 : (pawns & ~0x0101010101010101ULL) >> 9;
+        Bitboard right = (c == WHITE) ? (pawns & ~0x8080808080808080ULL) << 9 : (pawns & ~0x8080808080808080ULL) >> 7;
+        ai.attacks[c][PAWN] = left | right;
+        int ksq = kingPos[c].first * 8 + kingPos[c].second;
+        ai.kingZone[c] = ksq >= 0 ? Attacks::kingAttacks[ksq] | setBit(ksq) : 0;
+    }
+    
+    for (int c = WHITE; c <= BLACK; c++) {
+        int them = c ^ 1;
+        Bitboard mobilityArea = ~colors[c] & ~ai.attacks[them][PAWN];
+        Bitboard all = ai.attacks[c][PAWN];
+        ai.mobility[c][PAWN] = 0;
+        ai.kingAttacks[c][PAWN] = __builtin_popcountll(ai.attacks[c][PAWN] & ai.kingZone[them]);
+        for (int t = KNIGHT; t <= KING; t++) {
+            ai.attacks[c][t] = 0;
+            ai.mobility[c][t] = 0;
+            ai.kingAttacks[c][t] = 0;
+            for (Bitboard bb = pieces[t] & colors[c]; bb; bb &= bb - 1) {
+                int sq = __builtin_ctzll(bb);
+                Bitboard a;
+                switch (t) {
+                    case KNIGHT: a = Attacks::knightAttacks[sq]; break;
+                    case BISHOP: a = Attacks::getBishopAttacks(sq, occ); break;
+                    case ROOK:   a = Attacks::getRookAttacks(sq, occ); break;
+                    case QUEEN:  a = Attacks::getQueenAttacks(sq, occ); break;
+                    default:     a = Attacks::kingAttacks[sq]; break;
+                }
+                all |= a;
+                ai.attacks[c][t] |= a;
+                ai.mobility[c][t] += __builtin_popcountll(a & mobilityArea);
+                ai.kingAttacks[c][t] += __builtin_popcountll(a & ai.kingZone[them]);
+            }
+        }
+        ai.attacks[c][EMPTY] = all;
+    }
+    attackInfoValid = true;
+}
+
+Bitboard Board::attackersTo(int sq, Bitboard occupied) const {
+    return (Attacks::pawnAttacks[BLACK][sq] & pieces[PAWN] & colors[WHITE])
+         | (Attacks::pawnAttacks[WHITE][sq] & pieces[PAWN] & colors[BLACK])
+         | (Attacks::knightAttacks[sq] & pieces[KNIGHT])
+         | (Attacks::getBishopAttacks(sq, occupied) & (pieces[BISHOP] | pieces[QUEEN]))
+         | (Attacks::getRookAttacks(sq, occupied) & (pieces[ROOK] | pieces[QUEEN]))
+         | (Attacks::kingAttacks[sq] & pieces[KING]);
+}
+
+int Board::see(const Move& m) const {
+    int fromSq = m.fromX * 8 + m.fromY;
+    int toSq = m.toX * 8 + m.toY;
+    
+    // Swap-list algorithm: gain[d] is the material balance if the exchange stops at depth d
+    int gain[32];
+    int d = 0;
+    Bitboard occ = colors[WHITE] | colors[BLACK];
+    gain[0] = m.isEnPassant ? SEE_VALUE[PAWN] : SEE_VALUE[pieceList[toSq].type];
+    int attackerValue = SEE_VALUE[pieceList[fromSq].type];
+    if (m.promotion != EMPTY) {
+        gain[0] += SEE_VALUE[m.promotion] - SEE_VALUE[PAWN];
+        attackerValue = SEE_VALUE[m.promotion];
+    }
+    if (m.isEnPassant) occ ^= setBit(fromSq / 8 * 8 + toSq % 8);
+    
+    Color side = pieceList[fromSq].color;
+    Bitboard fromSet = setBit(fromSq);
+    do {
+        d++;
+        gain[d] = attackerValue - gain[d - 1];
+        if (std::max(-gain[d - 1], gain[d]) < 0) break; // Neither side can improve by continuing
+        occ ^= fromSet; // Removing the capturer also uncovers x-ray attackers behind it
+        side = side == WHITE ? BLACK : WHITE;
+        Bitboard attackers = attackersTo(toSq, occ) & occ & colors[side];
+        fromSet = 0;
+        for (int pt = PAWN; pt <= KING; pt++) {
+            Bitboard bb = attackers & pieces[pt];
+            if (bb) {
+                fromSet = bb & (0 - bb);
+                attackerValue = SEE_VALUE[pt];
+                break;
+            }
+        }
+    } while (fromSet && d < 31);
+    
+    while (--d) gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    return gain[0];
+}
 
 int getPieceValue(Piece p, int sq) {
     if (p.type == EMPTY) return 0;
     int r = sq / 8;
     int f = sq % 8;
-    int score = Board::MG_VALUE[p.type];
+    int score = EvalParams::MG_VALUE[p.type];
     if (p.color == WHITE) r = 7 - r;
-    if (p.type == PAWN) score += Board::PAWN_MG[r][f];
-    else if (p.type == KNIGHT) score += Board::KNIGHT_MG[r][f];
-    else if (p.type == BISHOP) score += Board::BISHOP_MG[r][f];
-    else if (p.type == ROOK) score += Board::ROOK_MG[r][f];
-    else if (p.type == QUEEN) score += Board::QUEEN_MG[r][f];
-    else if (p.type == KING) score += Board::KING_MG[r][f];
+    if (p.type == PAWN) score += EvalParams::PAWN_MG[r][f];
+    else if (p.type == KNIGHT) score += EvalParams::KNIGHT_MG[r][f];
+    else if (p.type == BISHOP) score += EvalParams::BISHOP_MG[r][f];
+    else if (p.type == ROOK) score += EvalParams::ROOK_MG[r][f];
+    else if (p.type == QUEEN) score += EvalParams::QUEEN_MG[r][f];
+    else if (p.type == KING) score += EvalParams::KING_MG[r][f];
     return p.color == WHITE ? score : -score;
 }
 
@@ -386,24 +365,40 @@ int getPieceValueEg(Piece p, int sq) {
     if (p.type == EMPTY) return 0;
     int r = sq / 8;
     int f = sq % 8;
-    int score = Board::EG_VALUE[p.type];
+    int score = EvalParams::EG_VALUE[p.type];
     if (p.color == WHITE) r = 7 - r;
-    if (p.type == PAWN) score += Board::PAWN_EG[r][f];
-    else if (p.type == KNIGHT) score += Board::KNIGHT_EG[r][f];
-    else if (p.type == BISHOP) score += Board::BISHOP_EG[r][f];
-    else if (p.type == ROOK) score += Board::ROOK_EG[r][f];
-    else if (p.type == QUEEN) score += Board::QUEEN_EG[r][f];
-    else if (p.type == KING) score += Board::KING_EG[r][f];
+    if (p.type == PAWN) score += EvalParams::PAWN_EG[r][f];
+    else if (p.type == KNIGHT) score += EvalParams::KNIGHT_EG[r][f];
+    else if (p.type == BISHOP) score += EvalParams::BISHOP_EG[r][f];
+    else if (p.type == ROOK) score += EvalParams::ROOK_EG[r][f];
+    else if (p.type == QUEEN) score += EvalParams::QUEEN_EG[r][f];
+    else if (p.type == KING) score += EvalParams::KING_EG[r][f];
     return p.color == WHITE ? score : -score;
 }
 
+// Castling rights that survive a move touching each square: king and rook home squares clear
+// their own rights, whether the piece moves away or a rook is captured there
+static const uint8_t castlingMask[64] = {
+    13, 15, 15, 15, 12, 15, 15, 14,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+     7, 15, 15, 15,  3, 15, 15, 11
+};
+
+template<Color Us>
 void Board::makeMove(const Move& m) {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
     if (historyPly < 1024) {
         history[historyPly++] = gameState.zobristKey;
     }
     
     int fromSq = m.fromX * 8 + m.fromY;
     int toSq = m.toX * 8 + m.toY;
+    attackInfoValid = false;
     
     Piece p = pieceList[fromSq];
     Piece captured = pieceList[toSq];
@@ -414,7 +409,7 @@ void Board::makeMove(const Move& m) {
         gameState.halfmoveClock++;
     }
     
-    if (p.color == BLACK) {
+    if (Us == BLACK) {
         gameState.fullmoveNumber++;
     }
     
@@ -424,18 +419,32 @@ void Board::makeMove(const Move& m) {
     
     // Remove from original square
     pieces[p.type] ^= fromMask;
-    colors[p.color] ^= fromMask;
+    colors[Us] ^= fromMask;
     pieceList[fromSq] = Piece(EMPTY, WHITE);
+    // Every feature of the mover's perspective is king-relative, so a king move keeps that
+    // accumulator for undoMove instead of updating it
+    if (p.type == KING) {
+        int slot = historyPly & (NNUE_KING_SLOTS - 1);
+        nnueKingPly[slot] = -1;
+        if (NNUE::enabled && !nnueDirty[Us]) {
+            std::memcpy(nnueKingAcc[slot], nnueAcc[Us], sizeof(nnueAcc[Us]));
+            nnueKingPly[slot] = historyPly;
+        }
+        nnueDirty[Us] = true;
+    }
+    if (NNUE::enabled) nnueUpdate(p, fromSq, false);
     gameState.mgScore -= getPieceValue(p, fromSq);
     gameState.egScore -= getPieceValueEg(p, fromSq);
-    gameState.zobristKey ^= Zobrist::pieceKeys[p.color][p.type][fromSq];
-    if (p.type == PAWN) gameState.pawnKey ^= Zobrist::pieceKeys[p.color][PAWN][fromSq];
+    gameState.zobristKey ^= Zobrist::pieceKeys[Us][p.type][fromSq];
+    if (p.type == PAWN || p.type == KING) gameState.pawnKey ^= Zobrist::pieceKeys[Us][p.type][fromSq];
     
     // Handle capture
     if (captured.type != EMPTY) {
         pieces[captured.type] ^= toMask;
         colors[captured.color] ^= toMask;
         pieceCount[captured.color][captured.type]--;
+        gameState.materialKey ^= Zobrist::materialKeys[captured.color][captured.type][pieceCount[captured.color][captured.type]];
+        if (NNUE::enabled) nnueUpdate(captured, toSq, false);
         gameState.mgScore -= getPieceValue(captured, toSq);
         gameState.egScore -= getPieceValueEg(captured, toSq);
         gameState.zobristKey ^= Zobrist::pieceKeys[captured.color][captured.type][toSq];
@@ -444,93 +453,100 @@ void Board::makeMove(const Move& m) {
     
     // If it's a promotion, we change the piece type now
     if (m.promotion != EMPTY) {
-        pieceCount[p.color][PAWN]--;
-        pieceCount[p.color][m.promotion]++;
+        pieceCount[Us][PAWN]--;
+        gameState.materialKey ^= Zobrist::materialKeys[Us][PAWN][pieceCount[Us][PAWN]];
+        gameState.materialKey ^= Zobrist::materialKeys[Us][m.promotion][pieceCount[Us][m.promotion]];
+        pieceCount[Us][m.promotion]++;
         p.type = m.promotion;
     }
     
     // Place piece at new square
     pieceList[toSq] = p;
+    if (NNUE::enabled) nnueUpdate(p, toSq, true);
     gameState.mgScore += getPieceValue(p, toSq);
     gameState.egScore += getPieceValueEg(p, toSq);
-    gameState.zobristKey ^= Zobrist::pieceKeys[p.color][p.type][toSq];
-    if (p.type == PAWN) gameState.pawnKey ^= Zobrist::pieceKeys[p.color][PAWN][toSq];
+    gameState.zobristKey ^= Zobrist::pieceKeys[Us][p.type][toSq];
+    if (p.type == PAWN || p.type == KING) gameState.pawnKey ^= Zobrist::pieceKeys[Us][p.type][toSq];
     
     // Special moves
     if (m.isCastle) {
-        int r = p.color == WHITE ? 0 : 7;
+        const int r = Us == WHITE ? 0 : 7;
         int rookFromSq = r*8 + (m.toY == 6 ? 7 : 0);
         int rookToSq = r*8 + (m.toY == 6 ? 5 : 3);
         
         pieces[ROOK] ^= (1ULL << rookFromSq) | (1ULL << rookToSq);
-        colors[p.color] ^= (1ULL << rookFromSq) | (1ULL << rookToSq);
+        colors[Us] ^= (1ULL << rookFromSq) | (1ULL << rookToSq);
         
-        Piece rookPiece(ROOK, p.color);
+        Piece rookPiece(ROOK, Us);
         pieceList[rookFromSq] = Piece(EMPTY, WHITE);
         pieceList[rookToSq] = rookPiece;
+        if (NNUE::enabled) {
+            nnueUpdate(rookPiece, rookFromSq, false);
+            nnueUpdate(rookPiece, rookToSq, true);
+        }
         
         gameState.mgScore -= getPieceValue(rookPiece, rookFromSq);
         gameState.egScore -= getPieceValueEg(rookPiece, rookFromSq);
         gameState.mgScore += getPieceValue(rookPiece, rookToSq);
         gameState.egScore += getPieceValueEg(rookPiece, rookToSq);
         
-        gameState.zobristKey ^= Zobrist::pieceKeys[p.color][ROOK][rookFromSq];
-        gameState.zobristKey ^= Zobrist::pieceKeys[p.color][ROOK][rookToSq];
+        gameState.zobristKey ^= Zobrist::pieceKeys[Us][ROOK][rookFromSq];
+        gameState.zobristKey ^= Zobrist::pieceKeys[Us][ROOK][rookToSq];
     } else if (m.isEnPassant) {
         int capSq = fromSq / 8 * 8 + toSq % 8;
         pieces[PAWN] ^= (1ULL << capSq);
-        Color capColor = p.color == WHITE ? BLACK : WHITE;
-        colors[capColor] ^= (1ULL << capSq);
-        pieceCount[capColor][PAWN]--;
+        colors[Them] ^= (1ULL << capSq);
+        pieceCount[Them][PAWN]--;
+        gameState.materialKey ^= Zobrist::materialKeys[Them][PAWN][pieceCount[Them][PAWN]];
         
-        Piece capPawn(PAWN, capColor);
+        Piece capPawn(PAWN, Them);
         pieceList[capSq] = Piece(EMPTY, WHITE);
+        if (NNUE::enabled) nnueUpdate(capPawn, capSq, false);
         
         gameState.mgScore -= getPieceValue(capPawn, capSq);
         gameState.egScore -= getPieceValueEg(capPawn, capSq);
-        gameState.zobristKey ^= Zobrist::pieceKeys[capColor][PAWN][capSq];
-        gameState.pawnKey ^= Zobrist::pieceKeys[capColor][PAWN][capSq];
+        gameState.zobristKey ^= Zobrist::pieceKeys[Them][PAWN][capSq];
+        gameState.pawnKey ^= Zobrist::pieceKeys[Them][PAWN][capSq];
     }
     
     // Add piece to bitboard (doing it after promotion check)
     pieces[p.type] ^= toMask;
-    colors[p.color] ^= toMask;
+    colors[Us] ^= toMask;
     
     // Update king pos
     if (p.type == KING) {
-        kingPos[p.color] = {m.toX, m.toY};
+        kingPos[Us] = {m.toX, m.toY};
     }
+    if (!NNUE::enabled) nnueDirty[WHITE] = nnueDirty[BLACK] = true;
     
-    // Remove old castling rights from Zobrist
-    int oldCastle = 0;
-    if (gameState.whiteCanCastleKingside) oldCastle |= 1;
-    if (gameState.whiteCanCastleQueenside) oldCastle |= 2;
-    if (gameState.blackCanCastleKingside) oldCastle |= 4;
-    if (gameState.blackCanCastleQueenside) oldCastle |= 8;
-    gameState.zobristKey ^= Zobrist::castleKeys[oldCastle];
-    
-    // Remove old en passant
-    if (gameState.hasEnPassant) {
-        gameState.zobristKey ^= Zobrist::enPassantKeys[gameState.enPassantY];
+    // Old en passant out, new one in: only a double push leaves a square behind
+    if (gameState.hasEnPassant()) {
+        gameState.zobristKey ^= Zobrist::enPassantKeys[gameState.epSquare % 8];
+    }
+    gameState.epSquare = NO_SQUARE;
+    if (p.type == PAWN && abs(toSq - fromSq) == 16) {
+        gameState.epSquare = (uint8_t)((fromSq + toSq) / 2);
+        gameState.zobristKey ^= Zobrist::enPassantKeys[gameState.epSquare % 8];
     }
     
-    updateGameState(m, p);
-    
-    // Add new castling rights
-    int newCastle = 0;
-    if (gameState.whiteCanCastleKingside) newCastle |= 1;
-    if (gameState.whiteCanCastleQueenside) newCastle |= 2;
-    if (gameState.blackCanCastleKingside) newCastle |= 4;
-    if (gameState.blackCanCastleQueenside) newCastle |= 8;
-    gameState.zobristKey ^= Zobrist::castleKeys[newCastle];
-    
-    // Add new en passant
-    if (gameState.hasEnPassant) {
-        gameState.zobristKey ^= Zobrist::enPassantKeys[gameState.enPassantY];
+    // Any move from or to a king or rook home square revokes the rights tied to it
+    uint8_t oldCastle = gameState.castlingRights;
+    gameState.castlingRights &= castlingMask[fromSq] & castlingMask[toSq];
+    if (gameState.castlingRights != oldCastle) {
+        gameState.zobristKey ^= Zobrist::castleKeys[oldCastle] ^ Zobrist::castleKeys[gameState.castlingRights];
     }
     
     // Switch turn
     gameState.zobristKey ^= Zobrist::sideKey;
+    gameState.sideToMove = Them;
+}
+
+template void Board::makeMove<WHITE>(const Move& m);
+template void Board::makeMove<BLACK>(const Move& m);
+
+void Board::makeMove(const Move& m) {
+    if (pieceList[m.fromX * 8 + m.fromY].color == WHITE) makeMove<WHITE>(m);
+    else makeMove<BLACK>(m);
 }
 
 void Board::undoMove(const Move& m, const Piece& captured, const GameState& prevState) {
@@ -538,7 +554,14 @@ void Board::undoMove(const Move& m, const Piece& captured, const GameState& prev
     int toSq = m.toX * 8 + m.toY;
     
     Piece p = pieceList[toSq]; // It's currently at toSq
+    attackInfoValid = false;
+    if (p.type == KING) nnueDirty[p.color] = true; // Restored from the saved copy below, not updated
+    if (NNUE::enabled) {
+        nnueUpdate(p, toSq, false);
+        if (captured.type != EMPTY) nnueUpdate(captured, toSq, true);
+    }
     if (m.promotion != EMPTY) p.type = PAWN;
+    if (NNUE::enabled) nnueUpdate(p, fromSq, true);
     
     Bitboard fromMask = 1ULL << fromSq;
     Bitboard toMask = 1ULL << toSq;
@@ -575,6 +598,10 @@ void Board::undoMove(const Move& m, const Piece& captured, const GameState& prev
         
         pieceList[rookFromSq] = Piece(ROOK, p.color);
         pieceList[rookToSq] = Piece(EMPTY, WHITE);
+        if (NNUE::enabled) {
+            nnueUpdate(Piece(ROOK, p.color), rookToSq, false);
+            nnueUpdate(Piece(ROOK, p.color), rookFromSq, true);
+        }
     } else if (m.isEnPassant) {
         int capSq = fromSq / 8 * 8 + toSq % 8;
         Color capColor = p.color == WHITE ? BLACK : WHITE;
@@ -583,64 +610,64 @@ void Board::undoMove(const Move& m, const Piece& captured, const GameState& prev
         pieceCount[capColor][PAWN]++;
         pieceList[capSq] = Piece(PAWN, capColor);
         pieceList[toSq] = Piece(EMPTY, WHITE); // Because it was empty before capture
+        if (NNUE::enabled) nnueUpdate(Piece(PAWN, capColor), capSq, true);
     }
     
     if (p.type == KING) {
         kingPos[p.color] = {m.fromX, m.fromY};
+        int slot = historyPly & (NNUE_KING_SLOTS - 1);
+        if (NNUE::enabled && nnueKingPly[slot] == historyPly) {
+            std::memcpy(nnueAcc[p.color], nnueKingAcc[slot], sizeof(nnueAcc[p.color]));
+            nnueDirty[p.color] = false;
+        }
+        nnueKingPly[slot] = -1;
     }
+    if (!NNUE::enabled) nnueDirty[WHITE] = nnueDirty[BLACK] = true;
     
     gameState = prevState;
     historyPly--;
 }
 
-void Board::updateGameState(const Move& m, const Piece& movingPiece) {
-    // Basic stuff
-    gameState.hasEnPassant = false;
-    if (movingPiece.type == PAWN && abs(m.fromX - m.toX) == 2) {
-        gameState.hasEnPassant = true;
-        gameState.enPassantX = (m.fromX + m.toX) / 2;
-        gameState.enPassantY = m.fromY;
-    }
-    
-    if (movingPiece.type == KING) {
-        if (movingPiece.color == WHITE) {
-            gameState.whiteCanCastleKingside = false;
-            gameState.whiteCanCastleQueenside = false;
-        } else {
-            gameState.blackCanCastleKingside = false;
-            gameState.blackCanCastleQueenside = false;
-        }
-    } else if (movingPiece.type == ROOK) {
-        if (m.fromX == 0 && m.fromY == 0) gameState.whiteCanCastleQueenside = false;
-        if (m.fromX == 0 && m.fromY == 7) gameState.whiteCanCastleKingside = false;
-        if (m.fromX == 7 && m.fromY == 0) gameState.blackCanCastleQueenside = false;
-        if (m.fromX == 7 && m.fromY == 7) gameState.blackCanCastleKingside = false;
-    }
-    // Handle rook captures revoking castling rights
-    if (m.toX == 0 && m.toY == 0) gameState.whiteCanCastleQueenside = false;
-    if (m.toX == 0 && m.toY == 7) gameState.whiteCanCastleKingside = false;
-    if (m.toX == 7 && m.toY == 0) gameState.blackCanCastleQueenside = false;
-    if (m.toX == 7 && m.toY == 7) gameState.blackCanCastleKingside = false;
+void Board::nnueUpdate(Piece p, int sq, bool add) {
+    if (p.type == KING) return; // Kings are not input features
+    for (int c = 0; c < 2; c++) {
+        if (nnueDirty[c]) continue;
+        int kingSq = kingPos[c].first * 8 + kingPos[c].second;
+        int index = NNUE::featureIndex((Color)c, kingSq, p, sq);
+        if (add) NNUE::addFeature(nnueAcc[c], index);
+        else NNUE::subFeature(nnueAcc[c], index);
+    }
 }
 
-void Board::generatePawnMoves(Color color, MoveList& moves, Bitboard target) {
-    Bitboard pawns = pieces[PAWN] & colors[color];
+// Promotion pushes all four pieces for one from/to pair
+static inline void pushPromotions(Board::MoveList& moves, int fromSq, int toSq) {
+    moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, QUEEN));
+    moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, ROOK));
+    moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, BISHOP));
+    moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, KNIGHT));
+}
+
+template<Color Us>
+void Board::generatePawnMoves(MoveList& moves, Bitboard target) {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
+    constexpr int Up = Us == WHITE ? 8 : -8;
+    constexpr int UpLeft = Us == WHITE ? 7 : -9;
+    constexpr int UpRight = Us == WHITE ? 9 : -7;
+    constexpr Bitboard ThirdRank = Us == WHITE ? 0x0000000000FF0000ULL : 0x0000FF0000000000ULL;
+    constexpr Bitboard LastRank = Us == WHITE ? 0xFF00000000000000ULL : 0x00000000000000FFULL;
+    
+    Bitboard pawns = pieces[PAWN] & colors[Us];
     Bitboard empty = ~(colors[WHITE] | colors[BLACK]);
-    Bitboard enemies = colors[color == WHITE ? BLACK : WHITE];
-    int dir = (color == WHITE) ? 8 : -8;
+    Bitboard enemies = colors[Them];
     
     // Single push
-    Bitboard singlePushes = (color == WHITE ? pawns << 8 : pawns >> 8) & empty;
-    Bitboard validPushes = singlePushes & target;
-    Bitboard p = validPushes;
+    Bitboard singlePushes = (Us == WHITE ? pawns << 8 : pawns >> 8) & empty;
+    Bitboard p = singlePushes & target;
     while (p) {
         int toSq = __builtin_ctzll(p);
-        int fromSq = toSq - dir;
-        if (toSq / 8 == (color == WHITE ? 7 : 0)) {
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, QUEEN));
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, ROOK));
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, BISHOP));
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, KNIGHT));
+        int fromSq = toSq - Up;
+        if (setBit(toSq) & LastRank) {
+            pushPromotions(moves, fromSq, toSq);
         } else {
             moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8));
         }
@@ -648,46 +675,37 @@ void Board::generatePawnMoves(Color color, MoveList& moves, Bitboard target) {
     }
     
     // Double push
-    Bitboard doublePushes = (color == WHITE ? (singlePushes & 0x0000000000FF0000ULL) << 8 : (singlePushes & 0x0000FF0000000000ULL) >> 8) & empty;
-    validPushes = doublePushes & target;
-    p = validPushes;
+    Bitboard doublePushes = (Us == WHITE ? (singlePushes & ThirdRank) << 8 : (singlePushes & ThirdRank) >> 8) & empty;
+    p = doublePushes & target;
     while (p) {
         int toSq = __builtin_ctzll(p);
-        int fromSq = toSq - 2 * dir;
+        int fromSq = toSq - 2 * Up;
         moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8));
         p &= p - 1;
     }
     
     // Captures
-    Bitboard attacksLeft = (color == WHITE) ? (pawns & ~0x0101010101010101ULL) << 7 : (pawns & ~0x0101010101010101ULL) >> 9;
-    Bitboard attacksRight = (color == WHITE) ? (pawns & ~0x8080808080808080ULL) << 9 : (pawns & ~0x8080808080808080ULL) >> 7;
+    Bitboard attacksLeft = Us == WHITE ? (pawns & ~0x0101010101010101ULL) << 7 : (pawns & ~0x0101010101010101ULL) >> 9;
+    Bitboard attacksRight = Us == WHITE ? (pawns & ~0x8080808080808080ULL) << 9 : (pawns & ~0x8080808080808080ULL) >> 7;
     
-    Bitboard validLeft = attacksLeft & enemies & target;
-    p = validLeft;
+    p = attacksLeft & enemies & target;
     while (p) {
         int toSq = __builtin_ctzll(p);
-        int fromSq = toSq - (color == WHITE ? 7 : -9);
-        if (toSq / 8 == (color == WHITE ? 7 : 0)) {
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, QUEEN));
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, ROOK));
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, BISHOP));
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, KNIGHT));
+        int fromSq = toSq - UpLeft;
+        if (setBit(toSq) & LastRank) {
+            pushPromotions(moves, fromSq, toSq);
         } else {
             moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8));
         }
         p &= p - 1;
     }
     
-    Bitboard validRight = attacksRight & enemies & target;
-    p = validRight;
+    p = attacksRight & enemies & target;
     while (p) {
         int toSq = __builtin_ctzll(p);
-        int fromSq = toSq - (color == WHITE ? 9 : -7);
-        if (toSq / 8 == (color == WHITE ? 7 : 0)) {
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, QUEEN));
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, ROOK));
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, BISHOP));
-            moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, KNIGHT));
+        int fromSq = toSq - UpRight;
+        if (setBit(toSq) & LastRank) {
+            pushPromotions(moves, fromSq, toSq);
         } else {
             moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8));
         }
@@ -695,28 +713,25 @@ void Board::generatePawnMoves(Color color, MoveList& moves, Bitboard target) {
     }
     
     // En passant
-    if (gameState.hasEnPassant) {
-        int epSq = gameState.enPassantX * 8 + gameState.enPassantY;
+    if (gameState.hasEnPassant()) {
+        int epSq = gameState.epSquare;
         Bitboard epMask = 1ULL << epSq;
         if (epMask & target) {
-            Bitboard epLeft = attacksLeft & epMask;
-            if (epLeft) {
-                int toSq = __builtin_ctzll(epLeft);
-                int fromSq = toSq - (color == WHITE ? 7 : -9);
-                moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, EMPTY, true));
+            if (attacksLeft & epMask) {
+                int fromSq = epSq - UpLeft;
+                moves.push_back(Move(fromSq/8, fromSq%8, epSq/8, epSq%8, EMPTY, true));
             }
-            Bitboard epRight = attacksRight & epMask;
-            if (epRight) {
-                int toSq = __builtin_ctzll(epRight);
-                int fromSq = toSq - (color == WHITE ? 9 : -7);
-                moves.push_back(Move(fromSq/8, fromSq%8, toSq/8, toSq%8, EMPTY, true));
+            if (attacksRight & epMask) {
+                int fromSq = epSq - UpRight;
+                moves.push_back(Move(fromSq/8, fromSq%8, epSq/8, epSq%8, EMPTY, true));
             }
         }
     }
 }
 
-void Board::generateKnightMoves(Color color, MoveList& moves, Bitboard target) {
-    Bitboard knights = pieces[KNIGHT] & colors[color];
+template<Color Us>
+void Board::generateKnightMoves(MoveList& moves, Bitboard target) {
+    Bitboard knights = pieces[KNIGHT] & colors[Us];
     while (knights) {
         int sq = __builtin_ctzll(knights);
         Bitboard attacks = Attacks::knightAttacks[sq] & target;
@@ -729,8 +744,9 @@ void Board::generateKnightMoves(Color color, MoveList& moves, Bitboard target) {
     }
 }
 
-void Board::generateBishopMoves(Color color, MoveList& moves, Bitboard target) {
-    Bitboard bishops = pieces[BISHOP] & colors[color];
+template<Color Us>
+void Board::generateBishopMoves(MoveList& moves, Bitboard target) {
+    Bitboard bishops = pieces[BISHOP] & colors[Us];
     Bitboard occ = colors[WHITE] | colors[BLACK];
     while (bishops) {
         int sq = __builtin_ctzll(bishops);
@@ -744,8 +760,9 @@ void Board::generateBishopMoves(Color color, MoveList& moves, Bitboard target) {
     }
 }
 
-void Board::generateRookMoves(Color color, MoveList& moves, Bitboard target) {
-    Bitboard rooks = pieces[ROOK] & colors[color];
+template<Color Us>
+void Board::generateRookMoves(MoveList& moves, Bitboard target) {
+    Bitboard rooks = pieces[ROOK] & colors[Us];
     Bitboard occ = colors[WHITE] | colors[BLACK];
     while (rooks) {
         int sq = __builtin_ctzll(rooks);
@@ -759,8 +776,9 @@ void Board::generateRookMoves(Color color, MoveList& moves, Bitboard target) {
     }
 }
 
-void Board::generateQueenMoves(Color color, MoveList& moves, Bitboard target) {
-    Bitboard queens = pieces[QUEEN] & colors[color];
+template<Color Us>
+void Board::generateQueenMoves(MoveList& moves, Bitboard target) {
+    Bitboard queens = pieces[QUEEN] & colors[Us];
     Bitboard occ = colors[WHITE] | colors[BLACK];
     while (queens) {
         int sq = __builtin_ctzll(queens);
@@ -774,11 +792,19 @@ void Board::generateQueenMoves(Color color, MoveList& moves, Bitboard target) {
     }
 }
 
-void Board::generateKingMoves(Color color, MoveList& moves, Bitboard target) {
-    Bitboard king = pieces[KING] & colors[color];
+template<Color Us>
+void Board::generateKingMoves(MoveList& moves, Bitboard target) {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
+    constexpr int Rank = Us == WHITE ? 0 : 7;
+    constexpr int KingSq = Rank * 8 + 4;
+    
+    Bitboard king = pieces[KING] & colors[Us];
     if (king) {
         int sq = __builtin_ctzll(king);
         Bitboard attacks = Attacks::kingAttacks[sq] & target;
+        // With the attack map at hand, skip squares the enemy already covers:
+        // they stay attacked whatever the king does, so those moves are illegal.
+        if (attackInfoValid) attacks &= ~attackInfo.attacks[Them][EMPTY];
         while (attacks) {
             int toSq = __builtin_ctzll(attacks);
             moves.push_back(Move(sq/8, sq%8, toSq/8, toSq%8));
@@ -786,66 +812,209 @@ void Board::generateKingMoves(Color color, MoveList& moves, Bitboard target) {
         }
         
         // Castling
-        if (!isInCheck(color)) {
-            if (color == WHITE) {
-                if (gameState.whiteCanCastleKingside) {
-                    if (!((colors[WHITE] | colors[BLACK]) & ((1ULL << 5) | (1ULL << 6)))) {
-                        if (!isSquareUnderAttack(5, BLACK) && !isSquareUnderAttack(6, BLACK)) {
-                            moves.push_back(Move(0, 4, 0, 6, EMPTY, false, true));
-                        }
-                    }
+        bool kingside = gameState.castlingRights & (Us == WHITE ? WHITE_KINGSIDE : BLACK_KINGSIDE);
+        bool queenside = gameState.castlingRights & (Us == WHITE ? WHITE_QUEENSIDE : BLACK_QUEENSIDE);
+        if ((kingside || queenside) && !isInCheck<Us>()) {
+            Bitboard occ = colors[WHITE] | colors[BLACK];
+            if (kingside && !(occ & (setBit(KingSq + 1) | setBit(KingSq + 2)))) {
+                if (!isSquareUnderAttack<Them>(KingSq + 1) && !isSquareUnderAttack<Them>(KingSq + 2)) {
+                    moves.push_back(Move(Rank, 4, Rank, 6, EMPTY, false, true));
                 }
-                if (gameState.whiteCanCastleQueenside) {
-                    if (!((colors[WHITE] | colors[BLACK]) & ((1ULL << 1) | (1ULL << 2) | (1ULL << 3)))) {
-                        if (!isSquareUnderAttack(2, BLACK) && !isSquareUnderAttack(3, BLACK)) {
-                            moves.push_back(Move(0, 4, 0, 2, EMPTY, false, true));
-                        }
-                    }
-                }
-            } else {
-                if (gameState.blackCanCastleKingside) {
-                    if (!((colors[WHITE] | colors[BLACK]) & ((1ULL << 61) | (1ULL << 62)))) {
-                        if (!isSquareUnderAttack(61, WHITE) && !isSquareUnderAttack(62, WHITE)) {
-                            moves.push_back(Move(7, 4, 7, 6, EMPTY, false, true));
-                        }
-                    }
-                }
-                if (gameState.blackCanCastleQueenside) {
-                    if (!((colors[WHITE] | colors[BLACK]) & ((1ULL << 57) | (1ULL << 58) | (1ULL << 59)))) {
-                        if (!isSquareUnderAttack(58, WHITE) && !isSquareUnderAttack(59, WHITE)) {
-                            moves.push_back(Move(7, 4, 7, 2, EMPTY, false, true));
-                        }
-                    }
+            }
+            if (queenside && !(occ & (setBit(KingSq - 1) | setBit(KingSq - 2) | setBit(KingSq - 3)))) {
+                if (!isSquareUnderAttack<Them>(KingSq - 2) && !isSquareUnderAttack<Them>(KingSq - 1)) {
+                    moves.push_back(Move(Rank, 4, Rank, 2, EMPTY, false, true));
                 }
             }
         }
     }
 }
 
-void Board::generateMoves(Color color, MoveList& moves) {
-    Bitboard target = ~colors[color]; // Can move to empty or enemy squares
-    generatePawnMoves(color, moves, target);
-    generateKnightMoves(color, moves, target);
-    generateBishopMoves(color, moves, target);
-    generateRookMoves(color, moves, target);
-    generateQueenMoves(color, moves, target);
-    generateKingMoves(color, moves, target);
+template<Color Us>
+void Board::generateMoves(MoveList& moves) {
+    Bitboard target = ~colors[Us]; // Can move to empty or enemy squares
+    generatePawnMoves<Us>(moves, target);
+    generateKnightMoves<Us>(moves, target);
+    generateBishopMoves<Us>(moves, target);
+    generateRookMoves<Us>(moves, target);
+    generateQueenMoves<Us>(moves, target);
+    generateKingMoves<Us>(moves, target);
 }
 
-void Board::generateLegalMoves(Color color, MoveList& legalMoves) {
+template<Color Us>
+bool Board::isLegal(const Move& m) const {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
+    // Castling was checked against attacks on the king's path when it was generated
+    if (m.isCastle) return true;
+    
+    int fromSq = m.fromX * 8 + m.fromY;
+    int toSq = m.toX * 8 + m.toY;
+    int ksq = pieceList[fromSq].type == KING ? toSq : kingPos[Us].first * 8 + kingPos[Us].second;
+    Bitboard occ = ((colors[WHITE] | colors[BLACK]) ^ setBit(fromSq)) | setBit(toSq);
+    Bitboard theirs = colors[Them] & ~setBit(toSq); // A captured piece no longer attacks
+    if (m.isEnPassant) {
+        int capSq = fromSq / 8 * 8 + toSq % 8;
+        occ ^= setBit(capSq);
+        theirs ^= setBit(capSq);
+    }
+    return !(attackersTo(ksq, occ) & theirs);
+}
+
+template bool Board::isLegal<WHITE>(const Move& m) const;
+template bool Board::isLegal<BLACK>(const Move& m) const;
+
+template<Color Us>
+bool Board::isPseudoLegal(const Move& m) const {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
+    constexpr int Rank = Us == WHITE ? 0 : 7;
+    constexpr int KingSq = Rank * 8 + 4;
+    constexpr int Up = Us == WHITE ? 8 : -8;
+    
+    int fromSq = m.fromX * 8 + m.fromY;
+    int toSq = m.toX * 8 + m.toY;
+    const Piece& p = pieceList[fromSq];
+    if (p.type == EMPTY || p.color != Us || (colors[Us] & setBit(toSq))) return false;
+    Bitboard occ = colors[WHITE] | colors[BLACK];
+    
+    if (m.isCastle) {
+        if (p.type != KING || fromSq != KingSq || m.promotion != EMPTY || isInCheck<Us>()) return false;
+        if (toSq == KingSq + 2) {
+            return (gameState.castlingRights & (Us == WHITE ? WHITE_KINGSIDE : BLACK_KINGSIDE))
+                && !(occ & (setBit(KingSq + 1) | setBit(KingSq + 2)))
+                && !isSquareUnderAttack<Them>(KingSq + 1) && !isSquareUnderAttack<Them>(KingSq + 2);
+        }
+        if (toSq == KingSq - 2) {
+            return (gameState.castlingRights & (Us == WHITE ? WHITE_QUEENSIDE : BLACK_QUEENSIDE))
+                && !(occ & (setBit(KingSq - 1) | setBit(KingSq - 2) | setBit(KingSq - 3)))
+                && !isSquareUnderAttack<Them>(KingSq - 1) && !isSquareUnderAttack<Them>(KingSq - 2);
+        }
+        return false;
+    }
+    
+    if (p.type != PAWN) {
+        if (m.isEnPassant || m.promotion != EMPTY) return false;
+        Bitboard attacks = 0;
+        switch (p.type) {
+            case KNIGHT: attacks = Attacks::knightAttacks[fromSq]; break;
+            case BISHOP: attacks = Attacks::getBishopAttacks(fromSq, occ); break;
+            case ROOK:   attacks = Attacks::getRookAttacks(fromSq, occ); break;
+            case QUEEN:  attacks = Attacks::getQueenAttacks(fromSq, occ); break;
+            default:     attacks = Attacks::kingAttacks[fromSq]; break;
+        }
+        return (attacks & setBit(toSq)) != 0;
+    }
+    
+    // Pawns: the promotion piece must be given exactly when the last rank is reached
+    bool lastRank = m.toX == (Us == WHITE ? 7 : 0);
+    if (lastRank != (m.promotion != EMPTY) || m.promotion == PAWN || m.promotion == KING) return false;
+    if (m.isEnPassant) {
+        return toSq == gameState.epSquare && (Attacks::pawnAttacks[Us][fromSq] & setBit(toSq));
+    }
+    if (Attacks::pawnAttacks[Us][fromSq] & setBit(toSq)) return (colors[Them] & setBit(toSq)) != 0;
+    if (toSq == fromSq + Up) return !(occ & setBit(toSq));
+    if (toSq == fromSq + 2 * Up && m.fromX == (Us == WHITE ? 1 : 6)) {
+        return !(occ & (setBit(toSq) | setBit(fromSq + Up)));
+    }
+    return false;
+}
+
+template bool Board::isPseudoLegal<WHITE>(const Move& m) const;
+template bool Board::isPseudoLegal<BLACK>(const Move& m) const;
+
+template<Color Us>
+Bitboard Board::pinnedPieces() const {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
+    int ksq = kingPos[Us].first * 8 + kingPos[Us].second;
+    Bitboard occ = colors[WHITE] | colors[BLACK];
+    Bitboard snipers = ((Attacks::getRookAttacks(ksq, 0) & (pieces[ROOK] | pieces[QUEEN]))
+                      | (Attacks::getBishopAttacks(ksq, 0) & (pieces[BISHOP] | pieces[QUEEN]))) & colors[Them];
+    Bitboard pinned = 0;
+    for (; snipers; snipers &= snipers - 1) {
+        Bitboard between = Attacks::getBetween(ksq, __builtin_ctzll(snipers)) & occ;
+        if (!(between & (between - 1))) pinned |= between & colors[Us];
+    }
+    return pinned;
+}
+
+template<Color Us>
+void Board::generateLegalMoves(MoveList& legalMoves) {
     MoveList pseudoMoves;
-    generateMoves(color, pseudoMoves);
+    generateMoves<Us>(pseudoMoves);
+    
+    // Out of check, only king moves, en passant and moves of pinned pieces can expose the king
+    Bitboard needsCheck = ~0ULL;
+    if (!isInCheck<Us>()) needsCheck = pinnedPieces<Us>() | setBit(kingPos[Us].first * 8 + kingPos[Us].second);
     
     for (int i=0; i<pseudoMoves.size(); ++i) {
-        Move m = pseudoMoves[i];
-        Piece captured = getPiece(m.toX * 8 + m.toY);
-        GameState prevState = gameState;
-        makeMove(m);
-        if (!isInCheck(color)) {
-            legalMoves.push_back(m);
+        const Move& m = pseudoMoves[i];
+        if (((needsCheck & setBit(m.fromX * 8 + m.fromY)) || m.isEnPassant) && !isLegal<Us>(m)) continue;
+        legalMoves.push_back(m);
+    }
+}
+
+template<Color Us>
+int Board::countLegalMoves() {
+    if (isInCheck<Us>()) {
+        MoveList evasions;
+        generateLegalMoves<Us>(evasions);
+        return evasions.size();
+    }
+    
+    Bitboard pinned = pinnedPieces<Us>();
+    Bitboard target = ~colors[Us];
+    Bitboard occ = colors[WHITE] | colors[BLACK];
+    
+    // Pawn moves (promotions, en passant) and king moves are few; check them one by one
+    MoveList moves;
+    generatePawnMoves<Us>(moves, target);
+    generateKingMoves<Us>(moves, target);
+    Bitboard needsCheck = pinned | (pieces[KING] & colors[Us]);
+    int count = 0;
+    for (int i = 0; i < moves.size(); i++) {
+        const Move& m = moves[i];
+        if (((needsCheck & setBit(m.fromX * 8 + m.fromY)) || m.isEnPassant) && !isLegal<Us>(m)) continue;
+        count++;
+    }
+    
+    // Every target of an unpinned piece is a legal move
+    for (Bitboard bb = (pieces[KNIGHT] | pieces[BISHOP] | pieces[ROOK] | pieces[QUEEN]) & colors[Us]; bb; bb &= bb - 1) {
+        int sq = __builtin_ctzll(bb);
+        Bitboard attacks;
+        switch (pieceList[sq].type) {
+            case KNIGHT: attacks = Attacks::knightAttacks[sq]; break;
+            case BISHOP: attacks = Attacks::getBishopAttacks(sq, occ); break;
+            case ROOK:   attacks = Attacks::getRookAttacks(sq, occ); break;
+            default:     attacks = Attacks::getQueenAttacks(sq, occ); break;
+        }
+        attacks &= target;
+        if (!(pinned & setBit(sq))) {
+            count += __builtin_popcountll(attacks);
+            continue;
+        }
+        for (; attacks; attacks &= attacks - 1) {
+            int toSq = __builtin_ctzll(attacks);
+            if (isLegal<Us>(Move(sq / 8, sq % 8, toSq / 8, toSq % 8))) count++;
         }
-        undoMove(m, captured, prevState);
     }
+    return count;
+}
+
+template int Board::countLegalMoves<WHITE>();
+template int Board::countLegalMoves<BLACK>();
+
+template void Board::generateMoves<WHITE>(MoveList& moves);
+template void Board::generateMoves<BLACK>(MoveList& moves);
+template void Board::generateLegalMoves<WHITE>(MoveList& legalMoves);
+template void Board::generateLegalMoves<BLACK>(MoveList& legalMoves);
+
+void Board::generateMoves(Color color, MoveList& moves) {
+    if (color == WHITE) generateMoves<WHITE>(moves);
+    else generateMoves<BLACK>(moves);
+}
+
+void Board::generateLegalMoves(Color color, MoveList& legalMoves) {
+    if (color == WHITE) generateLegalMoves<WHITE>(legalMoves);
+    else generateLegalMoves<BLACK>(legalMoves);
 }
 
 bool Board::isCheckmate(Color color) {
@@ -866,150 +1035,207 @@ bool Board::hasNonPawnMaterial(Color color) const {
     return (pieces[KNIGHT] | pieces[BISHOP] | pieces[ROOK] | pieces[QUEEN]) & colors[color];
 }
 
-bool Board::isInsufficientMaterial() {
-    Bitboard allPieces = colors[WHITE] | colors[BLACK];
-    if (pieces[PAWN] || pieces[ROOK] || pieces[QUEEN]) return false;
-    
-    int whiteKnights = __builtin_popcountll(pieces[KNIGHT] & colors[WHITE]);
-    int blackKnights = __builtin_popcountll(pieces[KNIGHT] & colors[BLACK]);
-    int whiteBishops = __builtin_popcountll(pieces[BISHOP] & colors[WHITE]);
-    int blackBishops = __builtin_popcountll(pieces[BISHOP] & colors[BLACK]);
-    
-    if (whiteKnights == 0 && blackKnights == 0 && whiteBishops == 0 && blackBishops == 0) return true;
-    if (whiteKnights == 1 && blackKnights == 0 && whiteBishops == 0 && blackBishops == 0) return true;
-    if (whiteKnights == 0 && blackKnights == 1 && whiteBishops == 0 && blackBishops == 0) return true;
-    if (whiteKnights == 0 && blackKnights == 0 && whiteBishops == 1 && blackBishops == 0) return true;
-    if (whiteKnights == 0 && blackKnights == 0 && whiteBishops == 0 && blackBishops == 1) return true;
-    return false;
+bool Board::isInsufficientMaterial() const {
+    // Decided once per material signature (see Endgame::initMaterial)
+    return (materialEntry().flags & MATERIAL_DRAW) != 0;
 }
 
 bool Board::isRepetition() const {
-    if (historyPly < 4) return false;
-    int reps = 0;
-    for (int i = historyPly - 4; i >= 0; i -= 2) {
+    // Positions before the last capture or pawn move can never recur,
+    // so only scan back as far as the halfmove clock allows.
+    int oldest = historyPly - gameState.halfmoveClock;
+    if (oldest < 0) oldest = 0;
+    for (int i = historyPly - 4; i >= oldest; i -= 2) {
         if (history[i] == gameState.zobristKey) {
-            reps++;
-            if (reps >= 1) return true; // 2-fold repetition in our context for fast draw detection
+            return true; // 2-fold repetition in our context for fast draw detection
         }
     }
     return false;
 }
 
-bool Board::isDraw() {
-    return gameState.halfmoveClock >= 100 || isRepetition() || isInsufficientMaterial();
-}
-
-std::pair<int, int> Board::evaluatePawnStructure() {
-    int hashIndex = gameState.pawnKey & 16383;
-    PawnEntry& entry = pawnTable[hashIndex];
-    if (entry.valid && entry.key == gameState.pawnKey) {
-        return {entry.mgScore, entry.egScore};
-    }
+bool Board::hasGameCycle(int ply) const {
+    // Only positions since the last irreversible move (or null move) can recur
+    int end = std::min((int)gameState.halfmoveClock, historyPly);
+    if (end < 3) return false;
     
-    int mgScore = 0;
-    int egScore = 0;
-    
-    Bitboard whitePawns = pieces[PAWN] & colors[WHITE];
-    Bitboard blackPawns = pieces[PAWN] & colors[BLACK];
-    
-    int whitePawnsOnFile[8] = {0};
-    int blackPawnsOnFile[8] = {0};
-    
-    Bitboard wp = whitePawns;
-    while (wp) {
-        int sq = __builtin_ctzll(wp);
-        whitePawnsOnFile[sq % 8]++;
-        wp &= wp - 1;
-    }
-    Bitboard bp = blackPawns;
-    while (bp) {
-        int sq = __builtin_ctzll(bp);
-        blackPawnsOnFile[sq % 8]++;
-        bp &= bp - 1;
+    unsigned long long originalKey = gameState.zobristKey;
+    Bitboard occ = colors[WHITE] | colors[BLACK];
+    for (int i = 3; i <= end; i += 2) {
+        // Keys differ by exactly one reversible move of the side to move?
+        unsigned long long moveKey = originalKey ^ history[historyPly - i];
+        int j = Zobrist::cuckooH1(moveKey);
+        if (Zobrist::cuckoo[j] != moveKey) {
+            j = Zobrist::cuckooH2(moveKey);
+            if (Zobrist::cuckoo[j] != moveKey) continue;
+        }
+        int s1 = Zobrist::cuckooMove[j] & 63;
+        int s2 = Zobrist::cuckooMove[j] >> 6;
+        if (Attacks::getBetween(s1, s2) & occ) continue;
+        
+        // Only trust cycles that lie entirely inside the search tree; repeating a
+        // pre-root position once is not yet a draw under the real rules.
+        if (ply > i) return true;
     }
+    return false;
+}
+
+bool Board::isDraw() const {
+    return gameState.halfmoveClock >= 100 || isInsufficientMaterial() || isRepetition();
+}
+
+static inline Bitboard pawnAttackSet(Bitboard pawns, Color c) {
+    const Bitboard notFileA = ~0x0101010101010101ULL;
+    const Bitboard notFileH = ~0x8080808080808080ULL;
+    if (c == WHITE) return ((pawns & notFileA) << 7) | ((pawns & notFileH) << 9);
+    return ((pawns & notFileA) >> 9) | ((pawns & notFileH) >> 7);
+}
+
+static inline Bitboard fillForward(Bitboard b, Color c) {
+    if (c == WHITE) { b |= b << 8; b |= b << 16; b |= b << 32; }
+    else { b |= b >> 8; b |= b >> 16; b |= b >> 32; }
+    return b;
+}
+
+const MaterialEntry& Board::materialEntry() const {
+    bool found;
+    MaterialEntry* entry = MaterialHashTable::local().probe(gameState.materialKey, found);
+    if (!found) Endgame::initMaterial(*this, *entry);
+    return *entry;
+}
+
+const PawnEntry& Board::pawnEntry() const {
+    bool found;
+    PawnEntry* entry = PawnHashTable::local().probe(gameState.pawnKey, found);
+    if (!found) computePawnEntry(*entry);
+    return *entry;
+}
+
+void Board::computePawnEntry(PawnEntry& entry) const {
+    Bitboard pawns[2] = { pieces[PAWN] & colors[WHITE], pieces[PAWN] & colors[BLACK] };
     
-    for (int f = 0; f < 8; f++) {
-        if (whitePawnsOnFile[f] > 1) {
-            mgScore -= (whitePawnsOnFile[f] - 1) * 50;
-            egScore -= (whitePawnsOnFile[f] - 1) * 50;
-        }
-        if (blackPawnsOnFile[f] > 1) {
-            mgScore += (blackPawnsOnFile[f] - 1) * 50;
-            egScore += (blackPawnsOnFile[f] - 1) * 50;
-        }
+    entry.key = gameState.pawnKey;
+    entry.passed = entry.isolated = entry.backward = 0;
+    entry.mgScore = entry.egScore = 0;
+    for (int c = WHITE; c <= BLACK; c++) {
+        entry.attackSpan[c] = fillForward(pawnAttackSet(pawns[c], (Color)c), (Color)c);
     }
     
-    wp = whitePawns;
-    while (wp) {
-        int sq = __builtin_ctzll(wp);
-        int r = sq / 8;
-        int f = sq % 8;
-        if (whitePawnsOnFile[f] == 1) {
-            bool isolated = true;
-            if (f > 0 && whitePawnsOnFile[f-1] > 0) isolated = false;
-            if (f < 7 && whitePawnsOnFile[f+1] > 0) isolated = false;
-            if (isolated) { mgScore -= 20; egScore -= 20; }
-        }
-        bool passed = true;
-        for (int checkR = r + 1; checkR < 8 && passed; checkR++) {
-            for (int df = -1; df <= 1; df++) {
-                int cf = f + df;
-                if (cf >= 0 && cf < 8 && ((blackPawns >> (checkR * 8 + cf)) & 1)) { passed = false; break; }
+    for (int c = WHITE; c <= BLACK; c++) {
+        Color opp = (c == WHITE) ? BLACK : WHITE;
+        int sign = (c == WHITE) ? 1 : -1;
+        Bitboard enemyPawnAttacks = pawnAttackSet(pawns[opp], opp);
+        
+        for (int f = 0; f < 8; f++) {
+            int onFile = __builtin_popcountll(pawns[c] & (0x0101010101010101ULL << f));
+            if (onFile > 1) {
+                entry.mgScore -= sign * (onFile - 1) * EvalParams::DOUBLED_PAWN_MG;
+                entry.egScore -= sign * (onFile - 1) * EvalParams::DOUBLED_PAWN_EG;
             }
         }
-        if (passed) {
-            int bonus = 20 + (r - 1) * 10;
-            mgScore += bonus;
-            egScore += bonus * 2;
-        }
-        wp &= wp - 1;
-    }
-    
-    bp = blackPawns;
-    while (bp) {
-        int sq = __builtin_ctzll(bp);
-        int r = sq / 8;
-        int f = sq % 8;
-        if (blackPawnsOnFile[f] == 1) {
-            bool isolated = true;
-            if (f > 0 && blackPawnsOnFile[f-1] > 0) isolated = false;
-            if (f < 7 && blackPawnsOnFile[f+1] > 0) isolated = false;
-            if (isolated) { mgScore += 20; egScore += 20; }
+        
+        for (Bitboard bb = pawns[c]; bb; bb &= bb - 1) {
+            int sq = __builtin_ctzll(bb);
+            int f = sq % 8;
+            int relRank = (c == WHITE) ? sq / 8 : 7 - sq / 8;
+            Bitboard bit = 1ULL << sq;
+            
+            if (!(pawns[c] & Attacks::adjacentFilesMask[f])) {
+                entry.isolated |= bit;
+                entry.mgScore -= sign * EvalParams::ISOLATED_PAWN_MG;
+                entry.egScore -= sign * EvalParams::ISOLATED_PAWN_EG;
+            } else {
+                // Stop square covered by an enemy pawn and out of reach of our own pawns' support
+                Bitboard stop = 1ULL << (c == WHITE ? sq + 8 : sq - 8);
+                if ((enemyPawnAttacks & stop) && !(entry.attackSpan[c] & stop)) {
+                    entry.backward |= bit;
+                    entry.mgScore -= sign * EvalParams::BACKWARD_PAWN_MG;
+                    entry.egScore -= sign * EvalParams::BACKWARD_PAWN_EG;
+                }
+            }
+            
+            if (!(Attacks::passedPawnMask[c][sq] & pawns[opp])) {
+                entry.passed |= bit;
+                entry.mgScore += sign * EvalParams::PASSED_PAWN_MG[relRank];
+                entry.egScore += sign * EvalParams::PASSED_PAWN_EG[relRank];
+            }
         }
-        bool passed = true;
-        for (int checkR = r - 1; checkR >= 0 && passed; checkR--) {
-            for (int df = -1; df <= 1; df++) {
-                int cf = f + df;
-                if (cf >= 0 && cf < 8 && ((whitePawns >> (checkR * 8 + cf)) & 1)) { passed = false; break; }
+        
+        // King shelter: missing pawns in front of a castled king, or a king stuck in the centre
+        int kf = kingPos[c].second;
+        int flip = (c == WHITE) ? 0 : 56;
+        int mgPenalty = 0, egPenalty = 0;
+        if (kf >= 5) {
+            for (int i = 0; i < 3; i++) {
+                if (!(pawns[c] & (1ULL << ((13 + i) ^ flip)))) {
+                    mgPenalty += EvalParams::KING_SHELTER_KINGSIDE_MG[i];
+                    egPenalty += EvalParams::KING_SHELTER_KINGSIDE_EG[i];
+                }
             }
+            if (pawns[c] & (1ULL << (22 ^ flip))) {
+                mgPenalty -= EvalParams::KING_SHELTER_FIANCHETTO_MG;
+                egPenalty -= EvalParams::KING_SHELTER_FIANCHETTO_EG;
+            }
+        } else if (kf <= 2) {
+            for (int i = 0; i < 3; i++) {
+                if (!(pawns[c] & (1ULL << ((8 + i) ^ flip)))) {
+                    mgPenalty += EvalParams::KING_SHELTER_QUEENSIDE_MG[i];
+                    egPenalty += EvalParams::KING_SHELTER_QUEENSIDE_EG[i];
+                }
+            }
+        } else {
+            mgPenalty += EvalParams::KING_IN_CENTER_MG;
+            egPenalty += EvalParams::KING_IN_CENTER_EG;
         }
-        if (passed) {
-            int bonus = 20 + (6 - r) * 10;
-            mgScore -= bonus;
-            egScore -= bonus * 2;
+        entry.shelter[c][0] = mgPenalty;
+        entry.shelter[c][1] = egPenalty;
+        
+        // Pawn storm: the most advanced enemy pawn on each file around the king
+        int centre = kf < 1 ? 1 : (kf > 6 ? 6 : kf);
+        entry.storm[c][0] = entry.storm[c][1] = 0;
+        for (int f = centre - 1; f <= centre + 1; f++) {
+            Bitboard stormers = pawns[opp] & (0x0101010101010101ULL << f);
+            if (!stormers) continue;
+            int sq = (c == WHITE) ? __builtin_ctzll(stormers) : 63 - __builtin_clzll(stormers);
+            int relRank = (opp == WHITE) ? sq / 8 : 7 - sq / 8;
+            entry.storm[c][0] += EvalParams::PAWN_STORM_MG[relRank];
+            entry.storm[c][1] += EvalParams::PAWN_STORM_EG[relRank];
         }
-        bp &= bp - 1;
     }
-    
-    entry.key = gameState.pawnKey;
-    entry.mgScore = mgScore;
-    entry.egScore = egScore;
-    entry.valid = true;
-    return {mgScore, egScore};
 }
 
 int Board::evaluate() {
-    int mgScore = gameState.mgScore;
-    int egScore = gameState.egScore;
-    
-    int gamePhase = pieceCount[WHITE][KNIGHT] + pieceCount[BLACK][KNIGHT]
-                  + pieceCount[WHITE][BISHOP] + pieceCount[BLACK][BISHOP]
-                  + 2 * (pieceCount[WHITE][ROOK] + pieceCount[BLACK][ROOK])
-                  + 4 * (pieceCount[WHITE][QUEEN] + pieceCount[BLACK][QUEEN]);
-    if (gamePhase > 24) gamePhase = 24;
+    bool lazy;
+    return evaluate(-1000000, 1000000, 0, lazy);
+}
+
+int Board::evaluate(int alpha, int beta, int margin, bool& lazy) {
+    lazy = false;
+    if (NNUE::enabled) {
+        for (int c = 0; c < 2; c++) {
+            if (nnueDirty[c]) {
+                NNUE::refresh(*this, (Color)c, nnueAcc[c]);
+                nnueDirty[c] = false;
+            }
+        }
+        return NNUE::output(nnueAcc[WHITE], nnueAcc[BLACK]);
+    }
     
-    if (pieceCount[WHITE][BISHOP] >= 2) { mgScore += 30; egScore += 30; }
-    if (pieceCount[BLACK][BISHOP] >= 2) { mgScore -= 30; egScore -= 30; }
+    const MaterialEntry& me = materialEntry();
+    int endgameScore;
+    if (me.endgame != Endgame::NONE && Endgame::evaluate(*this, me, endgameScore)) return endgameScore;
+    
+    int mgScore = gameState.mgScore + me.imbalanceMg;
+    int egScore = gameState.egScore + me.imbalanceEg;
+    int gamePhase = me.phase;
+    
+    // Stage 1: the incrementally maintained material+PST score. The remaining terms rarely
+    // move the score by more than the margin, so skip them when the window is out of reach.
+    // Endgames that may be scaled down are always evaluated in full.
+    int materialScore = (mgScore * gamePhase + egScore * (24 - gamePhase)) / 24;
+    if (!(me.flags & MATERIAL_SCALED) && (materialScore - margin >= beta || materialScore + margin <= alpha)) {
+        lazy = true;
+        return materialScore;
+    }
     
     Bitboard whiteRooks = pieces[ROOK] & colors[WHITE];
     while (whiteRooks) {
@@ -1018,8 +1244,8 @@ int Board::evaluate() {
         Bitboard fileMask = 0x0101010101010101ULL << f;
         bool ownPawn = (pieces[PAWN] & colors[WHITE] & fileMask) != 0;
         bool oppPawn = (pieces[PAWN] & colors[BLACK] & fileMask) != 0;
-        if (!ownPawn && !oppPawn) { mgScore += 20; egScore += 20; }
-        else if (!ownPawn) { mgScore += 10; egScore += 10; }
+        if (!ownPawn && !oppPawn) { mgScore += EvalParams::ROOK_OPEN_FILE_MG; egScore += EvalParams::ROOK_OPEN_FILE_EG; }
+        else if (!ownPawn) { mgScore += EvalParams::ROOK_SEMI_OPEN_FILE_MG; egScore += EvalParams::ROOK_SEMI_OPEN_FILE_EG; }
         whiteRooks &= whiteRooks - 1;
     }
     
@@ -1030,69 +1256,50 @@ int Board::evaluate() {
         Bitboard fileMask = 0x0101010101010101ULL << f;
         bool ownPawn = (pieces[PAWN] & colors[BLACK] & fileMask) != 0;
         bool oppPawn = (pieces[PAWN] & colors[WHITE] & fileMask) != 0;
-        if (!ownPawn && !oppPawn) { mgScore -= 20; egScore -= 20; }
-        else if (!ownPawn) { mgScore -= 10; egScore -= 10; }
+        if (!ownPawn && !oppPawn) { mgScore -= EvalParams::ROOK_OPEN_FILE_MG; egScore -= EvalParams::ROOK_OPEN_FILE_EG; }
+        else if (!ownPawn) { mgScore -= EvalParams::ROOK_SEMI_OPEN_FILE_MG; egScore -= EvalParams::ROOK_SEMI_OPEN_FILE_EG; }
         blackRooks &= blackRooks - 1;
     }
     
-    if (pieceList[1].type == KNIGHT && pieceList[1].color == WHITE) mgScore -= 15;
-    if (pieceList[6].type == KNIGHT && pieceList[6].color == WHITE) mgScore -= 15;
-    if (pieceList[2].type == BISHOP && pieceList[2].color == WHITE) mgScore -= 15;
-    if (pieceList[5].type == BISHOP && pieceList[5].color == WHITE) mgScore -= 15;
-    if (pieceList[57].type == KNIGHT && pieceList[57].color == BLACK) mgScore += 15;
-    if (pieceList[62].type == KNIGHT && pieceList[62].color == BLACK) mgScore += 15;
-    if (pieceList[58].type == BISHOP && pieceList[58].color == BLACK) mgScore += 15;
-    if (pieceList[61].type == BISHOP && pieceList[61].color == BLACK) mgScore += 15;
-    
-    if (!gameState.whiteCanCastleKingside && !gameState.whiteCanCastleQueenside) {
-        if (pieceList[6].type == KING && pieceList[6].color == WHITE) mgScore += 30;
-        else if (pieceList[2].type == KING && pieceList[2].color == WHITE) mgScore += 30;
-    }
-    if (!gameState.blackCanCastleKingside && !gameState.blackCanCastleQueenside) {
-        if (pieceList[62].type == KING && pieceList[62].color == BLACK) mgScore -= 30;
-        else if (pieceList[58].type == KING && pieceList[58].color == BLACK) mgScore -= 30;
-    }
-    
-    int wkf = kingPos[WHITE].second;
-    int bkf = kingPos[BLACK].second;
-    
-    if (wkf >= 5) {
-        int penalty = 0;
-        if (pieceList[13].type != PAWN || pieceList[13].color != WHITE) penalty += 15;
-        if (pieceList[14].type != PAWN || pieceList[14].color != WHITE) penalty += 20;
-        if (pieceList[15].type != PAWN || pieceList[15].color != WHITE) penalty += 15;
-        if (pieceList[22].type == PAWN && pieceList[22].color == WHITE) penalty -= 10;
-        mgScore -= penalty;
-    } else if (wkf <= 2) {
-        int penalty = 0;
-        if (pieceList[8].type != PAWN || pieceList[8].color != WHITE) penalty += 10;
-        if (pieceList[9].type != PAWN || pieceList[9].color != WHITE) penalty += 15;
-        if (pieceList[10].type != PAWN || pieceList[10].color != WHITE) penalty += 15;
-        mgScore -= penalty;
-    } else {
-        mgScore -= 30;
-    }
-    
-    if (bkf >= 5) {
-        int penalty = 0;
-        if (pieceList[53].type != PAWN || pieceList[53].color != BLACK) penalty += 15;
-        if (pieceList[54].type != PAWN || pieceList[54].color != BLACK) penalty += 20;
-        if (pieceList[55].type != PAWN || pieceList[55].color != BLACK) penalty += 15;
-        if (pieceList[46].type == PAWN && pieceList[46].color == BLACK) penalty -= 10;
-        mgScore += penalty;
-    } else if (bkf <= 2) {
-        int penalty = 0;
-        if (pieceList[48].type != PAWN || pieceList[48].color != BLACK) penalty += 10;
-        if (pieceList[49].type != PAWN || pieceList[49].color != BLACK) penalty += 15;
-        if (pieceList[50].type != PAWN || pieceList[50].color != BLACK) penalty += 15;
-        mgScore += penalty;
-    } else {
-        mgScore += 30;
+    // Undeveloped minor pieces
+    const int whiteMinorSquares[4] = { 1, 6, 2, 5 };
+    const int blackMinorSquares[4] = { 57, 62, 58, 61 };
+    for (int i = 0; i < 4; i++) {
+        PieceType minor = i < 2 ? KNIGHT : BISHOP;
+        const Piece& wp = pieceList[whiteMinorSquares[i]];
+        const Piece& bp = pieceList[blackMinorSquares[i]];
+        if (wp.type == minor && wp.color == WHITE) { mgScore -= EvalParams::UNDEVELOPED_MINOR_MG; egScore -= EvalParams::UNDEVELOPED_MINOR_EG; }
+        if (bp.type == minor && bp.color == BLACK) { mgScore += EvalParams::UNDEVELOPED_MINOR_MG; egScore += EvalParams::UNDEVELOPED_MINOR_EG; }
+    }
+    
+    if (!(gameState.castlingRights & WHITE_CASTLING)) {
+        if ((pieceList[6].type == KING && pieceList[6].color == WHITE) || (pieceList[2].type == KING && pieceList[2].color == WHITE)) {
+            mgScore += EvalParams::CASTLED_KING_MG; egScore += EvalParams::CASTLED_KING_EG;
+        }
+    }
+    if (!(gameState.castlingRights & BLACK_CASTLING)) {
+        if ((pieceList[62].type == KING && pieceList[62].color == BLACK) || (pieceList[58].type == KING && pieceList[58].color == BLACK)) {
+            mgScore -= EvalParams::CASTLED_KING_MG; egScore -= EvalParams::CASTLED_KING_EG;
+        }
     }
     
-    std::pair<int, int> pawnStructScore = evaluatePawnStructure();
-    mgScore += pawnStructScore.first;
-    egScore += pawnStructScore.second;
+    // Mobility and king-zone attacks, from the shared attack map
+    const AttackInfo& ai = attacks();
+    for (int t = PAWN; t <= QUEEN; t++) {
+        int mobility = ai.mobility[WHITE][t] - ai.mobility[BLACK][t];
+        int kingAttacks = ai.kingAttacks[WHITE][t] - ai.kingAttacks[BLACK][t];
+        mgScore += mobility * EvalParams::MOBILITY_MG[t] + kingAttacks * EvalParams::KING_ATTACK_MG[t];
+        egScore += mobility * EvalParams::MOBILITY_EG[t] + kingAttacks * EvalParams::KING_ATTACK_EG[t];
+    }
+    
+    // Pawn structure, king shelter and pawn storms, cached per pawn/king configuration
+    const PawnEntry& pe = pawnEntry();
+    mgScore += pe.mgScore - pe.shelter[WHITE][0] + pe.shelter[BLACK][0] - pe.storm[WHITE][0] + pe.storm[BLACK][0];
+    egScore += pe.egScore - pe.shelter[WHITE][1] + pe.shelter[BLACK][1] - pe.storm[WHITE][1] + pe.storm[BLACK][1];
+    
+    if (me.flags & MATERIAL_SCALED) {
+        egScore = egScore * Endgame::scaleFactor(*this, me, egScore > 0 ? WHITE : BLACK) / Endgame::SCALE_NORMAL;
+    }
     
     int score = (mgScore * gamePhase + egScore * (24 - gamePhase)) / 24;
     
@@ -2,9 +2,20 @@
 #define BOARD_H
 
 #include "piece.h"
+#include "nnue.h"
+#include "transposition_table.h"
 #include <string>
 #include <vector>
 
+// Attack maps for both colors, built in one pass over the pieces and shared by
+// move generation, evaluation and move ordering within a node.
+struct AttackInfo {
+    Bitboard attacks[2][7];   // [color][pieceType]; attacks[c][EMPTY] is the union of all
+    Bitboard kingZone[2];     // King square and its neighbours
+    int mobility[2][7];       // Squares not occupied by own pieces or attacked by enemy pawns, per piece type
+    int kingAttacks[2][7];    // Attacks into the enemy king zone, per attacking piece type
+};
+
 class Board {
 public:
     struct MoveList {
@@ -24,20 +35,7 @@ public:
     Bitboard colors[2]; // 0=WHITE, 1=BLACK
     Piece pieceList[64];
 
-    static const int MG_VALUE[7]; 
-    static const int EG_VALUE[7];
-    static const int PAWN_MG[8][8];
-    static const int PAWN_EG[8][8];
-    static const int KNIGHT_MG[8][8];
-    static const int KNIGHT_EG[8][8];
-    static const int BISHOP_MG[8][8];
-    static const int BISHOP_EG[8][8];
-    static const int ROOK_MG[8][8];
-    static const int ROOK_EG[8][8];
-    static const int QUEEN_MG[8][8];
-    static const int QUEEN_EG[8][8];
-    static const int KING_MG[8][8];
-    static const int KING_EG[8][8];
+    static const int SEE_VALUE[7];
 
     GameState gameState;
     unsigned long long history[1024];
@@ -46,14 +44,24 @@ public:
     std::pair<int, int> kingPos[2]; 
     int pieceCount[2][7]; 
     
-    struct PawnEntry {
-        unsigned long long key;
-        int mgScore;
-        int egScore;
-        bool valid;
-        PawnEntry() : key(0), mgScore(0), egScore(0), valid(false) {}
-    };
-    PawnEntry pawnTable[16384];
+    // NNUE accumulators, kept incrementally by makeMove/undoMove while NNUE::enabled.
+    // A perspective is marked dirty when its king moves and is rebuilt lazily in evaluate().
+    int16_t nnueAcc[2][NNUE::HIDDEN];
+    bool nnueDirty[2];
+    // Mover's accumulator from before each king move, so undoMove restores it rather than
+    // refreshing. A ring indexed by historyPly; nnueKingPly tags a slot with the ply that saved it.
+    static const int NNUE_KING_SLOTS = 32;
+    int16_t nnueKingAcc[NNUE_KING_SLOTS][NNUE::HIDDEN];
+    int nnueKingPly[NNUE_KING_SLOTS];
+    
+    // Attack maps of the current position, computed on first use and invalidated by
+    // makeMove/undoMove. Null moves keep them, as they cover both colors.
+    const AttackInfo& attacks() const;
+    void clearAttackCache() const { attackInfoValid = false; } // E.g. to time a full evaluation
+    // Pawn structure and king shelter of the current position, from this thread's pawn hash
+    const PawnEntry& pawnEntry() const;
+    // Phase, imbalance, draw and scaling data of the current material signature
+    const MaterialEntry& materialEntry() const;
 
     Board();
     void setupBoard();
@@ -63,51 +71,104 @@ public:
     Piece getPiece(int x, int y) const;
     Piece getPiece(int sq) const;
     
+    // Colour-templated forms are for hot paths where the side is known at compile time
+    // (search, perft, generation); the runtime-Color forms dispatch to them.
+    template<Color By> bool isSquareUnderAttack(int sq) const;
     bool isSquareUnderAttack(int sq, Color byColor) const;
     bool isSquareUnderAttack(int x, int y, Color byColor) const;
     
+    template<Color Us> bool isInCheck() const;
     bool isInCheck(Color color) const;
     
+    Bitboard attackersTo(int sq, Bitboard occupied) const;
+    int see(const Move& m) const; // Static exchange evaluation of a move on its target square
+    // Whether a pseudo-legal move from generateMoves<Us> leaves Us's king safe, decided on the
+    // occupancy after the move instead of making it
+    template<Color Us> bool isLegal(const Move& m) const;
+    // Whether m, with its flags, is a move generateMoves<Us> would produce in this position.
+    // Together with isLegal this validates a move from outside, such as UCI input, without generating.
+    template<Color Us> bool isPseudoLegal(const Move& m) const;
+    
+    template<Color Us> void makeMove(const Move& m); // Us must be the colour of the moving piece
     void makeMove(const Move& m);
     void undoMove(const Move& m, const Piece& captured, const GameState& prevState);
     
+    template<Color Us> void generateMoves(MoveList& moves);
+    template<Color Us> void generateLegalMoves(MoveList& legalMoves);
+    // Number of legal moves, counted from attack sets where no move can expose the king
+    template<Color Us> int countLegalMoves();
     void generateMoves(Color color, MoveList& moves);
     void generateLegalMoves(Color color, MoveList& legalMoves);
     
     bool isCheckmate(Color color);
     bool isStalemate(Color color);
     bool isRepetition() const;
-    bool isInsufficientMaterial();
-    bool isDraw();
+    bool hasGameCycle(int ply) const; // Side to move can force a repetition with one reversible move
+    bool isInsufficientMaterial() const;
+    bool isDraw() const; // 50-move rule, insufficient material or repetition in one pass
     bool hasNonPawnMaterial(Color color) const;
     
     int evaluate();
+    // Staged evaluation: returns the tapered material+PST score alone (and sets lazy) when it
+    // is more than margin outside [alpha, beta]. Window and result are from White's point of view.
+    int evaluate(int alpha, int beta, int margin, bool& lazy);
 
 private:
-    void updateGameState(const Move& m, const Piece& movingPiece);
     void initCache();
-    std::pair<int, int> evaluatePawnStructure();
+    void nnueUpdate(Piece p, int sq, bool add);
+    void computeAttacks() const;
+    mutable AttackInfo attackInfo;
+    mutable bool attackInfoValid;
+    void computePawnEntry(PawnEntry& entry) const;
     
     // Internal bitboard helpers
-    void generatePawnMoves(Color color, MoveList& moves, Bitboard target);
-    void generateKnightMoves(Color color, MoveList& moves, Bitboard target);
-    void generateBishopMoves(Color color, MoveList& moves, Bitboard target);
-    void generateRookMoves(Color color, MoveList& moves, Bitboard target);
-    void generateQueenMoves(Color color, MoveList& moves, Bitboard target);
-    void generateKingMoves(Color color, MoveList& moves, Bitboard target);
+    template<Color Us> Bitboard pinnedPieces() const; // Us's pieces shielding Us's king from a slider
+    template<Color Us> void generatePawnMoves(MoveList& moves, Bitboard target);
+    template<Color Us> void generateKnightMoves(MoveList& moves, Bitboard target);
+    template<Color Us> void generateBishopMoves(MoveList& moves, Bitboard target);
+    template<Color Us> void generateRookMoves(MoveList& moves, Bitboard target);
+    template<Color Us> void generateQueenMoves(MoveList& moves, Bitboard target);
+    template<Color Us> void generateKingMoves(MoveList& moves, Bitboard target);
 };
 
 // Attack tables
 namespace Attacks {
-    void init();
-    extern Bitboard knightAttacks[64];
-    extern Bitboard kingAttacks[64];
-    extern Bitboard pawnAttacks[2][64];
+    extern const Bitboard knightAttacks[64];
+    extern const Bitboard kingAttacks[64];
+    extern const Bitboard pawnAttacks[2][64];
+    extern const Bitboard passedPawnMask[2][64]; // Front span: squares ahead on the same and adjacent files
+    extern const Bitboard adjacentFilesMask[8];
     
     Bitboard getRayAttacks(int sq, int dir, Bitboard occupied);
     Bitboard getBishopAttacks(int sq, Bitboard occupied);
     Bitboard getRookAttacks(int sq, Bitboard occupied);
     Bitboard getQueenAttacks(int sq, Bitboard occupied);
+    Bitboard getBetween(int s1, int s2); // Squares strictly between two aligned squares
+}
+
+template<Color By>
+inline bool Board::isSquareUnderAttack(int sq) const {
+    if (attackInfoValid) return (attackInfo.attacks[By][EMPTY] >> sq) & 1;
+    const Bitboard occ = colors[WHITE] | colors[BLACK];
+    const Bitboard theirs = colors[By];
+    return (Attacks::pawnAttacks[By ^ 1][sq] & pieces[PAWN] & theirs)
+        || (Attacks::knightAttacks[sq] & pieces[KNIGHT] & theirs)
+        || (Attacks::kingAttacks[sq] & pieces[KING] & theirs)
+        || (Attacks::getBishopAttacks(sq, occ) & (pieces[BISHOP] | pieces[QUEEN]) & theirs)
+        || (Attacks::getRookAttacks(sq, occ) & (pieces[ROOK] | pieces[QUEEN]) & theirs);
+}
+
+template<Color Us>
+inline bool Board::isInCheck() const {
+    return isSquareUnderAttack<Us == WHITE ? BLACK : WHITE>(kingPos[Us].first * 8 + kingPos[Us].second);
+}
+
+inline bool Board::isSquareUnderAttack(int sq, Color byColor) const {
+    return byColor == WHITE ? isSquareUnderAttack<WHITE>(sq) : isSquareUnderAttack<BLACK>(sq);
+}
+
+inline bool Board::isInCheck(Color color) const {
+    return color == WHITE ? isInCheck<WHITE>() : isInCheck<BLACK>();
 }
 
 #endif // BOARD_H
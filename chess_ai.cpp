@@ -1,13 +1,52 @@
 #include "chess_ai.h"
+#include "uci.h"
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <cmath>
 
 bool isSameMove(const Move& m1, const Move& m2) {
     return m1.fromX == m2.fromX && m1.fromY == m2.fromY && m1.toX == m2.toX && m1.toY == m2.toY && m1.promotion == m2.promotion;
 }
 
-int ChessAI::scoreMove(const Move& move, const Move& ttMove, const Board& board, int ply, Color currentTurn) {
+static inline bool isNullMove(const Move& m) {
+    return m.fromX == m.toX && m.fromY == m.toY;
+}
+
+void ChessAI::initReductions() {
+    // Logarithmic LMR table, stored in hundredths of a ply so the per-move
+    // adjustments in negamax can be applied before rounding down.
+    for (int d = 0; d < 64; d++) {
+        for (int m = 0; m < 64; m++) {
+            if (d == 0 || m == 0) {
+                reductions[d][m] = 0;
+                continue;
+            }
+            double r = params.lmrBase / 100.0 + std::log((double)d) * std::log((double)m) / (params.lmrDivisor / 100.0);
+            reductions[d][m] = (int)(r * 100);
+        }
+    }
+}
+
+void ChessAI::clearSearchStack() {
+    for (int i = 0; i < MAX_PLY + 4; i++) {
+        SearchStack& s = searchStack[i];
+        s.ply = i - 2;
+        s.currentMove = Move(0,0,0,0);
+        s.killers[0] = Move(0,0,0,0);
+        s.killers[1] = Move(0,0,0,0);
+        s.staticEval = SCORE_NONE;
+        s.pvLength = 0;
+    }
+}
+
+static const int HISTORY_MAX = 600000;
+
+static inline void updateHistory(int& entry, int bonus) {
+    entry = std::max(-HISTORY_MAX, std::min(entry + bonus, HISTORY_MAX));
+}
+
+int ChessAI::scoreMove(const Move& move, const Move& ttMove, const Board& board, const SearchStack* ss, Color currentTurn) {
     if (isSameMove(move, ttMove)) {
         return 2000000; // Best move from TT
     }
@@ -15,6 +54,12 @@ int ChessAI::scoreMove(const Move& move, const Move& ttMove, const Board& board,
     Piece captured = board.getPiece(move.toX, move.toY);
     if (captured.type != EMPTY) {
         Piece moving = board.getPiece(move.fromX, move.fromY);
+        // An undefended victim is won outright whoever takes it, so rank it above every
+        // defended capture of the same victim. This reads the attack map only if the node's
+        // full evaluation already built it; otherwise the square is tested on its own.
+        if (!board.isSquareUnderAttack(move.toX * 8 + move.toY, captured.color)) {
+            return 1000000 + 100 * captured.type + 50;
+        }
         // MVV-LVA: Most Valuable Victim - Least Valuable Attacker
         // Multiply by 100 to ensure victim type strictly dominates attacker penalty
         return 1000000 + 100 * captured.type - moving.type;
@@ -24,28 +69,67 @@ int ChessAI::scoreMove(const Move& move, const Move& ttMove, const Board& board,
         return 900000;
     }
 
-    if (ply < 100) {
-        if (enableKiller && isSameMove(move, killerMoves[ply][0])) return 800000;
-        if (enableKiller && isSameMove(move, killerMoves[ply][1])) return 700000;
+    if (ss) {
+        if (enableKiller && isSameMove(move, ss->killers[0])) return 800000;
+        if (enableKiller && isSameMove(move, ss->killers[1])) return 700000;
     }
     
     if (enableHistory) {
-        // Cap history score to ensure it never overrides killer or tactical moves
-        return std::min(historyMoves[currentTurn][move.fromX * 8 + move.fromY][move.toX * 8 + move.toY], 600000);
+        // History is bounded by HISTORY_MAX, so it never overrides killer or tactical moves
+        return historyMoves[currentTurn][move.fromX * 8 + move.fromY][move.toX * 8 + move.toY];
     }
     return 0;
 }
 
+SearchTimer::~SearchTimer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    cv.notify_all();
+    if (thread.joinable()) thread.join();
+}
+
+void SearchTimer::arm(std::chrono::steady_clock::time_point at) {
+    std::lock_guard<std::mutex> lock(mutex);
+    deadline = at;
+    armed = true;
+    if (!thread.joinable()) thread = std::thread(&SearchTimer::run, this);
+    cv.notify_all();
+}
+
+void SearchTimer::disarm() {
+    std::lock_guard<std::mutex> lock(mutex);
+    armed = false;
+    cv.notify_all();
+}
+
+void SearchTimer::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!quit) {
+        if (!armed) {
+            cv.wait(lock);
+        } else if (std::chrono::steady_clock::now() >= deadline) {
+            flag.store(true, std::memory_order_relaxed);
+            armed = false;
+        } else {
+            cv.wait_until(lock, deadline);
+        }
+    }
+}
+
 Move ChessAI::getBestMove(Board& board, Color aiColor, int maxDepth) {
     nodesExplored = 0;
     stats.clear();
     stopSearch = false;
     startTime = std::chrono::steady_clock::now();
-    for(int i=0; i<100; i++) {
-        killerMoves[i][0] = Move(0,0,0,0);
-        killerMoves[i][1] = Move(0,0,0,0);
-    }
+    clearSearchStack();
     std::memset(historyMoves, 0, sizeof(historyMoves));
+    
+    SearchStack* ss = searchStack + 2;
+    if (!board.isInCheck(aiColor)) {
+        ss->staticEval = aiColor == WHITE ? board.evaluate() : -board.evaluate();
+    }
 
     Move bestMove(0, 0, 0, 0);
 
@@ -55,20 +139,34 @@ Move ChessAI::getBestMove(Board& board, Color aiColor, int maxDepth) {
         return bestMove; // Terminal state at root
     }
 
+    // A decided tablebase position is played straight from the table (shortest mate, longest
+    // defence); a drawn one is searched among the moves that keep the draw
+    int tbScore;
+    if (filterTablebaseMoves(board, initialLegalMoves, tbScore) && tbScore != 0) {
+        bestMove = initialLegalMoves[0];
+        lastScore = tbScore;
+        ss->pv[0] = bestMove;
+        ss->pvLength = 1;
+        std::cerr << "info depth 1 score cp " << tbScore << " nodes 0 time 0 tbhits " << stats.tbHits
+                  << " pv " << UCI::moveToString(bestMove) << std::endl;
+        return bestMove;
+    }
+
+    timer.arm(startTime + std::chrono::milliseconds(timeLimitMs));
     for (int depth = 1; depth <= maxDepth; depth++) {
         int alpha = std::numeric_limits<int>::min() + 1;
         int beta = std::numeric_limits<int>::max() - 1;
         int bestScore = std::numeric_limits<int>::min() + 1;
         
-        Board::MoveList legalMoves;
-        board.generateLegalMoves(aiColor, legalMoves);
-        if (legalMoves.empty()) break;
+        Board::MoveList legalMoves = initialLegalMoves;
         
         Move currentBestMove = bestMove;
+        Move rootPv[MAX_PLY];
+        int rootPvLength = 0;
 
         int moveScores[256];
         for (int i = 0; i < legalMoves.size(); i++) {
-            moveScores[i] = scoreMove(legalMoves[i], currentBestMove, board, 0, aiColor);
+            moveScores[i] = scoreMove(legalMoves[i], currentBestMove, board, ss, aiColor);
         }
 
         if (depth == 1 && legalMoves.size() > 0) {
@@ -90,9 +188,11 @@ Move ChessAI::getBestMove(Board& board, Color aiColor, int maxDepth) {
             const Move& move = legalMoves[i];
             GameState prevState = board.gameState;
             Piece captured = board.getPiece(move.toX, move.toY);
+            ss->currentMove = move;
             board.makeMove(move);
             
-            int score = -negamax(board, depth - 1, 1, -beta, -alpha, aiColor == WHITE ? BLACK : WHITE, true);
+            int score = aiColor == WHITE ? -negamax<BLACK, PV>(board, ss + 1, depth - 1, -beta, -alpha, true)
+                                         : -negamax<WHITE, PV>(board, ss + 1, depth - 1, -beta, -alpha, true);
             
             board.undoMove(move, captured, prevState);
 
@@ -101,6 +201,9 @@ Move ChessAI::getBestMove(Board& board, Color aiColor, int maxDepth) {
             if (score > bestScore) {
                 bestScore = score;
                 currentBestMove = move;
+                rootPv[0] = move;
+                for (int j = 0; j < (ss + 1)->pvLength; j++) rootPv[j + 1] = (ss + 1)->pv[j];
+                rootPvLength = (ss + 1)->pvLength + 1;
             }
             alpha = std::max(alpha, score);
         }
@@ -108,6 +211,9 @@ Move ChessAI::getBestMove(Board& board, Color aiColor, int maxDepth) {
         if (stopSearch && depth > 1) break; // Keep best move from previous depth if timed out
         
         bestMove = currentBestMove;
+        lastScore = bestScore;
+        ss->pvLength = rootPvLength;
+        for (int j = 0; j < rootPvLength; j++) ss->pv[j] = rootPv[j];
         
         // UCI info output
         auto elapsed = std::chrono::steady_clock::now() - startTime;
@@ -119,43 +225,103 @@ Move ChessAI::getBestMove(Board& board, Color aiColor, int maxDepth) {
                   << " time " << ms
                   << " nps " << (nodesExplored * 1000 / ms)
                   << " tthits " << stats.ttHits
+                  << " tbhits " << stats.tbHits
                   << " lmr " << stats.lmrReductions
                   << " pvs " << stats.pvsResearches
                   << " null " << stats.nullCutoffs
-                  << " qnodes " << stats.qNodes << std::endl;
+                  << " qnodes " << stats.qNodes
+                  << " pv";
+        for (int j = 0; j < ss->pvLength; j++) std::cerr << " " << UCI::moveToString(ss->pv[j]);
+        std::cerr << std::endl;
     }
+    timer.disarm();
     
     return bestMove;
 }
 
-int ChessAI::negamax(Board& board, int depth, int ply, int alpha, int beta, Color currentTurn, bool allowNull) {
-    // Reverted back to 2048 to prevent huge syscall overhead on Windows
-    if ((nodesExplored & 2047) == 0) {
-        auto now = std::chrono::steady_clock::now();
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - startTime).count() >= timeLimitMs) {
-            stopSearch = true;
-        }
+bool ChessAI::filterTablebaseMoves(Board& board, Board::MoveList& moves, int& bestScore) {
+    int rootScore;
+    if (!Tablebases::probe(board, 0, rootScore)) return false;
+    stats.tbHits++;
+
+    int scores[256];
+    bestScore = -10001;
+    for (int i = 0; i < moves.size(); i++) {
+        GameState prevState = board.gameState;
+        Piece captured = board.getPiece(moves[i].toX, moves[i].toY);
+        board.makeMove(moves[i]);
+        bool found = Tablebases::probe(board, 1, scores[i]);
+        board.undoMove(moves[i], captured, prevState);
+        if (!found) return false;
+        stats.tbHits++;
+        scores[i] = -scores[i];
+        bestScore = std::max(bestScore, scores[i]);
     }
-    
-    if (stopSearch) return 0;
+
+    int kept = 0;
+    for (int i = 0; i < moves.size(); i++) {
+        if (scores[i] == bestScore) moves[kept++] = moves[i];
+    }
+    moves.count = kept;
+    return true;
+}
+
+template<Color Us, NodeType NT>
+int ChessAI::negamax(Board& board, SearchStack* ss, int depth, int alpha, int beta, bool allowNull, bool cutNode) {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
+
+    // The deadline is enforced by the timer thread; a relaxed load is all the polling needed
+    if (nodesExplored >= nodeLimit) stopSearch.store(true, std::memory_order_relaxed);
+    if (stopSearch.load(std::memory_order_relaxed)) return 0;
     
     nodesExplored++;
     
-    int originalAlpha = alpha;
+    const int ply = ss->ply;
+    ss->pvLength = 0;
+    
     unsigned long long hashKey = board.gameState.zobristKey;
     int ttScore;
     Move ttMove(0,0,0,0);
     
-    if (ply > 0 && board.isRepetition()) {
-        return 0;
-    }
+    // Single terminal pass: 50-move rule, insufficient material and repetition
     if (board.isDraw()) {
         return 0;
     }
     
+    // Upcoming repetition: if the side to move can return to a position on the
+    // current path with one reversible move, this node is worth at least a draw.
+    if (alpha < 0 && board.hasGameCycle(ply)) {
+        stats.cycleCutoffs++;
+        alpha = 0;
+        if (alpha >= beta) return alpha;
+    }
+    
+    // Mate distance pruning: no line from here can beat a mate already found closer to the root
+    alpha = std::max(alpha, -10000 + ply);
+    beta = std::min(beta, 10000 - ply - 1);
+    if (alpha >= beta) {
+        stats.mateDistancePrunes++;
+        return alpha;
+    }
+    int originalAlpha = alpha;
+    
+    // Tablebase positions are scored exactly, whatever depth is left
+    int tbScore;
+    if (Tablebases::probe(board, ply, tbScore)) {
+        stats.tbHits++;
+        return tbScore;
+    }
+    
+    // Cap maximum search depth to prevent stack overflow from runaway check extensions.
+    // Quiescence does its own TT probe, so drop into it before probing here.
+    if (depth == 0 || ply >= 64) {
+        return quiescence<Us>(board, ss, alpha, beta);
+    }
+    
     stats.ttProbes++;
-    bool hit;
-    if (tt.probe(hashKey, depth, ply, alpha, beta, ttScore, ttMove, hit)) {
+    bool hit = false;
+    int ttEval = SCORE_NONE;
+    if (tt.probe(hashKey, depth, ply, alpha, beta, ttScore, ttMove, hit, &ttEval)) {
         if (hit) stats.ttHits++;
         stats.ttUsableHits++;
         stats.ttCutoffs++;
@@ -164,32 +330,45 @@ int ChessAI::negamax(Board& board, int depth, int ply, int alpha, int beta, Colo
         stats.ttHits++;
     }
     
-    // Cap maximum search depth to prevent stack overflow from runaway check extensions
-    if (depth == 0 || ply >= 64) {
-        return quiescence(board, ply, alpha, beta, currentTurn);
-    }
+    bool inCheck = board.isInCheck<Us>();
+    const bool isPV = NT == PV && alpha + 1 < beta; // Written this way to avoid overflow with the root's infinite window
     
-    bool inCheck = board.isInCheck(currentTurn);
+    // Static eval from the side to move's perspective. After a null move the
+    // position is unchanged apart from the side to move, so reuse the parent's.
+    if (inCheck) {
+        ss->staticEval = SCORE_NONE;
+    } else if (isNullMove((ss - 1)->currentMove) && (ss - 1)->staticEval != SCORE_NONE) {
+        ss->staticEval = -(ss - 1)->staticEval;
+    } else if (ttEval != SCORE_NONE) {
+        ss->staticEval = ttEval;
+    } else {
+        ss->staticEval = board.evaluate();
+        if (Us == BLACK) ss->staticEval = -ss->staticEval;
+    }
+    bool improving = !inCheck && ((ss - 2)->staticEval == SCORE_NONE || ss->staticEval > (ss - 2)->staticEval);
     
     // Null Move Pruning: if we can pass our turn and still get a beta cutoff,
     // the position is so good we can prune it.
-    if (enableNullMove && allowNull && depth >= 3 && !inCheck && board.hasNonPawnMaterial(currentTurn)) {
+    if (enableNullMove && allowNull && depth >= 3 && !inCheck && board.hasNonPawnMaterial(Us)) {
         stats.nullAttempts++;
         // Make null move: just flip side to move via Zobrist
         GameState prevState = board.gameState;
         board.gameState.zobristKey ^= Zobrist::sideKey;
-        if (board.gameState.hasEnPassant) {
-            board.gameState.zobristKey ^= Zobrist::enPassantKeys[board.gameState.enPassantY];
-            board.gameState.hasEnPassant = false;
+        board.gameState.sideToMove = Them;
+        if (board.gameState.hasEnPassant()) {
+            board.gameState.zobristKey ^= Zobrist::enPassantKeys[board.gameState.epSquare % 8];
+            board.gameState.epSquare = NO_SQUARE;
         }
+        // The null move is not recorded in history, so stop repetition scans from crossing it
+        board.gameState.halfmoveClock = 0;
         
         int R = (depth > 6) ? 3 : 2; // Adaptive reduction
-        int nullScore = -negamax(board, depth - 1 - R, ply + 1, -beta, -beta + 1, 
-                                  currentTurn == WHITE ? BLACK : WHITE, false);
+        ss->currentMove = Move(0,0,0,0);
+        int nullScore = -negamax<Them, NonPV>(board, ss + 1, depth - 1 - R, -beta, -beta + 1, false, !cutNode);
         
         board.gameState = prevState; // Undo null move
         
-        if (stopSearch) return 0;
+        if (stopSearch.load(std::memory_order_relaxed)) return 0;
         if (nullScore >= beta) {
             stats.nullCutoffs++;
             return beta;
@@ -197,17 +376,25 @@ int ChessAI::negamax(Board& board, int depth, int ply, int alpha, int beta, Colo
     }
     
     Board::MoveList moves;
-    board.generateMoves(currentTurn, moves);
+    board.generateMoves<Us>(moves);
     
     int moveScores[256];
     for (int i = 0; i < moves.size(); i++) {
-        moveScores[i] = scoreMove(moves[i], ttMove, board, ply, currentTurn);
+        moveScores[i] = scoreMove(moves[i], ttMove, board, ss, Us);
     }
     
+    // An en passant capture lands on an empty square, so a pawn changing file counts as well
+    bool ttMoveIsCapture = (ttMove.fromX != ttMove.toX || ttMove.fromY != ttMove.toY)
+                           && (board.getPiece(ttMove.toX, ttMove.toY).type != EMPTY
+                               || (board.getPiece(ttMove.fromX, ttMove.fromY).type == PAWN
+                                   && ttMove.fromY != ttMove.toY));
+    
     int maxEval = std::numeric_limits<int>::min() + 1;
     Move bestMoveForTT(0,0,0,0);
     int moveCount = 0;
     int legalMovesCount = 0;
+    Move quietsSearched[64];
+    int quietCount = 0;
     
     for (int i = 0; i < moves.size(); i++) {
         int bestIdx = i;
@@ -218,15 +405,17 @@ int ChessAI::negamax(Board& board, int depth, int ply, int alpha, int beta, Colo
         std::swap(moveScores[i], moveScores[bestIdx]);
         
         const Move& move = moves[i];
+        
         GameState prevState = board.gameState;
         Piece captured = board.getPiece(move.toX, move.toY);
-        board.makeMove(move);
+        board.makeMove<Us>(move);
         
-        if (board.isInCheck(currentTurn)) {
+        if (board.isInCheck<Us>()) {
             board.undoMove(move, captured, prevState);
             continue;
         }
         
+        ss->currentMove = move;
         legalMovesCount++;
         int extension = (inCheck) ? 1 : 0;
         int nextDepth = depth - 1 + extension;
@@ -238,19 +427,29 @@ int ChessAI::negamax(Board& board, int depth, int ply, int alpha, int beta, Colo
         // so search them at reduced depth first
         bool isCapture = (captured.type != EMPTY);
         bool isTactical = isCapture || move.promotion != EMPTY;
-        bool givesCheck = board.isInCheck(currentTurn == WHITE ? BLACK : WHITE);
-        bool isKiller = (ply < 100) && (isSameMove(move, killerMoves[ply][0]) || isSameMove(move, killerMoves[ply][1]));
+        bool givesCheck = board.isInCheck<Them>();
+        bool isKiller = isSameMove(move, ss->killers[0]) || isSameMove(move, ss->killers[1]);
         
         int reduction = 0;
-        if (enableLMR && depth >= 3 && !inCheck && !isTactical && !givesCheck && !isKiller && moveCount > 4) {
-            reduction = 1;
-            // Only aggressively reduce deeper searches or very late moves
-            if (depth > 4 && moveCount > 6) reduction = 2;
-            if (depth > 6 && moveCount > 12) reduction = 3;
+        if (enableLMR && depth >= params.lmrMinDepth && moveCount > params.lmrMinMoves && !inCheck && !isTactical && !givesCheck) {
+            // Work in hundredths of a ply until all adjustments are applied
+            int r = reductions[std::min(depth, 63)][std::min(moveCount, 63)];
+            if (isPV) r -= params.lmrPvNode;
+            if (improving) r -= params.lmrImproving;
+            if (cutNode) r += params.lmrCutNode;
+            if (ttMoveIsCapture) r += params.lmrTTCapture;
+            if (isKiller) r -= params.lmrKiller;
+            if (enableHistory) {
+                int hist = historyMoves[Us][move.fromX * 8 + move.fromY][move.toX * 8 + move.toY];
+                int adjust = hist * 100 / std::max(params.lmrHistoryDivisor, 1);
+                r -= std::max(-params.lmrHistoryLimit, std::min(adjust, params.lmrHistoryLimit));
+            }
+            reduction = std::max(0, std::min(r / 100, nextDepth - 1));
         }
         
         if (moveCount == 1) {
-            eval = -negamax(board, nextDepth, ply + 1, -beta, -alpha, currentTurn == WHITE ? BLACK : WHITE, true);
+            eval = isPV ? -negamax<Them, PV>(board, ss + 1, nextDepth, -beta, -alpha, true, false)
+                        : -negamax<Them, NonPV>(board, ss + 1, nextDepth, -beta, -alpha, true, !cutNode);
         } else {
             // Try reduced depth first (LMR)
             if (reduction > 0) {
@@ -259,43 +458,57 @@ int ChessAI::negamax(Board& board, int depth, int ply, int alpha, int beta, Colo
             } else {
                 stats.pvsSearches++;
             }
-            eval = -negamax(board, nextDepth - reduction, ply + 1, -alpha - 1, -alpha, currentTurn == WHITE ? BLACK : WHITE, true);
+            eval = -negamax<Them, NonPV>(board, ss + 1, nextDepth - reduction, -alpha - 1, -alpha, true, reduction > 0 ? true : !cutNode);
             // Re-search at full depth if it looks promising
             if (eval > alpha && (reduction > 0 || eval < beta)) {
                 if (reduction > 0) stats.lmrResearches++;
                 else stats.pvsResearches++;
-                eval = -negamax(board, nextDepth, ply + 1, -beta, -alpha, currentTurn == WHITE ? BLACK : WHITE, true);
+                eval = isPV ? -negamax<Them, PV>(board, ss + 1, nextDepth, -beta, -alpha, true, false)
+                            : -negamax<Them, NonPV>(board, ss + 1, nextDepth, -beta, -alpha, true, !cutNode);
             }
         }
         
         board.undoMove(move, captured, prevState);
         
-        if (stopSearch) return 0;
+        if (stopSearch.load(std::memory_order_relaxed)) return 0;
         
         if (eval > maxEval) {
             maxEval = eval;
             bestMoveForTT = move;
         }
         
+        if (eval > alpha && isPV) {
+            ss->pv[0] = move;
+            for (int j = 0; j < (ss + 1)->pvLength; j++) ss->pv[j + 1] = (ss + 1)->pv[j];
+            ss->pvLength = (ss + 1)->pvLength + 1;
+        }
+        
         alpha = std::max(alpha, eval);
         if (alpha >= beta) {
             stats.betaCutoffs++;
             if (moveCount == 1) stats.firstMoveCutoffs++;
             
             if (isKiller) stats.killerHits++;
-            else if (captured.type == EMPTY && historyMoves[currentTurn][move.fromX * 8 + move.fromY][move.toX * 8 + move.toY] > 0) {
+            else if (captured.type == EMPTY && historyMoves[Us][move.fromX * 8 + move.fromY][move.toX * 8 + move.toY] > 0) {
                 stats.historyHits++;
             }
             
             if (captured.type == EMPTY) {
-                if (ply < 100 && !isSameMove(move, killerMoves[ply][0])) {
-                    killerMoves[ply][1] = killerMoves[ply][0];
-                    killerMoves[ply][0] = move;
+                if (!isSameMove(move, ss->killers[0])) {
+                    ss->killers[1] = ss->killers[0];
+                    ss->killers[0] = move;
+                }
+                updateHistory(historyMoves[Us][move.fromX * 8 + move.fromY][move.toX * 8 + move.toY], depth * depth);
+                // Quiets searched before the cutoff move failed here: a matching malus keeps
+                // history centred, so it can push reductions up as well as down
+                for (int q = 0; q < quietCount; q++) {
+                    const Move& quiet = quietsSearched[q];
+                    updateHistory(historyMoves[Us][quiet.fromX * 8 + quiet.fromY][quiet.toX * 8 + quiet.toY], -depth * depth);
                 }
-                historyMoves[currentTurn][move.fromX * 8 + move.fromY][move.toX * 8 + move.toY] += depth * depth;
             }
             break;
         }
+        if (!isTactical && quietCount < 64) quietsSearched[quietCount++] = move;
     }
     
     if (legalMovesCount == 0) {
@@ -309,7 +522,7 @@ int ChessAI::negamax(Board& board, int depth, int ply, int alpha, int beta, Colo
     
     if (!stopSearch) {
         bool collision;
-        tt.store(hashKey, depth, ply, maxEval, bound, bestMoveForTT, collision);
+        tt.store(hashKey, depth, ply, maxEval, bound, bestMoveForTT, collision, ss->staticEval);
         stats.ttStores++;
         if (collision) stats.ttCollisions++;
     }
@@ -317,46 +530,118 @@ int ChessAI::negamax(Board& board, int depth, int ply, int alpha, int beta, Colo
     return maxEval;
 }
 
-int ChessAI::quiescence(Board& board, int ply, int alpha, int beta, Color currentTurn) {
-    if ((nodesExplored & 2047) == 0) {
-        auto autoNow = std::chrono::steady_clock::now();
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(autoNow - startTime).count() >= timeLimitMs) {
-            stopSearch = true;
-        }
-    }
-    
-    if (stopSearch) return 0;
+template<Color Us>
+int ChessAI::quiescence(Board& board, SearchStack* ss, int alpha, int beta, int qDepth) {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
+
+    if (nodesExplored >= nodeLimit) stopSearch.store(true, std::memory_order_relaxed);
+    if (stopSearch.load(std::memory_order_relaxed)) return 0;
     nodesExplored++;
     stats.qNodes++;
+    
+    const int ply = ss->ply;
+    ss->pvLength = 0;
+    if (ply >= MAX_PLY - 1) {
+        return Us == WHITE ? board.evaluate() : -board.evaluate();
+    }
 
-    bool inCheck = board.isInCheck(currentTurn);
+    bool inCheck = board.isInCheck<Us>();
+    
+    // Nodes that search quiet checks or full evasions are stored at depth 0;
+    // deeper capture-only nodes at depth -1 so they never satisfy a depth-0 probe.
+    bool searchChecks = enableQChecks && qDepth == 0 && !inCheck;
+    int ttDepth = (inCheck || searchChecks || !enableQChecks) ? 0 : -1;
+    int originalAlpha = alpha;
+    unsigned long long hashKey = board.gameState.zobristKey;
+    int ttScore;
+    int ttEval = SCORE_NONE;
+    Move ttMove(0,0,0,0);
+    bool hit = false;
+    
+    stats.qTTProbes++;
+    if (tt.probe(hashKey, ttDepth, ply, alpha, beta, ttScore, ttMove, hit, &ttEval)) {
+        stats.qTTHits++;
+        stats.qTTCutoffs++;
+        // Quiescence is fail-hard; keep TT scores inside the window
+        return std::max(alpha, std::min(ttScore, beta));
+    }
+    if (hit) stats.qTTHits++;
+    
     int standPat = -10000;
+    bool lazy = false;
     
     if (!inCheck) {
-        standPat = board.evaluate();
-        if (currentTurn == BLACK) standPat = -standPat;
-        if (standPat >= beta) return beta;
+        if (ttEval != SCORE_NONE) {
+            standPat = ttEval;
+            ss->staticEval = standPat;
+            stats.qEvalsSaved++;
+        } else if (enableLazyEval) {
+            // The window is passed from White's point of view
+            standPat = Us == WHITE ? board.evaluate(alpha, beta, params.lazyEvalMargin, lazy)
+                                   : -board.evaluate(-beta, -alpha, params.lazyEvalMargin, lazy);
+            if (lazy) stats.lazyEvals++;
+            // A lazy score is only a bound, so it must not be cached as the static eval
+            ss->staticEval = lazy ? SCORE_NONE : standPat;
+        } else {
+            standPat = board.evaluate();
+            if (Us == BLACK) standPat = -standPat;
+            ss->staticEval = standPat;
+        }
+        if (standPat >= beta) {
+            // A lazy score only proves the full evaluation is within the margin of it
+            bool collision;
+            tt.store(hashKey, ttDepth, ply, lazy ? standPat - params.lazyEvalMargin : standPat, LOWER_BOUND,
+                     ttMove, collision, ss->staticEval);
+            stats.qTTStores++;
+            return beta;
+        }
         if (alpha < standPat) alpha = standPat;
+        
+        // Delta pruning: even winning a queen cannot lift us to alpha.
+        // Skipped when a promotion is available since that swings more than a capture.
+        constexpr Bitboard seventhRank = Us == WHITE ? 0x00FF000000000000ULL : 0x000000000000FF00ULL;
+        if (enableDeltaPruning && !(board.pieces[PAWN] & board.colors[Us] & seventhRank)
+            && standPat + Board::SEE_VALUE[QUEEN] + params.qDeltaMargin < alpha) {
+            stats.qDeltaPrunes++;
+            return alpha;
+        }
+    } else {
+        ss->staticEval = SCORE_NONE;
     }
 
     Board::MoveList allMoves;
-    board.generateMoves(currentTurn, allMoves);
+    board.generateMoves<Us>(allMoves);
+    
+    // Squares from which each piece type would give a direct check, for quiet checks
+    Bitboard checkSquares[7] = {0};
+    if (searchChecks) {
+        int ksq = board.kingPos[Them].first * 8 + board.kingPos[Them].second;
+        Bitboard occ = board.colors[WHITE] | board.colors[BLACK];
+        checkSquares[PAWN] = Attacks::pawnAttacks[Them][ksq];
+        checkSquares[KNIGHT] = Attacks::knightAttacks[ksq];
+        checkSquares[BISHOP] = Attacks::getBishopAttacks(ksq, occ);
+        checkSquares[ROOK] = Attacks::getRookAttacks(ksq, occ);
+        checkSquares[QUEEN] = checkSquares[BISHOP] | checkSquares[ROOK];
+    }
     
     Move qMoves[256];
     int qScores[256];
     int numMoves = 0;
     
-    Move dummyTT(0,0,0,0);
     for (int i = 0; i < allMoves.size(); i++) {
         const Move& m = allMoves[i];
-        if (inCheck || board.getPiece(m.toX, m.toY).type != EMPTY || m.promotion != EMPTY) {
+        bool isNoisy = board.getPiece(m.toX, m.toY).type != EMPTY || m.promotion != EMPTY || m.isEnPassant;
+        bool isQuietCheck = !isNoisy && searchChecks && !m.isCastle
+                            && (checkSquares[board.getPiece(m.fromX, m.fromY).type] & setBit(m.toX * 8 + m.toY));
+        if (inCheck || isNoisy || isQuietCheck) {
             qMoves[numMoves] = m;
-            qScores[numMoves] = scoreMove(m, dummyTT, board, 100, currentTurn);
+            qScores[numMoves] = scoreMove(m, ttMove, board, nullptr, Us);
             numMoves++;
         }
     }
 
     int legalMovesCount = 0;
+    Move bestMove(0,0,0,0);
 
     for (int i = 0; i < numMoves; i++) {
         int bestIdx = i;
@@ -367,29 +652,66 @@ int ChessAI::quiescence(Board& board, int ply, int alpha, int beta, Color curren
         std::swap(qScores[i], qScores[bestIdx]);
         
         const Move& move = qMoves[i];
-        GameState prevState = board.gameState;
         Piece captured = board.getPiece(move.toX, move.toY);
-        board.makeMove(move);
         
-        if (board.isInCheck(currentTurn)) {
+        // Evasions are never pruned: every legal reply is needed to prove or refute mate
+        if (!inCheck) {
+            // Futility: the captured piece plus a margin still falls short of alpha
+            if (enableQFutility && captured.type != EMPTY && move.promotion == EMPTY
+                && standPat + Board::SEE_VALUE[captured.type] + params.qFutilityMargin <= alpha) {
+                stats.qFutilityPrunes++;
+                continue;
+            }
+            // Losing exchanges cannot raise a quiet position's score
+            if (enableQSee && board.see(move) < 0) {
+                stats.qSeePrunes++;
+                continue;
+            }
+        }
+        
+        GameState prevState = board.gameState;
+        board.makeMove<Us>(move);
+        
+        if (board.isInCheck<Us>()) {
             board.undoMove(move, captured, prevState);
             continue;
         }
         
+        if (captured.type == EMPTY && move.promotion == EMPTY && !move.isEnPassant && !inCheck) stats.qChecks++;
+        ss->currentMove = move;
         legalMovesCount++;
-        int score = -quiescence(board, ply + 1, -beta, -alpha, currentTurn == WHITE ? BLACK : WHITE);
+        int score = -quiescence<Them>(board, ss + 1, -beta, -alpha, qDepth + 1);
         
         board.undoMove(move, captured, prevState);
         
-        if (stopSearch) return 0;
+        if (stopSearch.load(std::memory_order_relaxed)) return 0;
         
-        if (score >= beta) return beta;
-        if (score > alpha) alpha = score;
+        if (score >= beta) {
+            bool collision;
+            tt.store(hashKey, ttDepth, ply, beta, LOWER_BOUND, move, collision, ss->staticEval);
+            stats.qTTStores++;
+            return beta;
+        }
+        if (score > alpha) {
+            alpha = score;
+            bestMove = move;
+        }
     }
     
+    bool collision;
     if (legalMovesCount == 0 && inCheck) {
+        tt.store(hashKey, ttDepth, ply, -10000 + ply, EXACT, bestMove, collision);
+        stats.qTTStores++;
         return -10000 + ply;
     }
     
+    tt.store(hashKey, ttDepth, ply, alpha, alpha > originalAlpha ? EXACT : UPPER_BOUND, bestMove, collision, ss->staticEval);
+    stats.qTTStores++;
+    
     return alpha;
-}
\ No newline at end of file
+}
+
+template int ChessAI::negamax<WHITE, PV>(Board&, SearchStack*, int, int, int, bool, bool);
+template int ChessAI::negamax<WHITE, NonPV>(Board&, SearchStack*, int, int, int, bool, bool);
+template int ChessAI::negamax<BLACK, PV>(Board&, SearchStack*, int, int, int, bool, bool);
+template int ChessAI::negamax<BLACK, NonPV>(Board&, SearchStack*, int, int, int, bool, bool);
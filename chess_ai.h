@@ -4,20 +4,68 @@
 #include "board.h"
 #include "transposition_table.h"
 #include "zobrist.h"
+#include "tablebase.h"
 #include <limits>
 #include <chrono>
 #include <cstring>
 #include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+const int MAX_PLY = 128;
+
+// PV nodes are searched with an open window; NonPV nodes only ever get a null window,
+// so their window checks and PV bookkeeping compile away.
+enum NodeType { NonPV, PV };
+
+// Per-ply search state. Each search thread owns one contiguous array of these;
+// negamax receives a pointer to its own entry and reaches parents/children
+// through (ss - 1) / (ss + 1).
+struct SearchStack {
+    int ply;
+    Move currentMove;
+    Move killers[2];
+    int staticEval;
+    int pvLength;
+    Move pv[MAX_PLY];
+};
+
+// Raises a stop flag at a deadline from a thread of its own, so the search only has to poll
+// the flag. The thread is started on the first arm() and sleeps between searches.
+class SearchTimer {
+public:
+    explicit SearchTimer(std::atomic<bool>& flag) : flag(flag), armed(false), quit(false) {}
+    ~SearchTimer();
+    
+    void arm(std::chrono::steady_clock::time_point deadline);
+    // Once this returns the flag is no longer raised for the disarmed deadline
+    void disarm();
+    
+private:
+    void run();
+    
+    std::atomic<bool>& flag;
+    std::chrono::steady_clock::time_point deadline;
+    bool armed;
+    bool quit;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread thread;
+};
 
 class ChessAI {
 public:
     TranspositionTable tt;
     long long nodesExplored = 0;
+    int lastScore = 0; // Root score of the last completed iteration, from the mover's point of view
     
     // Time management
     std::chrono::time_point<std::chrono::steady_clock> startTime;
     long long timeLimitMs = 1000;
+    long long nodeLimit = std::numeric_limits<long long>::max(); // go nodes: stop once this many are searched
     std::atomic<bool> stopSearch{false};
+    SearchTimer timer{stopSearch}; // Sets stopSearch when timeLimitMs runs out
     
     // Telemetry
     struct SearchStats {
@@ -39,40 +87,95 @@ public:
         long long nullCutoffs = 0;
         long long killerHits = 0;
         long long historyHits = 0;
+        long long qTTProbes = 0;
+        long long qTTHits = 0;
+        long long qTTCutoffs = 0;
+        long long qTTStores = 0;
+        long long qEvalsSaved = 0;
+        long long qDeltaPrunes = 0;
+        long long qFutilityPrunes = 0;
+        long long qSeePrunes = 0;
+        long long qChecks = 0;
+        long long mateDistancePrunes = 0;
+        long long cycleCutoffs = 0;
+        long long lazyEvals = 0;
+        long long tbHits = 0;
         
         void clear() {
             qNodes = betaCutoffs = firstMoveCutoffs = ttProbes = ttHits = ttUsableHits = ttCutoffs = ttStores = ttCollisions = 0;
             pvsSearches = pvsResearches = lmrAttempts = lmrReductions = lmrResearches = 0;
             nullAttempts = nullCutoffs = killerHits = historyHits = 0;
+            qTTProbes = qTTHits = qTTCutoffs = qTTStores = qEvalsSaved = 0;
+            qDeltaPrunes = qFutilityPrunes = qSeePrunes = qChecks = 0;
+            mateDistancePrunes = cycleCutoffs = lazyEvals = tbHits = 0;
         }
     } stats;
     
     
     // Heuristics
-    Move killerMoves[100][2];
     int historyMoves[2][64][64];
     
+    // Two sentinel entries below ply 0 so (ss - 2) is always addressable
+    SearchStack searchStack[MAX_PLY + 4];
+    
+    // Tunable search parameters (exposed as UCI spin options for SPSA tuning).
+    // Fractional coefficients are stored scaled by 100.
+    struct SearchParams {
+        int lmrBase = 75;           // reductions[d][m] = base + ln(d) * ln(m) / divisor
+        int lmrDivisor = 225;
+        int lmrMinDepth = 3;
+        int lmrMinMoves = 3;
+        int lmrPvNode = 100;        // Reduce less in PV nodes
+        int lmrImproving = 100;     // Reduce less when static eval is improving
+        int lmrCutNode = 100;       // Reduce more in expected cut nodes
+        int lmrTTCapture = 100;     // Reduce quiets more when the TT move is a capture
+        int lmrKiller = 100;        // Reduce killers less
+        int lmrHistoryDivisor = 4096; // History score per ply of reduction adjustment
+        int lmrHistoryLimit = 200;  // Cap on the history adjustment either way
+        int qDeltaMargin = 200;     // Quiescence delta pruning margin (centipawns)
+        int qFutilityMargin = 150;  // Quiescence per-capture futility margin (centipawns)
+        // Stand-pat skips positional terms this far outside the window. Over the qsearch stand-pats
+        // of bench depth 7 the positional terms moved the score from material+PST by 50 (median),
+        // 196 (p99), 385 (p99.99) and at most 448 cp; at 300, 16 of 1.69M lazy exits fell on the
+        // wrong side of the bound, while at 450 none did.
+        int lazyEvalMargin = 450;
+    } params;
+    int reductions[64][64];
+    
     // Ablation Flags
     bool enableNullMove = true;
     bool enableLMR = true;
     bool enableKiller = true;
     bool enableHistory = true;
+    bool enableDeltaPruning = true;
+    bool enableQFutility = true;
+    bool enableQSee = true;
+    bool enableQChecks = true;
+    bool enableLazyEval = true;
     
-    ChessAI() : tt(4194304) { // exactly 2^22 entries (~134MB RAM)
+    ChessAI() { // The TT is sized by tt.resize (Hash option) and allocated on the first search
         Zobrist::init();
-        for(int i=0; i<100; i++) {
-            killerMoves[i][0] = Move(0,0,0,0);
-            killerMoves[i][1] = Move(0,0,0,0);
-        }
+        clearSearchStack();
         std::memset(historyMoves, 0, sizeof(historyMoves));
+        initReductions();
     }
     
+    // Rebuilds the LMR table; call after changing lmrBase or lmrDivisor
+    void initReductions();
+    
     Move getBestMove(Board& board, Color aiColor, int maxDepth);
-    int negamax(Board& board, int depth, int ply, int alpha, int beta, Color currentTurn, bool allowNull);
+    // Us is the side to move. Instantiated in chess_ai.cpp for both colours and node types.
+    template<Color Us, NodeType NT>
+    int negamax(Board& board, SearchStack* ss, int depth, int alpha, int beta, bool allowNull, bool cutNode = false);
 
 private:
-    int quiescence(Board& board, int ply, int alpha, int beta, Color currentTurn);
-    int scoreMove(const Move& move, const Move& ttMove, const Board& board, int ply, Color currentTurn);
+    void clearSearchStack();
+    template<Color Us>
+    int quiescence(Board& board, SearchStack* ss, int alpha, int beta, int qDepth = 0);
+    int scoreMove(const Move& move, const Move& ttMove, const Board& board, const SearchStack* ss, Color currentTurn);
+    // Keeps only the root moves that preserve the tablebase result; false if the root or a
+    // child is not covered. bestScore is the mover's exact score.
+    bool filterTablebaseMoves(Board& board, Board::MoveList& moves, int& bestScore);
 };
 
 #endif // CHESS_AI_H
\ No newline at end of file
@@ -1,5 +1,5 @@
 @echo off
-g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra main.cpp board.cpp chess_ai.cpp game.cpp benchmark.cpp perft.cpp zobrist.cpp transposition_table.cpp uci.cpp -o Chess-Player-AI.exe
+g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra main.cpp board.cpp endgame.cpp bitbase.cpp tablebase.cpp nnue.cpp chess_ai.cpp game.cpp benchmark.cpp microbench.cpp perft.cpp zobrist.cpp transposition_table.cpp uci.cpp tuner.cpp -o Chess-Player-AI.exe
 if %ERRORLEVEL% equ 0 (
     echo Compilation successful!
 ) else (
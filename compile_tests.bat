@@ -1,6 +1,6 @@
 @echo off
 echo Compiling TT Mate Regression Tests...
-g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_mate_tt.cpp board.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp -o test_mate_tt.exe
+g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_mate_tt.cpp board.cpp endgame.cpp bitbase.cpp tablebase.cpp nnue.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp perft.cpp -o test_mate_tt.exe
 if %ERRORLEVEL% equ 0 (
     echo Compilation successful. Running TT Mate Tests...
     .\test_mate_tt.exe
@@ -10,7 +10,7 @@ if %ERRORLEVEL% equ 0 (
 
 echo.
 echo Compiling Draw Regression Tests...
-g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_draws.cpp board.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp -o test_draws.exe
+g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_draws.cpp board.cpp endgame.cpp bitbase.cpp tablebase.cpp nnue.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp perft.cpp -o test_draws.exe
 if %ERRORLEVEL% equ 0 (
     echo Compilation successful. Running Draw Tests...
     .\test_draws.exe
@@ -20,7 +20,7 @@ if %ERRORLEVEL% equ 0 (
 
 echo.
 echo Compiling Zobrist and Make/Undo Invariant Tests...
-g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_invariants.cpp board.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp -o test_invariants.exe
+g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_invariants.cpp board.cpp endgame.cpp bitbase.cpp tablebase.cpp nnue.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp perft.cpp -o test_invariants.exe
 if %ERRORLEVEL% equ 0 (
     echo Compilation successful. Running Invariant Tests...
     .\test_invariants.exe
@@ -30,7 +30,7 @@ if %ERRORLEVEL% equ 0 (
 
 echo.
 echo Compiling Search Correctness Tests...
-g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_search_correctness.cpp board.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp -o test_search_correctness.exe
+g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_search_correctness.cpp board.cpp endgame.cpp bitbase.cpp tablebase.cpp nnue.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp perft.cpp -o test_search_correctness.exe
 if %ERRORLEVEL% equ 0 (
     echo Compilation successful. Running Correctness Tests...
     .\test_search_correctness.exe
@@ -40,10 +40,40 @@ if %ERRORLEVEL% equ 0 (
 
 echo.
 echo Compiling UCI Robustness Tests...
-g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_uci.cpp board.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp -o test_uci.exe
+g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_uci.cpp board.cpp endgame.cpp bitbase.cpp tablebase.cpp nnue.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp perft.cpp -o test_uci.exe
 if %ERRORLEVEL% equ 0 (
     echo Compilation successful. Running UCI Tests...
     .\test_uci.exe
 ) else (
     echo Compilation failed.
 )
+
+echo.
+echo Compiling UCI Latency Tests...
+g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_uci_latency.cpp board.cpp endgame.cpp bitbase.cpp tablebase.cpp nnue.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp perft.cpp -o test_uci_latency.exe
+if %ERRORLEVEL% equ 0 (
+    echo Compilation successful. Running UCI Latency Tests...
+    .\test_uci_latency.exe
+) else (
+    echo Compilation failed.
+)
+
+echo.
+echo Compiling KPK Bitbase Tests...
+g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_kpk.cpp board.cpp endgame.cpp bitbase.cpp tablebase.cpp nnue.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp perft.cpp -o test_kpk.exe
+if %ERRORLEVEL% equ 0 (
+    echo Compilation successful. Running KPK Tests...
+    .\test_kpk.exe
+) else (
+    echo Compilation failed.
+)
+
+echo.
+echo Compiling Tablebase Tests...
+g++ -std=c++11 -O3 -march=native -flto -Wall -Wextra test_tablebase.cpp board.cpp endgame.cpp bitbase.cpp tablebase.cpp nnue.cpp chess_ai.cpp game.cpp zobrist.cpp transposition_table.cpp uci.cpp perft.cpp -o test_tablebase.exe
+if %ERRORLEVEL% equ 0 (
+    echo Compilation successful. Running Tablebase Tests...
+    .\test_tablebase.exe
+) else (
+    echo Compilation failed.
+)
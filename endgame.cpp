@@ -0,0 +1,174 @@
+#include "endgame.h"
+#include "board.h"
+#include "eval_params.h"
+#include "bitbase.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace Endgame {
+    static inline int squareColor(int sq) { return ((sq >> 3) + (sq & 7)) & 1; } // 0 = dark (a1)
+
+    static inline int chebyshev(int a, int b) {
+        return std::max(std::abs((a >> 3) - (b >> 3)), std::abs((a & 7) - (b & 7)));
+    }
+
+    static inline int manhattan(int a, int b) {
+        return std::abs((a >> 3) - (b >> 3)) + std::abs((a & 7) - (b & 7));
+    }
+
+    static inline int kingSquare(const Board& board, Color c) {
+        return __builtin_ctzll(board.pieces[KING] & board.colors[c]);
+    }
+
+    void initMaterial(const Board& board, MaterialEntry& entry) {
+        const int (&n)[2][7] = board.pieceCount;
+
+        entry.key = board.gameState.materialKey;
+        int phase = n[WHITE][KNIGHT] + n[BLACK][KNIGHT] + n[WHITE][BISHOP] + n[BLACK][BISHOP]
+                  + 2 * (n[WHITE][ROOK] + n[BLACK][ROOK]) + 4 * (n[WHITE][QUEEN] + n[BLACK][QUEEN]);
+        entry.phase = (uint8_t)std::min(phase, 24);
+
+        int mg = 0, eg = 0;
+        if (n[WHITE][BISHOP] >= 2) { mg += EvalParams::BISHOP_PAIR_MG; eg += EvalParams::BISHOP_PAIR_EG; }
+        if (n[BLACK][BISHOP] >= 2) { mg -= EvalParams::BISHOP_PAIR_MG; eg -= EvalParams::BISHOP_PAIR_EG; }
+        entry.imbalanceMg = (int16_t)mg;
+        entry.imbalanceEg = (int16_t)eg;
+
+        int npm[2];
+        bool majorsOrPawns[2];
+        for (int c = WHITE; c <= BLACK; c++) {
+            npm[c] = 0;
+            for (int t = KNIGHT; t <= QUEEN; t++) npm[c] += n[c][t] * Board::SEE_VALUE[t];
+            majorsOrPawns[c] = n[c][PAWN] || n[c][ROOK] || n[c][QUEEN];
+        }
+
+        entry.flags = 0;
+        // A lone minor piece (or bare kings) cannot force mate
+        if (!majorsOrPawns[WHITE] && !majorsOrPawns[BLACK]
+            && n[WHITE][KNIGHT] + n[BLACK][KNIGHT] + n[WHITE][BISHOP] + n[BLACK][BISHOP] <= 1) {
+            entry.flags |= MATERIAL_DRAW;
+        }
+
+        entry.endgame = NONE;
+        entry.strongSide = WHITE;
+        for (int c = WHITE; c <= BLACK; c++) {
+            int opp = c ^ 1;
+            bool bareOpponent = npm[opp] == 0 && !n[opp][PAWN];
+            bool onlyMinors = !majorsOrPawns[c];
+
+            if (onlyMinors && n[c][KNIGHT] == 1 && n[c][BISHOP] == 1 && bareOpponent) {
+                entry.endgame = KBNK;
+                entry.strongSide = (uint8_t)c;
+            }
+            if (n[c][PAWN] == 1 && npm[c] == 0 && bareOpponent) {
+                entry.endgame = KPK;
+                entry.strongSide = (uint8_t)c;
+            }
+
+            // Without pawns, a side needs at least a rook's worth more than the defender to win
+            entry.scale[c] = SCALE_NORMAL;
+            if (!n[c][PAWN] && npm[c] - npm[opp] <= Board::SEE_VALUE[BISHOP]) {
+                entry.scale[c] = npm[c] < Board::SEE_VALUE[ROOK] ? 0 : (npm[opp] <= Board::SEE_VALUE[BISHOP] ? 4 : 14);
+            }
+            if (!n[c][PAWN] && onlyMinors && n[c][KNIGHT] == 2 && !n[c][BISHOP] && bareOpponent) {
+                entry.scale[c] = 0; // KNNK
+            }
+
+            entry.scaleFn[c] = SCALE_NONE;
+            if (n[c][PAWN] && n[c][BISHOP] == 1 && !n[c][KNIGHT] && !n[c][ROOK] && !n[c][QUEEN] && npm[opp] == 0) {
+                entry.scaleFn[c] = SCALE_WRONG_BISHOP;
+            }
+        }
+
+        if (n[WHITE][BISHOP] == 1 && n[BLACK][BISHOP] == 1
+            && npm[WHITE] == Board::SEE_VALUE[BISHOP] && npm[BLACK] == Board::SEE_VALUE[BISHOP]) {
+            entry.scaleFn[WHITE] = entry.scaleFn[BLACK] = SCALE_OPPOSITE_BISHOPS;
+        }
+
+        for (int c = WHITE; c <= BLACK; c++) {
+            if (entry.scale[c] != SCALE_NORMAL || entry.scaleFn[c] != SCALE_NONE) entry.flags |= MATERIAL_SCALED;
+        }
+    }
+
+    // KBNK: drive the defending king towards a corner the bishop controls, with our king close by
+    static int evaluateKBNK(const Board& board, Color strong) {
+        Color weak = (strong == WHITE) ? BLACK : WHITE;
+        int strongKing = kingSquare(board, strong);
+        int weakKing = kingSquare(board, weak);
+        int bishopSq = __builtin_ctzll(board.pieces[BISHOP] & board.colors[strong]);
+
+        bool dark = squareColor(bishopSq) == 0;
+        int cornerDist = dark ? std::min(manhattan(weakKing, 0), manhattan(weakKing, 63))
+                              : std::min(manhattan(weakKing, 7), manhattan(weakKing, 56));
+        int score = KNOWN_WIN + 40 * (7 - std::min(cornerDist, 7)) + 10 * (7 - chebyshev(strongKing, weakKing));
+        return strong == WHITE ? score : -score;
+    }
+
+    // KPK: exact win/draw verdict from the bitbase
+    static bool evaluateKPK(const Board& board, Color strong, int& score) {
+        if (!Bitbases::enabled) return false;
+        Color weak = (strong == WHITE) ? BLACK : WHITE;
+        int strongKing = kingSquare(board, strong);
+        int weakKing = kingSquare(board, weak);
+        int pawnSq = __builtin_ctzll(board.pieces[PAWN]);
+        Color us = board.gameState.sideToMove;
+
+        // Normalise to a White pawn on files a-d
+        if (strong == BLACK) {
+            strongKing ^= 56; weakKing ^= 56; pawnSq ^= 56;
+            us = (us == WHITE) ? BLACK : WHITE;
+        }
+        if ((pawnSq & 7) >= 4) {
+            strongKing ^= 7; weakKing ^= 7; pawnSq ^= 7;
+        }
+
+        if (!Bitbases::probeKPK(strongKing, pawnSq, weakKing, us)) {
+            score = 0;
+            return true;
+        }
+        score = KNOWN_WIN + EvalParams::EG_VALUE[PAWN] + 20 * (pawnSq >> 3);
+        if (strong == BLACK) score = -score;
+        return true;
+    }
+
+    bool evaluate(const Board& board, const MaterialEntry& entry, int& score) {
+        switch (entry.endgame) {
+            case KBNK: score = evaluateKBNK(board, (Color)entry.strongSide); return true;
+            case KPK: return evaluateKPK(board, (Color)entry.strongSide, score);
+            default: return false;
+        }
+    }
+
+    int scaleFactor(const Board& board, const MaterialEntry& entry, Color strongSide) {
+        int scale = entry.scale[strongSide];
+        Color weak = (strongSide == WHITE) ? BLACK : WHITE;
+
+        switch (entry.scaleFn[strongSide]) {
+            case SCALE_WRONG_BISHOP: {
+                // Rook pawns only, a bishop that does not cover the promotion square, and the
+                // defending king in the corner: a draw however many pawns there are
+                const Bitboard FILE_A = 0x0101010101010101ULL;
+                Bitboard pawns = board.pieces[PAWN] & board.colors[strongSide];
+                int file = !(pawns & ~FILE_A) ? 0 : (!(pawns & ~(FILE_A << 7)) ? 7 : -1);
+                if (file < 0) break;
+                int queenSq = (strongSide == WHITE ? 56 : 0) + file;
+                int bishopSq = __builtin_ctzll(board.pieces[BISHOP] & board.colors[strongSide]);
+                if (squareColor(bishopSq) != squareColor(queenSq) && chebyshev(kingSquare(board, weak), queenSq) <= 1) {
+                    return 0;
+                }
+                break;
+            }
+            case SCALE_OPPOSITE_BISHOPS: {
+                int whiteBishop = __builtin_ctzll(board.pieces[BISHOP] & board.colors[WHITE]);
+                int blackBishop = __builtin_ctzll(board.pieces[BISHOP] & board.colors[BLACK]);
+                if (squareColor(whiteBishop) == squareColor(blackBishop)) break;
+                // Drawish unless the stronger side has several passed pawns to split the defence
+                int passed = __builtin_popcountll(board.pawnEntry().passed & board.colors[strongSide]);
+                return std::min(scale, passed <= 1 ? 16 : 32);
+            }
+            default:
+                break;
+        }
+        return scale;
+    }
+}
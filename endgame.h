@@ -0,0 +1,29 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "piece.h"
+#include "transposition_table.h"
+
+class Board;
+
+// Material-signature evaluation: game phase, imbalance, draw detection and endgame
+// scaling are computed once per material configuration and cached in a MaterialEntry.
+// Endgames with known technique get a specialised evaluator instead of the general one.
+namespace Endgame {
+    const int SCALE_NORMAL = 64;
+    const int KNOWN_WIN = 1000; // Well below mate scores, above any material edge it replaces
+
+    enum Type { NONE, KBNK, KPK };
+    enum ScaleType { SCALE_NONE, SCALE_WRONG_BISHOP, SCALE_OPPOSITE_BISHOPS };
+
+    void initMaterial(const Board& board, MaterialEntry& entry);
+
+    // Specialised evaluation of entry.endgame, from White's point of view. Returns false when
+    // the evaluator does not apply, leaving the position to the general evaluation.
+    bool evaluate(const Board& board, const MaterialEntry& entry, int& score);
+
+    // Scale (out of SCALE_NORMAL) for the endgame score when strongSide is ahead
+    int scaleFactor(const Board& board, const MaterialEntry& entry, Color strongSide);
+}
+
+#endif // ENDGAME_H
@@ -1,13 +1,16 @@
 #include "game.h"
 #include "benchmark.h"
+#include "microbench.h"
 #include "perft.h"
 #include "uci.h"
+#include "tuner.h"
+#include "tablebase.h"
 #include <iostream>
 #include <string>
 
 int main(int argc, char* argv[]) {
     if (argc > 1 && std::string(argv[1]) == "perft") {
-        runPerftSuite();
+        runPerft(argc, argv);
         return 0;
     }
 
@@ -16,6 +19,21 @@ int main(int argc, char* argv[]) {
         return 0;
     }
     
+    if (argc > 1 && std::string(argv[1]) == "microbench") {
+        runMicrobench(argc, argv);
+        return 0;
+    }
+    
+    if (argc > 1 && std::string(argv[1]) == "tune") {
+        runTuner(argc, argv);
+        return 0;
+    }
+    
+    if (argc > 1 && std::string(argv[1]) == "gentb") {
+        runGenTB(argc, argv);
+        return 0;
+    }
+    
     if (argc > 1 && std::string(argv[1]) == "uci") {
         UCI::loop();
         return 0;
@@ -0,0 +1,263 @@
+#include "microbench.h"
+#include "benchmark.h"
+#include "board.h"
+#include "zobrist.h"
+#include "transposition_table.h"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <iomanip>
+#include <algorithm>
+#include <random>
+#include <limits>
+#include <cstdlib>
+
+typedef std::chrono::steady_clock Clock;
+
+static const int DEFAULT_REPS = 200;
+static const double WARMUP_NS = 100e6;  // Per primitive, also used to size the batches
+static const double BATCH_NS = 1e6;     // Target duration of one timed repetition
+static const int TT_MB = 16;
+static const int TT_KEYS = 1 << 16;
+static const int INF_SCORE = std::numeric_limits<int>::max() - 1;
+
+struct MicroResult {
+    std::string name;
+    long long opsPerRep;
+    int reps;
+    double medianNs, p99Ns, minNs; // Per operation
+};
+
+struct Sample {
+    Board board;
+    Color turn;
+    Board::MoveList legal;
+    Board::MoveList captures;
+};
+
+static volatile unsigned long long sink = 0;
+
+static double nsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// Runs body (opsPerCall operations) until WARMUP_NS has passed, then times reps batches of
+// as many calls as fill BATCH_NS. Percentiles are taken over the per-batch ns/op.
+template<typename Body>
+static MicroResult measure(const std::string& name, long long opsPerCall, int reps, Body body) {
+    long long calls = 0;
+    Clock::time_point start = Clock::now();
+    do {
+        body();
+        calls++;
+    } while (nsSince(start) < WARMUP_NS);
+    int batch = std::max(1, (int)(BATCH_NS * calls / nsSince(start)));
+
+    std::vector<double> perOp;
+    for (int r = 0; r < reps; r++) {
+        Clock::time_point t0 = Clock::now();
+        for (int i = 0; i < batch; i++) body();
+        perOp.push_back(nsSince(t0) / ((double)batch * opsPerCall));
+    }
+    std::sort(perOp.begin(), perOp.end());
+
+    MicroResult result;
+    result.name = name;
+    result.opsPerRep = (long long)batch * opsPerCall;
+    result.reps = reps;
+    result.medianNs = perOp[perOp.size() / 2];
+    result.p99Ns = perOp[std::min(perOp.size() - 1, (size_t)(0.99 * perOp.size()))];
+    result.minNs = perOp[0];
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << result.medianNs << std::setw(12) << result.p99Ns
+              << std::setw(12) << result.minNs << std::setw(12) << result.opsPerRep << std::endl;
+    return result;
+}
+
+static bool writeCsv(const std::string& path, const std::vector<MicroResult>& results) {
+    std::ofstream out(path.c_str());
+    if (!out) return false;
+    out << "name,median_ns,p99_ns,min_ns,ops_per_rep,reps\n";
+    out << std::fixed << std::setprecision(2);
+    for (const MicroResult& r : results) {
+        out << r.name << ',' << r.medianNs << ',' << r.p99Ns << ',' << r.minNs << ','
+            << r.opsPerRep << ',' << r.reps << '\n';
+    }
+    return (bool)out;
+}
+
+void runMicrobench(int argc, char* argv[]) {
+    int reps = DEFAULT_REPS;
+    std::string outPath = "microbench.csv";
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-reps" && i + 1 < argc) reps = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-out" && i + 1 < argc) outPath = argv[++i];
+    }
+
+    // Nothing builds the boards' attack maps before isInCheck is timed, so it tests the squares
+    // directly, as it does after makeMove in the search
+    std::vector<Sample> samples(benchPositions().size());
+    long long positions = samples.size(), moves = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        samples[i].turn = samples[i].board.loadFEN(benchPositions()[i].fen);
+        samples[i].board.generateLegalMoves(samples[i].turn, samples[i].legal);
+        moves += samples[i].legal.size();
+        for (int j = 0; j < samples[i].legal.size(); j++) {
+            const Move& m = samples[i].legal[j];
+            if (samples[i].board.getPiece(m.toX, m.toY).type != EMPTY) samples[i].captures.push_back(m);
+        }
+    }
+
+    std::cout << "--- Starting Microbenchmarks ---" << std::endl;
+    std::cout << "Positions: " << positions << " | Legal moves: " << moves << " | Repetitions: " << reps
+              << std::endl << std::endl;
+    std::cout << std::left << std::setw(22) << "Primitive" << std::right << std::setw(12) << "Median ns"
+              << std::setw(12) << "p99 ns" << std::setw(12) << "Min ns" << std::setw(12) << "Ops/rep" << std::endl;
+    std::cout << std::string(70, '-') << std::endl;
+
+    std::vector<MicroResult> results;
+
+    results.push_back(measure("generateMoves", positions, reps, [&]() {
+        for (Sample& s : samples) {
+            Board::MoveList list;
+            s.board.generateMoves(s.turn, list);
+            sink = sink + list.size();
+        }
+    }));
+
+    results.push_back(measure("generateLegalMoves", positions, reps, [&]() {
+        for (Sample& s : samples) {
+            Board::MoveList list;
+            s.board.generateLegalMoves(s.turn, list);
+            sink = sink + list.size();
+        }
+    }));
+
+    results.push_back(measure("make_undo", moves, reps, [&]() {
+        for (Sample& s : samples) {
+            for (int i = 0; i < s.legal.size(); i++) {
+                const Move& m = s.legal[i];
+                GameState prevState = s.board.gameState;
+                Piece captured = s.board.getPiece(m.toX, m.toY);
+                s.board.makeMove(m);
+                sink = sink + s.board.gameState.zobristKey;
+                s.board.undoMove(m, captured, prevState);
+            }
+        }
+    }));
+
+    results.push_back(measure("isInCheck", positions * 2, reps, [&]() {
+        for (Sample& s : samples) {
+            sink = sink + s.board.isInCheck(WHITE) + s.board.isInCheck(BLACK);
+        }
+    }));
+
+    // The attack maps are dropped before each call so every evaluation builds them, as the
+    // first one at a search node does; the pawn and material entries come from their hashes
+    results.push_back(measure("evaluate", positions, reps, [&]() {
+        for (Sample& s : samples) {
+            s.board.clearAttackCache();
+            sink = sink + s.board.evaluate();
+        }
+    }));
+    for (Sample& s : samples) s.board.clearAttackCache();
+
+    // Capture ordering asks whether each victim is defended. A node whose evaluation exited
+    // lazily has no attack map; these rows compare building one for the question against
+    // testing each target square on its own, per node.
+    results.push_back(measure("captureDefended_map", positions, reps, [&]() {
+        for (Sample& s : samples) {
+            s.board.clearAttackCache();
+            const AttackInfo& ai = s.board.attacks();
+            for (int i = 0; i < s.captures.size(); i++) {
+                const Move& m = s.captures[i];
+                Color victim = s.board.getPiece(m.toX, m.toY).color;
+                sink = sink + ((ai.attacks[victim][EMPTY] >> (m.toX * 8 + m.toY)) & 1);
+            }
+        }
+    }));
+    for (Sample& s : samples) s.board.clearAttackCache();
+
+    results.push_back(measure("captureDefended_sq", positions, reps, [&]() {
+        for (Sample& s : samples) {
+            for (int i = 0; i < s.captures.size(); i++) {
+                const Move& m = s.captures[i];
+                sink = sink + s.board.isSquareUnderAttack(m.toX * 8 + m.toY, s.board.getPiece(m.toX, m.toY).color);
+            }
+        }
+    }));
+
+    results.push_back(measure("pawnEntry_hit", positions, reps, [&]() {
+        for (Sample& s : samples) sink = sink + s.board.pawnEntry().mgScore;
+    }));
+
+    // Overwriting the slot's key forces computePawnEntry on every probe
+    results.push_back(measure("pawnEntry_miss", positions, reps, [&]() {
+        for (Sample& s : samples) {
+            bool found;
+            PawnHashTable::local().probe(s.board.gameState.pawnKey, found)->key = ~s.board.gameState.pawnKey;
+            sink = sink + s.board.pawnEntry().mgScore;
+        }
+    }));
+
+    results.push_back(measure("Zobrist::computeHash", positions, reps, [&]() {
+        for (Sample& s : samples) sink = sink + Zobrist::computeHash(s.board, s.turn);
+    }));
+
+    // Random keys spread over a table larger than the caches, as in a long search. The stored
+    // keys take distinct low bits, so none of them evicts another and every hit probe hits.
+    std::mt19937_64 rng(20240501);
+    std::vector<unsigned long long> storedKeys(TT_KEYS), missingKeys(TT_KEYS);
+    for (int i = 0; i < TT_KEYS; i++) {
+        storedKeys[i] = (rng() & ~(unsigned long long)(TT_KEYS - 1)) | (unsigned long long)i;
+        missingKeys[i] = rng();
+    }
+    std::shuffle(storedKeys.begin(), storedKeys.end(), rng);
+    TranspositionTable tt(TT_MB);
+    tt.prefault();
+    Move none;
+
+    results.push_back(measure("tt_store", TT_KEYS, reps, [&]() {
+        bool collision;
+        for (int i = 0; i < TT_KEYS; i++) {
+            tt.store(storedKeys[i], 8, 0, i & 255, EXACT, none, collision);
+        }
+    }));
+
+    int found = 0;
+    for (int i = 0; i < TT_KEYS; i++) {
+        int score;
+        Move move;
+        bool hit;
+        tt.probe(storedKeys[i], 0, 0, -INF_SCORE, INF_SCORE, score, move, hit);
+        found += hit;
+    }
+    if (found != TT_KEYS) std::cout << "warning: tt_probe_hit finds only " << found << " of " << TT_KEYS << " keys" << std::endl;
+
+    results.push_back(measure("tt_probe_hit", TT_KEYS, reps, [&]() {
+        for (int i = 0; i < TT_KEYS; i++) {
+            int score;
+            Move move;
+            bool hit;
+            tt.probe(storedKeys[i], 0, 0, -INF_SCORE, INF_SCORE, score, move, hit);
+            sink = sink + hit;
+        }
+    }));
+
+    results.push_back(measure("tt_probe_miss", TT_KEYS, reps, [&]() {
+        for (int i = 0; i < TT_KEYS; i++) {
+            int score;
+            Move move;
+            bool hit;
+            tt.probe(missingKeys[i], 0, 0, -INF_SCORE, INF_SCORE, score, move, hit);
+            sink = sink + hit;
+        }
+    }));
+
+    std::cout << std::endl;
+    if (writeCsv(outPath, results)) std::cout << "Results written to " << outPath << std::endl;
+    else std::cout << "Failed to write " << outPath << std::endl;
+}
@@ -0,0 +1,13 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+// Timings of the engine's primitives (move generation, make/undo, check detection,
+// evaluation, capture defence tests, pawn hash, transposition table, Zobrist hashing) over
+// the bench positions. Each primitive is warmed up, then timed over repeated batches; the
+// median, p99 and fastest batch are reported in nanoseconds per operation and written as
+// CSV, one row per primitive, so two runs can be compared line by line.
+//
+// Usage: ./chess microbench [-reps N] [-out microbench.csv]
+void runMicrobench(int argc, char* argv[]);
+
+#endif // MICROBENCH_H
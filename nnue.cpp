@@ -0,0 +1,191 @@
+#include "nnue.h"
+#include "board.h"
+#include <fstream>
+#include <vector>
+#include <random>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+namespace NNUE {
+    bool enabled = false;
+
+    // Quantisation: accumulator activations are clipped to [0, QA], output weights are
+    // scaled by QB, and the final sum is mapped back to centipawns by OUTPUT_SCALE.
+    static const int QA = 255;
+    static const int QB = 64;
+    static const int OUTPUT_SCALE = 400;
+
+    static std::vector<int16_t> ftWeights;  // [FEATURES][HIDDEN]
+    static std::vector<int16_t> ftBiases;   // [HIDDEN]
+    static std::vector<int16_t> outWeights; // [2][HIDDEN], White half first
+    static int32_t outBias = 0;
+    static bool loaded = false;
+
+    bool isLoaded() { return loaded; }
+
+    const char* simdName() {
+#if defined(__AVX2__)
+        return "AVX2";
+#elif defined(__SSE4_1__)
+        return "SSE4.1";
+#else
+        return "scalar";
+#endif
+    }
+
+    // File layout (little endian): "HCNN", uint32 version = 1, uint32 FEATURES, uint32 HIDDEN,
+    // int16 ftWeights[FEATURES * HIDDEN], int16 ftBiases[HIDDEN], int16 outWeights[2 * HIDDEN], int32 outBias
+    bool load(const std::string& path) {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        if (!in) return false;
+
+        char magic[4];
+        uint32_t version = 0, features = 0, hidden = 0;
+        in.read(magic, 4);
+        in.read(reinterpret_cast<char*>(&version), sizeof(version));
+        in.read(reinterpret_cast<char*>(&features), sizeof(features));
+        in.read(reinterpret_cast<char*>(&hidden), sizeof(hidden));
+        if (!in || std::memcmp(magic, "HCNN", 4) != 0 || version != 1
+            || features != (uint32_t)FEATURES || hidden != (uint32_t)HIDDEN) {
+            return false;
+        }
+
+        std::vector<int16_t> w((size_t)FEATURES * HIDDEN), b(HIDDEN), ow(2 * HIDDEN);
+        int32_t ob = 0;
+        in.read(reinterpret_cast<char*>(w.data()), w.size() * sizeof(int16_t));
+        in.read(reinterpret_cast<char*>(b.data()), b.size() * sizeof(int16_t));
+        in.read(reinterpret_cast<char*>(ow.data()), ow.size() * sizeof(int16_t));
+        in.read(reinterpret_cast<char*>(&ob), sizeof(ob));
+        if (!in) return false;
+
+        ftWeights.swap(w);
+        ftBiases.swap(b);
+        outWeights.swap(ow);
+        outBias = ob;
+        loaded = true;
+        return true;
+    }
+
+    void initRandom(unsigned long long seed) {
+        std::mt19937_64 rng(seed);
+        std::uniform_int_distribution<int> ft(-32, 32), out(-64, 64);
+        ftWeights.assign((size_t)FEATURES * HIDDEN, 0);
+        ftBiases.assign(HIDDEN, 0);
+        outWeights.assign(2 * HIDDEN, 0);
+        for (size_t i = 0; i < ftWeights.size(); i++) ftWeights[i] = (int16_t)ft(rng);
+        for (int i = 0; i < HIDDEN; i++) ftBiases[i] = (int16_t)ft(rng);
+        for (int i = 0; i < 2 * HIDDEN; i++) outWeights[i] = (int16_t)out(rng);
+        outBias = 0;
+        loaded = true;
+    }
+
+    int featureIndex(Color perspective, int kingSq, Piece p, int sq) {
+        // Mirror ranks for Black so both perspectives share one weight set
+        if (perspective == BLACK) {
+            kingSq ^= 56;
+            sq ^= 56;
+        }
+        int kind = (p.type - PAWN) + (p.color == perspective ? 0 : 5);
+        return (kingSq * 10 + kind) * 64 + sq;
+    }
+
+    void addFeature(int16_t* acc, int index) {
+        const int16_t* w = &ftWeights[(size_t)index * HIDDEN];
+#if defined(__AVX2__)
+        for (int i = 0; i < HIDDEN; i += 16) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_add_epi16(a, b));
+        }
+#elif defined(__SSE4_1__)
+        for (int i = 0; i < HIDDEN; i += 8) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), _mm_add_epi16(a, b));
+        }
+#else
+        for (int i = 0; i < HIDDEN; i++) acc[i] += w[i];
+#endif
+    }
+
+    void subFeature(int16_t* acc, int index) {
+        const int16_t* w = &ftWeights[(size_t)index * HIDDEN];
+#if defined(__AVX2__)
+        for (int i = 0; i < HIDDEN; i += 16) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_sub_epi16(a, b));
+        }
+#elif defined(__SSE4_1__)
+        for (int i = 0; i < HIDDEN; i += 8) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), _mm_sub_epi16(a, b));
+        }
+#else
+        for (int i = 0; i < HIDDEN; i++) acc[i] -= w[i];
+#endif
+    }
+
+    void refresh(const Board& board, Color perspective, int16_t* acc) {
+        std::memcpy(acc, ftBiases.data(), HIDDEN * sizeof(int16_t));
+        int kingSq = board.kingPos[perspective].first * 8 + board.kingPos[perspective].second;
+        Bitboard occ = (board.colors[WHITE] | board.colors[BLACK]) & ~board.pieces[KING];
+        while (occ) {
+            int sq = __builtin_ctzll(occ);
+            addFeature(acc, featureIndex(perspective, kingSq, board.pieceList[sq], sq));
+            occ &= occ - 1;
+        }
+    }
+
+    // Clipped-ReLU dot product of one accumulator with its half of the output weights
+    static int32_t dotClipped(const int16_t* acc, const int16_t* w) {
+#if defined(__AVX2__)
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i qa = _mm256_set1_epi16(QA);
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < HIDDEN; i += 16) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+            a = _mm256_min_epi16(_mm256_max_epi16(a, zero), qa);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, b));
+        }
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+        return _mm_cvtsi128_si32(s);
+#elif defined(__SSE4_1__)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i qa = _mm_set1_epi16(QA);
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < HIDDEN; i += 8) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+            a = _mm_min_epi16(_mm_max_epi16(a, zero), qa);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(a, b));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        return _mm_cvtsi128_si32(sum);
+#else
+        int32_t sum = 0;
+        for (int i = 0; i < HIDDEN; i++) {
+            int v = acc[i] < 0 ? 0 : (acc[i] > QA ? QA : acc[i]);
+            sum += v * w[i];
+        }
+        return sum;
+#endif
+    }
+
+    int output(const int16_t* whiteAcc, const int16_t* blackAcc) {
+        int64_t sum = (int64_t)dotClipped(whiteAcc, outWeights.data())
+                    - (int64_t)dotClipped(blackAcc, outWeights.data() + HIDDEN)
+                    + outBias;
+        return (int)(sum * OUTPUT_SCALE / (QA * QB));
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "piece.h"
+#include <string>
+
+class Board;
+
+// Efficiently updatable neural evaluation.
+//
+// Architecture: HalfKP-style king-relative inputs (own king square x 10 non-king
+// piece kinds x 64 squares, mirrored vertically for Black) feed a 256-wide int16
+// accumulator per perspective. The output layer scores each clipped-ReLU
+// accumulator with its own half of the output weights (White half first) and
+// returns white - black + bias, a White-relative score like Board::evaluate.
+namespace NNUE {
+    const int HIDDEN = 256;
+    const int FEATURES = 64 * 10 * 64;
+
+    // Set via the UseNNUE UCI option; only takes effect once a network is loaded
+    extern bool enabled;
+
+    bool load(const std::string& path);
+    void initRandom(unsigned long long seed); // Synthetic weights for throughput benchmarks only
+    bool isLoaded();
+
+    int featureIndex(Color perspective, int kingSq, Piece p, int sq);
+    void addFeature(int16_t* acc, int index);
+    void subFeature(int16_t* acc, int index);
+    void refresh(const Board& board, Color perspective, int16_t* acc);
+    int output(const int16_t* whiteAcc, const int16_t* blackAcc);
+
+    const char* simdName();
+}
+
+#endif // NNUE_H
@@ -1,36 +1,168 @@
 #include "perft.h"
+#include "uci.h"
 #include <iostream>
 #include <chrono>
 #include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
 
-long long perft(Board& board, Color turn, int depth) {
+static size_t perftBuckets(int mb) {
+    size_t buckets = 1;
+    while (buckets * 2 * 2 * 2 * sizeof(unsigned long long) <= (size_t)mb * 1024 * 1024) buckets *= 2;
+    return buckets;
+}
+
+PerftTable::PerftTable(int mb) : table(perftBuckets(mb) * 2), mask(perftBuckets(mb) - 1) {}
+
+bool PerftTable::probe(unsigned long long key, int depth, long long& count) const {
+    const Entry* bucket = &table[(key & mask) * 2];
+    for (int i = 0; i < 2; i++) {
+        unsigned long long data = bucket[i].data.load(std::memory_order_relaxed);
+        unsigned long long check = bucket[i].check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && (int)(data & 0xFF) == depth) {
+            count = (long long)(data >> 8);
+            return true;
+        }
+    }
+    return false;
+}
+
+void PerftTable::store(unsigned long long key, int depth, long long count) {
+    Entry* bucket = &table[(key & mask) * 2];
+    Entry& slot = depth >= (int)(bucket[0].data.load(std::memory_order_relaxed) & 0xFF) ? bucket[0] : bucket[1];
+    unsigned long long data = ((unsigned long long)count << 8) | (unsigned long long)depth;
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+}
+
+template<Color Us>
+static long long perft(Board& board, int depth, PerftTable* table, const std::atomic<bool>* stop) {
     if (depth == 0) return 1;
+    // Bulk counting: the leaves are counted, never made
+    if (depth == 1) return board.countLegalMoves<Us>();
+    if (stop && stop->load(std::memory_order_relaxed)) return 0;
     
     long long nodes = 0;
+    unsigned long long key = board.gameState.zobristKey;
+    if (table && table->probe(key, depth, nodes)) return nodes;
+    
     Board::MoveList moves;
-    board.generateLegalMoves(turn, moves);
+    board.generateLegalMoves<Us>(moves);
     
     for (const auto& move : moves) {
         GameState prevState = board.gameState;
         Piece captured = board.getPiece(move.toX, move.toY);
-        board.makeMove(move);
+        board.makeMove<Us>(move);
         
-        nodes += perft(board, turn == WHITE ? BLACK : WHITE, depth - 1);
+        nodes += perft<Us == WHITE ? BLACK : WHITE>(board, depth - 1, table, stop);
         
         board.undoMove(move, captured, prevState);
     }
+    // A stopped count is incomplete and must not be cached. The flag is not polled at the
+    // bulk-counted last ply, where most of the calls are.
+    if (stop && stop->load(std::memory_order_relaxed)) return 0;
+    if (table) table->store(key, depth, nodes);
     return nodes;
 }
 
-void testPosition(const std::string& fen, int depth, long long expectedNodes) {
+long long perft(Board& board, Color turn, int depth, PerftTable* table, const std::atomic<bool>* stop) {
+    return turn == WHITE ? perft<WHITE>(board, depth, table, stop) : perft<BLACK>(board, depth, table, stop);
+}
+
+std::vector<long long> perftRoot(Board& board, Color turn, const Board::MoveList& rootMoves, int depth,
+                                 int threads, PerftTable* table, const std::atomic<bool>* stop) {
+    std::vector<long long> counts(rootMoves.size(), depth > 1 ? 0 : 1);
+    if (depth <= 1) return counts;
+    Color them = turn == WHITE ? BLACK : WHITE;
+    
+    // Splitting the second ply as well keeps workers busy when a few root moves dominate
+    struct Task { int root; Move reply; bool hasReply; };
+    std::vector<Task> tasks;
+    for (int i = 0; i < rootMoves.size(); i++) {
+        if (depth < 3) {
+            tasks.push_back({i, Move(), false});
+            continue;
+        }
+        GameState prevState = board.gameState;
+        Piece captured = board.getPiece(rootMoves[i].toX, rootMoves[i].toY);
+        board.makeMove(rootMoves[i]);
+        Board::MoveList replies;
+        board.generateLegalMoves(them, replies);
+        board.undoMove(rootMoves[i], captured, prevState);
+        for (const Move& reply : replies) tasks.push_back({i, reply, true});
+    }
+    
+    std::vector<long long> results(tasks.size(), 0);
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        Board local = board;
+        for (;;) {
+            size_t t = next.fetch_add(1);
+            if (t >= tasks.size() || (stop && stop->load(std::memory_order_relaxed))) break;
+            const Task& task = tasks[t];
+            const Move& move = rootMoves[task.root];
+            GameState rootState = local.gameState;
+            Piece rootCaptured = local.getPiece(move.toX, move.toY);
+            local.makeMove(move);
+            if (task.hasReply) {
+                GameState replyState = local.gameState;
+                Piece replyCaptured = local.getPiece(task.reply.toX, task.reply.toY);
+                local.makeMove(task.reply);
+                results[t] = perft(local, turn, depth - 2, table, stop);
+                local.undoMove(task.reply, replyCaptured, replyState);
+            } else {
+                results[t] = perft(local, them, depth - 1, table, stop);
+            }
+            local.undoMove(move, rootCaptured, rootState);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threads; t++) workers.emplace_back(worker);
+    worker();
+    for (std::thread& w : workers) w.join();
+    
+    for (size_t t = 0; t < tasks.size(); t++) counts[tasks[t].root] += results[t];
+    return counts;
+}
+
+long long perftDivide(Board& board, Color turn, int depth, int threads, PerftTable* table,
+                      const std::atomic<bool>* stop) {
+    Board::MoveList moves;
+    board.generateLegalMoves(turn, moves);
+    std::vector<long long> counts = perftRoot(board, turn, moves, depth, threads, table, stop);
+    if (stop && stop->load(std::memory_order_relaxed)) {
+        std::cout << "info string perft stopped" << std::endl;
+        return -1;
+    }
+    long long total = 0;
+    for (int i = 0; i < moves.size(); i++) {
+        std::cout << UCI::moveToString(moves[i]) << ": " << counts[i] << std::endl;
+        total += counts[i];
+    }
+    std::cout << std::endl << "Nodes searched: " << total << std::endl;
+    return total;
+}
+
+// Total count over the root moves with a fresh table of hashMB (none when 0), timed
+static long long timedPerft(Board& board, Color turn, int depth, int threads, int hashMB, double& secs) {
+    PerftTable table(std::max(hashMB, 1));
+    Board::MoveList moves;
+    board.generateLegalMoves(turn, moves);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<long long> counts = perftRoot(board, turn, moves, depth, threads, hashMB > 0 ? &table : nullptr);
+    secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    long long total = 0;
+    for (long long c : counts) total += c;
+    return total;
+}
+
+static void testPosition(const std::string& fen, int depth, long long expectedNodes, int threads, int hashMB) {
     Board board;
     Color turn = board.loadFEN(fen);
     
-    auto start = std::chrono::high_resolution_clock::now();
-    long long nodes = perft(board, turn, depth);
-    auto end = std::chrono::high_resolution_clock::now();
-    
-    double duration = std::chrono::duration<double>(end - start).count();
+    double duration;
+    long long nodes = timedPerft(board, turn, depth, threads, hashMB, duration);
     
     std::cout << "FEN: " << fen << std::endl;
     std::cout << "Depth: " << depth << " | Nodes: " << nodes;
@@ -39,21 +171,64 @@ void testPosition(const std::string& fen, int depth, long long expectedNodes) {
     } else {
         std::cout << " [FAIL! Expected " << expectedNodes << "]";
     }
-    std::cout << " | Time: " << duration << "s" << std::endl;
+    std::cout << " | Time: " << duration << "s | NPS: " << (long long)(nodes / std::max(duration, 1e-6)) << std::endl;
     std::cout << "---------------------------------------" << std::endl;
 }
 
-void runPerftSuite() {
+void runPerftSuite(int threads, int hashMB) {
     std::cout << "--- Starting PERFT Suite ---" << std::endl;
     
     // Position 1: Initial
-    testPosition("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4, 197281);
+    testPosition("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609, threads, hashMB);
     
     // Position 2: Kiwipete
-    testPosition("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 3, 97862);
+    testPosition("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603, threads, hashMB);
     
     // Position 3: Endgames / edge cases
-    testPosition("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 4, 43238);
+    testPosition("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624, threads, hashMB);
+    
+    // Position 4: Promotions, castling through check and pinned en passant
+    testPosition("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333, threads, hashMB);
     
     std::cout << "--- PERFT Suite Finished ---" << std::endl;
 }
+
+void runPerft(int argc, char* argv[]) {
+    int depth = 0;
+    int threads = 1;
+    int hashMB = PerftTable::DEFAULT_MB;
+    std::string fen;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-threads" && i + 1 < argc) threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "-hash" && i + 1 < argc) hashMB = std::max(0, std::atoi(argv[++i]));
+        else if (depth == 0) depth = std::atoi(arg.c_str());
+        else fen += (fen.empty() ? "" : " ") + arg;
+    }
+    if (depth <= 0) {
+        runPerftSuite(threads, hashMB);
+        return;
+    }
+    if (fen.empty()) fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    Board board;
+    Color turn = board.loadFEN(fen);
+    
+    double baseSecs = 0;
+    long long baseNodes = 0;
+    if (threads > 1) baseNodes = timedPerft(board, turn, depth, 1, hashMB, baseSecs);
+    
+    PerftTable table(std::max(hashMB, 1));
+    auto start = std::chrono::steady_clock::now();
+    long long nodes = perftDivide(board, turn, depth, threads, hashMB > 0 ? &table : nullptr);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    if (threads > 1) {
+        std::cout << "Threads: 1 | Time: " << baseSecs << "s | NPS: " << (long long)(baseNodes / std::max(baseSecs, 1e-6)) << std::endl;
+    }
+    std::cout << "Threads: " << threads << " | Time: " << secs << "s | NPS: " << (long long)(nodes / std::max(secs, 1e-6));
+    if (threads > 1) {
+        std::cout << " | Speedup: " << baseSecs / std::max(secs, 1e-6) << "x";
+        if (baseNodes != nodes) std::cout << " [FAIL! single-threaded count was " << baseNodes << "]";
+    }
+    std::cout << std::endl;
+}
@@ -2,8 +2,53 @@
 #define PERFT_H
 
 #include "board.h"
+#include <atomic>
+#include <vector>
 
-long long perft(Board& board, Color turn, int depth);
-void runPerftSuite();
+// Subtree leaf counts keyed by (Zobrist key, depth), shared lock-free between perft threads.
+// Each entry stores key ^ data next to data, so a slot torn by concurrent writers fails the
+// key check instead of returning a wrong count. Buckets hold a depth-preferred slot and an
+// always-replace slot; the depth is packed into the low byte of the stored count.
+class PerftTable {
+private:
+    struct Entry {
+        std::atomic<unsigned long long> check; // key ^ data
+        std::atomic<unsigned long long> data;  // count << 8 | depth
+    };
+    std::vector<Entry> table;
+    size_t mask; // Bucket index mask; bucket i is entries 2i and 2i+1
+
+public:
+    static const int DEFAULT_MB = 64;
+
+    explicit PerftTable(int mb = DEFAULT_MB);
+    bool probe(unsigned long long key, int depth, long long& count) const;
+    void store(unsigned long long key, int depth, long long count);
+};
+
+// Leaf nodes of the legal move tree. The last ply is counted without making the moves,
+// and subtrees are cached in table when one is given. Raising stop abandons the count;
+// the result is then meaningless.
+long long perft(Board& board, Color turn, int depth, PerftTable* table = nullptr,
+                const std::atomic<bool>* stop = nullptr);
+
+// Subtree count of each root move, split over threads that each search on their own copy
+// of the board. Root moves (and, from depth 3, every root/reply pair) are handed out from a
+// shared queue and summed in move order, so the result does not depend on scheduling.
+std::vector<long long> perftRoot(Board& board, Color turn, const Board::MoveList& rootMoves, int depth,
+                                 int threads, PerftTable* table = nullptr, const std::atomic<bool>* stop = nullptr);
+
+// Prints each root move with its subtree count ("e2e4: 20"), then the total; returns the total.
+// When stop is raised it prints "info string perft stopped" instead and returns -1.
+long long perftDivide(Board& board, Color turn, int depth, int threads = 1, PerftTable* table = nullptr,
+                      const std::atomic<bool>* stop = nullptr);
+
+void runPerftSuite(int threads = 1, int hashMB = PerftTable::DEFAULT_MB);
+
+// Usage: ./chess perft [depth [fen]] [-threads N] [-hash MB]
+// Without a depth runs the validation suite; with one prints divide output for the start
+// position or the given FEN. With more than one thread the count is first repeated on a
+// single thread to report the speedup. -hash 0 disables the perft hash.
+void runPerft(int argc, char* argv[]);
 
 #endif // PERFT_H
@@ -32,24 +32,35 @@ struct Move {
         : fromX(fx), fromY(fy), toX(tx), toY(ty), promotion(prom), isEnPassant(enPass), isCastle(castle) {}
 };
 
+// Castling rights as a 4-bit mask; the value indexes Zobrist::castleKeys directly
+enum CastlingRight {
+    WHITE_KINGSIDE = 1, WHITE_QUEENSIDE = 2, BLACK_KINGSIDE = 4, BLACK_QUEENSIDE = 8,
+    WHITE_CASTLING = WHITE_KINGSIDE | WHITE_QUEENSIDE,
+    BLACK_CASTLING = BLACK_KINGSIDE | BLACK_QUEENSIDE,
+    ALL_CASTLING = WHITE_CASTLING | BLACK_CASTLING
+};
+
+const uint8_t NO_SQUARE = 64;
+
+// Everything undoMove cannot recompute, packed so that saving and restoring it around a
+// move is a single 40-byte copy
 struct GameState {
-    bool whiteCanCastleKingside;
-    bool whiteCanCastleQueenside;
-    bool blackCanCastleKingside;
-    bool blackCanCastleQueenside;
-    int enPassantX, enPassantY;
-    bool hasEnPassant;
     unsigned long long zobristKey;
     unsigned long long pawnKey;
-    int halfmoveClock;
-    int fullmoveNumber;
-    int mgScore;
-    int egScore;
+    unsigned long long materialKey;
+    int16_t mgScore;          // Incremental material + PST, White relative
+    int16_t egScore;
+    uint16_t halfmoveClock;
+    uint16_t fullmoveNumber;
+    Color sideToMove;
+    uint8_t castlingRights;   // CastlingRight mask
+    uint8_t epSquare;         // Square a pawn skipped over on the last move, or NO_SQUARE
+
+    bool hasEnPassant() const { return epSquare != NO_SQUARE; }
     
-    GameState() : whiteCanCastleKingside(true), whiteCanCastleQueenside(true),
-                  blackCanCastleKingside(true), blackCanCastleQueenside(true),
-                  enPassantX(-1), enPassantY(-1), hasEnPassant(false), zobristKey(0), pawnKey(0),
-                  halfmoveClock(0), fullmoveNumber(1), mgScore(0), egScore(0) {}
+    GameState() : zobristKey(0), pawnKey(0), materialKey(0), mgScore(0), egScore(0),
+                  halfmoveClock(0), fullmoveNumber(1), sideToMove(WHITE),
+                  castlingRights(ALL_CASTLING), epSquare(NO_SQUARE) {}
 };
 
 #endif // PIECE_H
\ No newline at end of file
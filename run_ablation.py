@@ -7,7 +7,12 @@ configs = [
     {"name": "No Null Move", "args": ["-no-null"]},
     {"name": "No LMR", "args": ["-no-lmr"]},
     {"name": "No Killer", "args": ["-no-killer"]},
-    {"name": "No History", "args": ["-no-history"]}
+    {"name": "No History", "args": ["-no-history"]},
+    {"name": "No Delta Pruning", "args": ["-no-delta"]},
+    {"name": "No QS Futility", "args": ["-no-qfutility"]},
+    {"name": "No QS SEE", "args": ["-no-qsee"]},
+    {"name": "No QS Checks", "args": ["-no-qchecks"]},
+    {"name": "No Lazy Eval", "args": ["-no-lazy"]}
 ]
 
 engine_path = "./chess_engine.exe"
@@ -0,0 +1,912 @@
+#include "tablebase.h"
+#include "board.h"
+#include "zobrist.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <set>
+#include <cstring>
+#include <cstdlib>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Tablebases {
+    bool enabled = true;
+
+    static const char* SIDE_PIECES = "QRBNP";   // Order of the pieces within a side of a table name
+    static const char* PIECE_CHARS = " PNBRQK"; // Indexed by PieceType
+    static const uint32_t MAGIC = 0x42545043;   // "CPTB"
+    static const uint32_t VERSION = 2;          // 2: double pushes are scored with the en passant reply
+    static const size_t HEADER_SIZE = 16;       // Magic, version, entry count, reserved
+
+    // Generation-only states; neither is ever written to a table file
+    static const uint8_t UNKNOWN = 254;
+    static const uint8_t NON_LOSING = 255; // Some capture or promotion draws or wins
+    static const int MAX_DTM = 125;
+
+    // Pieces are ordered White king, Black king, White's other pieces, Black's other pieces.
+    // The White king takes one of 10 triangle slots (a1-d1-d4) in pawnless tables and one of
+    // 32 squares on files a-d otherwise; pawns index ranks 2-7 only.
+    struct TableSpec {
+        std::string name;
+        int count;
+        PieceType type[MAX_PIECES];
+        Color color[MAX_PIECES];
+        bool sameAsPrev[MAX_PIECES]; // Identical to the previous piece: the pair is stored sorted
+        int range[MAX_PIECES];
+        bool hasPawns;
+        size_t size;
+    };
+
+    struct Table {
+        TableSpec spec;
+        const uint8_t* data; // Entries, past the header
+        void* mapping;
+        size_t mappedSize;
+#ifdef _WIN32
+        HANDLE file, map;
+#endif
+    };
+
+    struct TableRef {
+        const Table* table;
+        bool flipped; // The table's White pieces are Black's on the board
+    };
+
+    static std::vector<std::unique_ptr<Table>> tables;
+    static std::unordered_map<unsigned long long, TableRef> byMaterial;
+    static int maxLoadedPieces = 0;
+
+    static int triangleSlot[64];
+    static int triangleSquare[10];
+    static std::once_flag initFlag;
+
+    static void buildTriangle() {
+        Zobrist::init();
+        int slot = 0;
+        for (int sq = 0; sq < 64; sq++) {
+            int rank = sq >> 3, file = sq & 7;
+            triangleSlot[sq] = (file < 4 && rank <= file) ? slot++ : -1;
+            if (triangleSlot[sq] >= 0) triangleSquare[triangleSlot[sq]] = sq;
+        }
+    }
+
+    // load() runs from the UCI thread and from the gentb and test drivers; the squares are set once
+    static void init() {
+        std::call_once(initFlag, buildTriangle);
+    }
+
+    static int sideRank(char c) { return (int)(std::strchr(SIDE_PIECES, c) - SIDE_PIECES); }
+
+    // A side with more pieces, then stronger pieces, is the table's White
+    static bool strongerOrEqual(const std::string& a, const std::string& b) {
+        if (a.size() != b.size()) return a.size() > b.size();
+        for (size_t i = 1; i < a.size(); i++) {
+            if (a[i] != b[i]) return sideRank(a[i]) < sideRank(b[i]);
+        }
+        return true;
+    }
+
+    static std::string tableName(const int counts[2][7]) {
+        std::string side[2];
+        for (int c = WHITE; c <= BLACK; c++) {
+            side[c] = "K";
+            for (const char* p = SIDE_PIECES; *p; p++) {
+                PieceType t = (PieceType)(std::strchr(PIECE_CHARS, *p) - PIECE_CHARS);
+                side[c] += std::string(counts[c][t], *p);
+            }
+        }
+        return strongerOrEqual(side[WHITE], side[BLACK]) ? side[WHITE] + "v" + side[BLACK]
+                                                         : side[BLACK] + "v" + side[WHITE];
+    }
+
+    static bool makeSpec(const std::string& name, TableSpec& spec) {
+        size_t v = name.find('v');
+        if (v == std::string::npos || name[0] != 'K' || v + 1 >= name.size() || name[v + 1] != 'K') return false;
+        std::string side[2] = {name.substr(1, v - 1), name.substr(v + 2)};
+
+        spec.name = name;
+        spec.type[0] = spec.type[1] = KING;
+        spec.color[0] = WHITE;
+        spec.color[1] = BLACK;
+        spec.count = 2;
+        spec.hasPawns = false;
+        for (int c = WHITE; c <= BLACK; c++) {
+            for (char ch : side[c]) {
+                const char* p = std::strchr(SIDE_PIECES, ch);
+                if (!p || !ch || spec.count == MAX_PIECES) return false;
+                spec.type[spec.count] = (PieceType)(std::strchr(PIECE_CHARS, ch) - PIECE_CHARS);
+                spec.color[spec.count] = (Color)c;
+                spec.hasPawns |= spec.type[spec.count] == PAWN;
+                spec.count++;
+            }
+        }
+
+        spec.size = 2;
+        for (int i = 0; i < spec.count; i++) {
+            spec.sameAsPrev[i] = i >= 3 && spec.type[i] == spec.type[i - 1] && spec.color[i] == spec.color[i - 1];
+            spec.range[i] = i == 0 ? (spec.hasPawns ? 32 : 10) : (spec.type[i] == PAWN ? 48 : 64);
+            spec.size *= spec.range[i];
+        }
+        return true;
+    }
+
+    static void countPieces(const TableSpec& spec, int counts[2][7]) {
+        std::memset(counts, 0, sizeof(int) * 2 * 7);
+        for (int i = 2; i < spec.count; i++) counts[spec.color[i]][spec.type[i]]++;
+    }
+
+    // Tables reached by one capture or promotion
+    static std::vector<std::string> dependencies(const TableSpec& spec) {
+        std::vector<std::string> deps;
+        int counts[2][7];
+        countPieces(spec, counts);
+        for (int c = WHITE; c <= BLACK; c++) {
+            for (int t = PAWN; t <= QUEEN; t++) {
+                if (!counts[c][t]) continue;
+                counts[c][t]--;
+                if (spec.count > 3) deps.push_back(tableName(counts));
+                if (t == PAWN) {
+                    for (int p = KNIGHT; p <= QUEEN; p++) {
+                        counts[c][p]++;
+                        deps.push_back(tableName(counts));
+                        counts[c][p]--;
+                    }
+                }
+                counts[c][t]++;
+            }
+        }
+        return deps;
+    }
+
+    static int pawnCount(const std::string& name) { return (int)std::count(name.begin(), name.end(), 'P'); }
+
+    std::vector<std::string> allTables() {
+        std::vector<std::string> names;
+        for (int i = 0; i < 5; i++) {
+            names.push_back(std::string("K") + SIDE_PIECES[i] + "vK");
+        }
+        for (int i = 0; i < 5; i++) {
+            for (int j = i; j < 5; j++) {
+                names.push_back(std::string("K") + SIDE_PIECES[i] + SIDE_PIECES[j] + "vK");
+                names.push_back(std::string("K") + SIDE_PIECES[i] + "vK" + SIDE_PIECES[j]);
+            }
+        }
+        // Captures shrink a table and promotions remove a pawn, so this order resolves every dependency
+        std::stable_sort(names.begin(), names.end(), [](const std::string& a, const std::string& b) {
+            int pa = pawnCount(a), pb = pawnCount(b);
+            return pa != pb ? pa < pb : a.size() < b.size();
+        });
+        return names;
+    }
+
+    // ---------------------------------------------------------------------------------------
+    // Indexing
+    // ---------------------------------------------------------------------------------------
+
+    static inline int transformSquare(int sq, int t) {
+        int rank = sq >> 3, file = sq & 7;
+        if (t & 1) file = 7 - file;
+        if (t & 2) rank = 7 - rank;
+        if (t & 4) std::swap(rank, file);
+        return rank * 8 + file;
+    }
+
+    static inline size_t rawIndex(const TableSpec& spec, const int* sq, int stm) {
+        size_t idx = (size_t)stm * spec.range[0]
+                   + (spec.hasPawns ? (sq[0] >> 3) * 4 + (sq[0] & 7) : triangleSlot[sq[0]]);
+        for (int i = 1; i < spec.count; i++) {
+            idx = idx * spec.range[i] + (spec.type[i] == PAWN ? sq[i] - 8 : sq[i]);
+        }
+        return idx;
+    }
+
+    static inline size_t symmetricIndex(const TableSpec& spec, const int* sq, int stm, int s) {
+        int t[MAX_PIECES];
+        for (int i = 0; i < spec.count; i++) t[i] = transformSquare(sq[i], s);
+        for (int i = 3; i < spec.count; i++) {
+            if (spec.sameAsPrev[i] && t[i] < t[i - 1]) std::swap(t[i], t[i - 1]);
+        }
+        return rawIndex(spec, t, stm);
+    }
+
+    // Index under the board symmetry that brings the White king into its slots (files a-d only
+    // with pawns); a king on the long diagonal has two images and takes the lower index
+    static size_t encode(const TableSpec& spec, const int* sq, int stm) {
+        int s = (sq[0] & 7) >= 4 ? 1 : 0;
+        if (spec.hasPawns) return symmetricIndex(spec, sq, stm, s);
+        if ((sq[0] >> 3) >= 4) s |= 2;
+        int k = transformSquare(sq[0], s);
+        if ((k >> 3) > (k & 7)) return symmetricIndex(spec, sq, stm, s | 4);
+        size_t idx = symmetricIndex(spec, sq, stm, s);
+        return (k >> 3) == (k & 7) ? std::min(idx, symmetricIndex(spec, sq, stm, s | 4)) : idx;
+    }
+
+    static void decode(const TableSpec& spec, size_t idx, int* sq, int& stm) {
+        for (int i = spec.count - 1; i >= 1; i--) {
+            int v = (int)(idx % spec.range[i]);
+            idx /= spec.range[i];
+            sq[i] = spec.type[i] == PAWN ? v + 8 : v;
+        }
+        int k = (int)(idx % spec.range[0]);
+        sq[0] = spec.hasPawns ? (k / 4) * 8 + (k % 4) : triangleSquare[k];
+        stm = (int)(idx / spec.range[0]);
+    }
+
+    // ---------------------------------------------------------------------------------------
+    // Mapping and probing
+    // ---------------------------------------------------------------------------------------
+
+    static unsigned long long materialKey(const TableSpec& spec, bool flipped) {
+        int n[2][7] = {};
+        unsigned long long key = 0;
+        for (int i = 2; i < spec.count; i++) {
+            int c = spec.color[i] ^ (int)flipped;
+            key ^= Zobrist::materialKeys[c][spec.type[i]][n[c][spec.type[i]]++];
+        }
+        return key;
+    }
+
+    static void unmap(Table& t) {
+#ifdef _WIN32
+        UnmapViewOfFile(t.mapping);
+        CloseHandle(t.map);
+        CloseHandle(t.file);
+#else
+        munmap(t.mapping, t.mappedSize);
+#endif
+    }
+
+    static bool mapTable(const std::string& path, const TableSpec& spec, Table& t) {
+        t.spec = spec;
+        t.mappedSize = HEADER_SIZE + spec.size;
+#ifdef _WIN32
+        t.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (t.file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(t.file, &fileSize) || (size_t)fileSize.QuadPart != t.mappedSize) {
+            CloseHandle(t.file);
+            return false;
+        }
+        t.map = CreateFileMapping(t.file, NULL, PAGE_READONLY, 0, 0, NULL);
+        t.mapping = t.map ? MapViewOfFile(t.map, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (!t.mapping) {
+            if (t.map) CloseHandle(t.map);
+            CloseHandle(t.file);
+            return false;
+        }
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size != t.mappedSize) {
+            close(fd);
+            return false;
+        }
+        t.mapping = mmap(NULL, t.mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (t.mapping == MAP_FAILED) return false;
+#endif
+        const uint32_t* header = static_cast<const uint32_t*>(t.mapping);
+        if (header[0] != MAGIC || header[1] != VERSION || header[2] != spec.size) {
+            unmap(t);
+            return false;
+        }
+        t.data = static_cast<const uint8_t*>(t.mapping) + HEADER_SIZE;
+        return true;
+    }
+
+    static void rebuildIndex() {
+        byMaterial.clear();
+        maxLoadedPieces = 0;
+        for (const std::unique_ptr<Table>& t : tables) {
+            TableRef ref = {t.get(), false};
+            byMaterial.insert(std::make_pair(materialKey(t->spec, false), ref));
+            ref.flipped = true;
+            byMaterial.insert(std::make_pair(materialKey(t->spec, true), ref)); // No-op for symmetric tables
+            maxLoadedPieces = std::max(maxLoadedPieces, t->spec.count);
+        }
+    }
+
+    static bool addTable(const std::string& path, const TableSpec& spec) {
+        std::unique_ptr<Table> t(new Table());
+        if (!mapTable(path, spec, *t)) return false;
+        tables.push_back(std::move(t));
+        rebuildIndex();
+        return true;
+    }
+
+    static void removeTable(const std::string& name) {
+        for (size_t i = 0; i < tables.size(); i++) {
+            if (tables[i]->spec.name != name) continue;
+            unmap(*tables[i]);
+            tables.erase(tables.begin() + i);
+            rebuildIndex();
+            return;
+        }
+    }
+
+    static bool isLoaded(const std::string& name) {
+        for (const std::unique_ptr<Table>& t : tables) {
+            if (t->spec.name == name) return true;
+        }
+        return false;
+    }
+
+    static std::string tablePath(const std::string& dir, const std::string& name) {
+        return dir + "/" + name + ".tb";
+    }
+
+    int load(const std::string& dir) {
+        init();
+        for (const std::unique_ptr<Table>& t : tables) unmap(*t);
+        tables.clear();
+        for (const std::string& name : allTables()) {
+            TableSpec spec;
+            makeSpec(name, spec);
+            std::unique_ptr<Table> t(new Table());
+            if (mapTable(tablePath(dir, name), spec, *t)) tables.push_back(std::move(t));
+        }
+        rebuildIndex();
+        return (int)tables.size();
+    }
+
+    int loadedCount() { return (int)tables.size(); }
+
+    // Raw table byte for the position; bare kings are a draw without a table
+    static bool probeValue(const Board& board, uint8_t& value) {
+        int count = __builtin_popcountll(board.colors[WHITE] | board.colors[BLACK]);
+        if (count == 2) {
+            value = DRAW;
+            return true;
+        }
+        if (count > maxLoadedPieces) return false;
+        std::unordered_map<unsigned long long, TableRef>::const_iterator it = byMaterial.find(board.gameState.materialKey);
+        if (it == byMaterial.end()) return false;
+
+        const TableSpec& spec = it->second.table->spec;
+        int flip = it->second.flipped ? 1 : 0;
+        int sq[MAX_PIECES];
+        for (int i = 0; i < spec.count; i++) {
+            Bitboard b = board.pieces[spec.type[i]] & board.colors[spec.color[i] ^ flip];
+            if (spec.sameAsPrev[i]) b &= b - 1;
+            sq[i] = __builtin_ctzll(b) ^ (flip ? 56 : 0);
+        }
+        value = it->second.table->data[encode(spec, sq, board.gameState.sideToMove ^ flip)];
+        return value != INVALID;
+    }
+
+    bool probe(const Board& board, int ply, int& score) {
+        if (!enabled || tables.empty()) return false;
+        const GameState& gs = board.gameState;
+        if (gs.hasEnPassant() || gs.castlingRights) {
+            return false;
+        }
+        uint8_t value;
+        if (!probeValue(board, value)) return false;
+        if (value == DRAW) score = 0;
+        else if (value < LOSS) score = 10000 - ply - value;
+        else score = -10000 + ply + (value - LOSS);
+        return true;
+    }
+
+    // ---------------------------------------------------------------------------------------
+    // Generation
+    // ---------------------------------------------------------------------------------------
+
+    // Runs fn(begin, end) over [0, count) in chunks handed out to the worker threads
+    template <typename Fn>
+    static void parallelFor(int threads, size_t count, Fn fn) {
+        const size_t CHUNK = 4096;
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            for (;;) {
+                size_t begin = next.fetch_add(CHUNK);
+                if (begin >= count) break;
+                fn(begin, std::min(count, begin + CHUNK));
+            }
+        };
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++) workers.emplace_back(worker);
+        worker();
+        for (std::thread& w : workers) w.join();
+    }
+
+    static void setupBoard(Board& board, const TableSpec& spec, const int* sq, int stm, int epSquare = NO_SQUARE) {
+        char grid[64] = {};
+        for (int i = 0; i < spec.count; i++) {
+            char c = PIECE_CHARS[spec.type[i]];
+            grid[sq[i]] = spec.color[i] == WHITE ? c : (char)(c - 'A' + 'a');
+        }
+        std::string fen;
+        for (int rank = 7; rank >= 0; rank--) {
+            int empty = 0;
+            for (int file = 0; file < 8; file++) {
+                char c = grid[rank * 8 + file];
+                if (!c) { empty++; continue; }
+                if (empty) fen += (char)('0' + empty);
+                empty = 0;
+                fen += c;
+            }
+            if (empty) fen += (char)('0' + empty);
+            if (rank) fen += '/';
+        }
+        fen += stm == WHITE ? " w - " : " b - ";
+        if (epSquare == NO_SQUARE) fen += '-';
+        else fen += std::string(1, (char)('a' + (epSquare & 7))) + (char)('1' + (epSquare >> 3));
+        fen += " 0 1";
+        board.loadFEN(fen);
+    }
+
+    static bool attacked(const TableSpec& spec, const int* sq, int target, Color by) {
+        Bitboard occupied = 0;
+        for (int i = 0; i < spec.count; i++) occupied |= setBit(sq[i]);
+        for (int i = 0; i < spec.count; i++) {
+            if (spec.color[i] != by) continue;
+            Bitboard attacks = 0;
+            switch (spec.type[i]) {
+                case PAWN:   attacks = Attacks::pawnAttacks[by][sq[i]]; break;
+                case KNIGHT: attacks = Attacks::knightAttacks[sq[i]]; break;
+                case BISHOP: attacks = Attacks::getBishopAttacks(sq[i], occupied); break;
+                case ROOK:   attacks = Attacks::getRookAttacks(sq[i], occupied); break;
+                case QUEEN:  attacks = Attacks::getQueenAttacks(sq[i], occupied); break;
+                case KING:   attacks = Attacks::kingAttacks[sq[i]]; break;
+                default: break;
+            }
+            if (attacks & setBit(target)) return true;
+        }
+        return false;
+    }
+
+    struct Generation {
+        TableSpec spec;
+        std::unique_ptr<std::atomic<uint8_t>[]> value;
+        std::unique_ptr<std::atomic<int16_t>[]> movesLeft; // Quiet moves not yet known to lose
+        std::vector<uint8_t> exitLoss; // Longest loss through a capture or promotion, or NON_LOSING
+        std::vector<std::vector<uint32_t>> level;   // Positions resolved at each distance
+        std::vector<std::vector<uint32_t>> exitWin; // Positions won through a capture or promotion
+        // (parent, child) pairs where the parent's double push lets the opponent take en passant
+        // and win at that distance; the move counts as lost then unless the child loses sooner
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> epReplyWin;
+        std::mutex mutex;
+        std::atomic<bool> missingTable;
+        bool enPassant; // Both sides have pawns, so a double push can be taken en passant
+
+        explicit Generation(const TableSpec& s)
+            : spec(s), value(new std::atomic<uint8_t>[s.size]), movesLeft(new std::atomic<int16_t>[s.size]), exitLoss(s.size, 0),
+              level(MAX_DTM + 2), exitWin(MAX_DTM + 2), epReplyWin(MAX_DTM + 2), missingTable(false), enPassant(false) {
+            bool pawns[2] = {false, false};
+            for (int i = 0; i < s.count; i++) pawns[s.color[i]] |= s.type[i] == PAWN;
+            enPassant = pawns[WHITE] && pawns[BLACK];
+        }
+
+        bool resolve(size_t idx, uint8_t v) {
+            uint8_t expected = UNKNOWN;
+            return value[idx].compare_exchange_strong(expected, v, std::memory_order_relaxed);
+        }
+
+        void merge(std::vector<std::vector<uint32_t>>& target, const std::vector<std::pair<int, uint32_t>>& found) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const std::pair<int, uint32_t>& f : found) target[f.first].push_back(f.second);
+        }
+    };
+
+    static inline bool isWin(uint8_t v) { return v != DRAW && v < LOSS; }
+
+    // The better of two outcomes for the side to move; an unresolved one only yields to a win
+    static uint8_t bestOutcome(uint8_t a, uint8_t b) {
+        if (isWin(a) || isWin(b)) return !isWin(b) ? a : (!isWin(a) ? b : std::min(a, b));
+        if (a == UNKNOWN || b == UNKNOWN) return UNKNOWN;
+        if (a == DRAW || b == DRAW) return DRAW;
+        return std::max(a, b);
+    }
+
+    // Tables hold no en passant rights, so the entry for the position after a double push
+    // lacks the capture the opponent may answer with. Returns the opponent's best en passant
+    // result (a table value for the side to move at sq), or UNKNOWN when no capture is legal,
+    // and sets only when the capture is the opponent's sole legal move. pusher indexes the pawn
+    // that just moved two squares.
+    static uint8_t enPassantReply(Generation& g, Board& board, const int* sq, int stm, int pusher, bool& only) {
+        bool adjacent = false;
+        for (int i = 2; i < g.spec.count; i++) {
+            adjacent |= g.spec.type[i] == PAWN && (int)g.spec.color[i] == stm && (sq[i] >> 3) == (sq[pusher] >> 3)
+                        && std::abs((sq[i] & 7) - (sq[pusher] & 7)) == 1;
+        }
+        if (!adjacent) return UNKNOWN;
+
+        setupBoard(board, g.spec, sq, stm, sq[pusher] + (stm == BLACK ? -8 : 8));
+        Board::MoveList moves;
+        board.generateLegalMoves((Color)stm, moves);
+        int captures = 0, bestWin = 0, longestLoss = 0;
+        bool draw = false;
+        for (const Move& m : moves) {
+            if (!m.isEnPassant) continue;
+            captures++;
+            GameState prevState = board.gameState;
+            Piece captured = board.getPiece(m.toX, m.toY);
+            board.makeMove(m);
+            uint8_t child;
+            bool found = probeValue(board, child);
+            board.undoMove(m, captured, prevState);
+            if (!found) {
+                g.missingTable = true;
+                continue;
+            }
+            if (child == DRAW) draw = true;
+            else if (child >= LOSS) bestWin = bestWin ? std::min(bestWin, child - LOSS + 1) : child - LOSS + 1;
+            else longestLoss = std::max(longestLoss, child + 1);
+        }
+        only = captures == moves.size();
+        if (!captures) return UNKNOWN;
+        return bestWin ? (uint8_t)bestWin : (draw ? DRAW : (uint8_t)(LOSS + longestLoss));
+    }
+
+    // Index of the pawn that double pushed from prev to sq, or -1
+    static int doublePusher(const TableSpec& spec, const int* prev, const int* sq) {
+        for (int i = 2; i < spec.count; i++) {
+            if (spec.type[i] == PAWN && std::abs(prev[i] - sq[i]) == 16) return i;
+        }
+        return -1;
+    }
+
+    // Piece squares after a quiet move from sq
+    static void quietSquares(const TableSpec& spec, const int* sq, const Move& m, int* child) {
+        int from = m.fromX * 8 + m.fromY, to = m.toX * 8 + m.toY;
+        for (int i = 0; i < spec.count; i++) child[i] = sq[i] == from ? to : sq[i];
+    }
+
+    // Index of the position after a quiet move from sq
+    static size_t quietChild(const TableSpec& spec, const int* sq, int stm, const Move& m) {
+        int child[MAX_PIECES];
+        quietSquares(spec, sq, m, child);
+        return encode(spec, child, stm ^ 1);
+    }
+
+    // Validity, mates and stalemates, and the result of every move that leaves the table.
+    // Quiet moves are counted per distinct child: a position symmetric to itself can have two
+    // moves to the same child, which the retrograde pass reaches only once.
+    static void initPositions(Generation& g, size_t begin, size_t end) {
+        Board board, epBoard;
+        std::vector<std::pair<int, uint32_t>> lost, won;
+        std::vector<std::pair<int, std::pair<uint32_t, uint32_t>>> epWins;
+        int sq[MAX_PIECES], stm;
+
+        for (size_t idx = begin; idx < end; idx++) {
+            g.value[idx].store(INVALID, std::memory_order_relaxed);
+            decode(g.spec, idx, sq, stm);
+
+            bool overlap = false;
+            for (int i = 0; i < g.spec.count; i++) {
+                for (int j = 0; j < i; j++) overlap |= sq[i] == sq[j];
+            }
+            if (overlap || (Attacks::kingAttacks[sq[0]] & setBit(sq[1])) || encode(g.spec, sq, stm) != idx) continue;
+
+            setupBoard(board, g.spec, sq, stm);
+            Color us = (Color)stm, them = us == WHITE ? BLACK : WHITE;
+            if (board.isInCheck(them)) continue;
+
+            Board::MoveList moves;
+            board.generateLegalMoves(us, moves);
+            if (moves.empty()) {
+                bool mated = board.isInCheck(us);
+                g.value[idx].store(mated ? LOSS : DRAW, std::memory_order_relaxed);
+                if (mated) lost.push_back(std::make_pair(0, (uint32_t)idx));
+                continue;
+            }
+
+            size_t children[256];
+            int inTable = 0, bestWin = 0, longestLoss = 0;
+            bool nonLosing = false;
+            for (const Move& m : moves) {
+                Piece captured = board.getPiece(m.toX, m.toY);
+                if (captured.type == EMPTY && m.promotion == EMPTY) {
+                    size_t child = quietChild(g.spec, sq, stm, m);
+                    if (std::find(children, children + inTable, child) == children + inTable) children[inTable++] = child;
+                    if (g.enPassant && std::abs(m.toX - m.fromX) == 2 && board.getPiece(m.fromX, m.fromY).type == PAWN) {
+                        int next[MAX_PIECES];
+                        quietSquares(g.spec, sq, m, next);
+                        bool only;
+                        uint8_t reply = enPassantReply(g, epBoard, next, stm ^ 1, doublePusher(g.spec, sq, next), only);
+                        if (isWin(reply)) {
+                            epWins.push_back(std::make_pair((int)reply, std::make_pair((uint32_t)idx, (uint32_t)child)));
+                        } else if (only && reply != UNKNOWN && reply >= LOSS) {
+                            // Stalemate but for the capture, which loses: the child is never resolved as lost
+                            bestWin = bestWin ? std::min(bestWin, reply - LOSS + 1) : reply - LOSS + 1;
+                        }
+                    }
+                    continue;
+                }
+                GameState prevState = board.gameState;
+                board.makeMove(m);
+                uint8_t child;
+                bool found = probeValue(board, child);
+                board.undoMove(m, captured, prevState);
+                if (!found) {
+                    g.missingTable = true;
+                    continue;
+                }
+                if (child == DRAW) nonLosing = true;
+                else if (child >= LOSS) bestWin = bestWin ? std::min(bestWin, child - LOSS + 1) : child - LOSS + 1;
+                else longestLoss = std::max(longestLoss, child + 1);
+            }
+
+            g.value[idx].store(UNKNOWN, std::memory_order_relaxed);
+            g.movesLeft[idx].store((int16_t)inTable, std::memory_order_relaxed);
+            if (bestWin) {
+                g.exitLoss[idx] = NON_LOSING;
+                won.push_back(std::make_pair(bestWin, (uint32_t)idx));
+            } else if (nonLosing) {
+                g.exitLoss[idx] = NON_LOSING;
+                if (!inTable) g.value[idx].store(DRAW, std::memory_order_relaxed);
+            } else {
+                g.exitLoss[idx] = (uint8_t)longestLoss;
+                if (!inTable) {
+                    g.value[idx].store((uint8_t)(LOSS + longestLoss), std::memory_order_relaxed);
+                    lost.push_back(std::make_pair(longestLoss, (uint32_t)idx));
+                }
+            }
+        }
+        g.merge(g.level, lost);
+        g.merge(g.exitWin, won);
+        std::lock_guard<std::mutex> lock(g.mutex);
+        for (const std::pair<int, std::pair<uint32_t, uint32_t>>& e : epWins) g.epReplyWin[e.first].push_back(e.second);
+    }
+
+    // Distance to mate if every move from idx loses, else 0
+    static int verifyLoss(Generation& g, Board& board, Board& epBoard, size_t idx) {
+        int sq[MAX_PIECES], stm;
+        decode(g.spec, idx, sq, stm);
+        setupBoard(board, g.spec, sq, stm);
+        Board::MoveList moves;
+        board.generateLegalMoves((Color)stm, moves);
+
+        int longest = g.exitLoss[idx];
+        for (const Move& m : moves) {
+            if (board.getPiece(m.toX, m.toY).type != EMPTY || m.promotion != EMPTY) continue;
+            uint8_t v = g.value[quietChild(g.spec, sq, stm, m)].load(std::memory_order_relaxed);
+            if (g.enPassant && std::abs(m.toX - m.fromX) == 2 && board.getPiece(m.fromX, m.fromY).type == PAWN) {
+                int next[MAX_PIECES];
+                quietSquares(g.spec, sq, m, next);
+                bool only;
+                uint8_t reply = enPassantReply(g, epBoard, next, stm ^ 1, doublePusher(g.spec, sq, next), only);
+                if (reply != UNKNOWN) v = only ? reply : bestOutcome(v, reply);
+            }
+            if (v == DRAW || v >= LOSS) return 0;
+            longest = std::max(longest, v + 1);
+        }
+        return longest;
+    }
+
+    // Calls fn on every legal position from which the side that just moved reached sq with a
+    // quiet move (no capture, no promotion)
+    template <typename Fn>
+    static void forEachPredecessor(const TableSpec& spec, const int* sq, Color mover, Fn fn) {
+        Bitboard occupied = 0;
+        for (int i = 0; i < spec.count; i++) occupied |= setBit(sq[i]);
+        int prev[MAX_PIECES];
+        std::copy(sq, sq + spec.count, prev);
+        int theirKing = mover == WHITE ? sq[1] : sq[0];
+
+        for (int i = 0; i < spec.count; i++) {
+            if (spec.color[i] != mover) continue;
+            int s = sq[i];
+            Bitboard from = 0;
+            switch (spec.type[i]) {
+                case PAWN: {
+                    int back = mover == WHITE ? -8 : 8;
+                    int rank = mover == WHITE ? (s >> 3) : 7 - (s >> 3);
+                    if (rank >= 2 && !(occupied & setBit(s + back))) {
+                        from |= setBit(s + back);
+                        if (rank == 3 && !(occupied & setBit(s + 2 * back))) from |= setBit(s + 2 * back);
+                    }
+                    break;
+                }
+                case KNIGHT: from = Attacks::knightAttacks[s]; break;
+                case BISHOP: from = Attacks::getBishopAttacks(s, occupied); break;
+                case ROOK:   from = Attacks::getRookAttacks(s, occupied); break;
+                case QUEEN:  from = Attacks::getQueenAttacks(s, occupied); break;
+                case KING:   from = Attacks::kingAttacks[s]; break;
+                default: break;
+            }
+            for (from &= ~occupied; from; from &= from - 1) {
+                prev[i] = __builtin_ctzll(from);
+                if (!attacked(spec, prev, theirKing, mover)) fn(prev);
+            }
+            prev[i] = s;
+        }
+    }
+
+    // Resolves the positions decided at distance d: every predecessor of a loss wins at d + 1,
+    // and a predecessor of a win loses once all of its moves are known to lose. The move counter
+    // only decides when to check: a child with a symmetric image can be reached more than once.
+    static void retrograde(Generation& g, const std::vector<uint32_t>& current, int d, size_t begin, size_t end) {
+        Board board, epBoard;
+        std::vector<std::pair<int, uint32_t>> found, deferred;
+        int sq[MAX_PIECES], stm;
+
+        for (size_t i = begin; i < end; i++) {
+            uint32_t idx = current[i];
+            bool lost = g.value[idx].load(std::memory_order_relaxed) >= LOSS;
+            decode(g.spec, idx, sq, stm);
+            Color mover = stm == WHITE ? BLACK : WHITE;
+
+            forEachPredecessor(g.spec, sq, mover, [&](const int* prev) {
+                size_t p = encode(g.spec, prev, mover);
+                if (g.value[p].load(std::memory_order_relaxed) != UNKNOWN) return;
+                uint8_t reply = UNKNOWN;
+                bool only = false;
+                int pusher = g.enPassant ? doublePusher(g.spec, prev, sq) : -1;
+                if (pusher >= 0) reply = enPassantReply(g, epBoard, sq, stm, pusher, only);
+                if (lost) {
+                    // A double push only wins if taking en passant loses too, and no sooner than that
+                    int win = d + 1;
+                    if (reply != UNKNOWN) {
+                        uint8_t v = only ? reply : bestOutcome(g.value[idx].load(std::memory_order_relaxed), reply);
+                        if (v < LOSS) return;
+                        win = v - LOSS + 1;
+                    }
+                    if (win > d + 1) deferred.push_back(std::make_pair(win, (uint32_t)p));
+                    else if (g.resolve(p, (uint8_t)win)) found.push_back(std::make_pair(win, (uint32_t)p));
+                } else if (isWin(reply) && reply < d) {
+                    return; // Counted as lost when the en passant win's level came up
+                } else if (g.exitLoss[p] != NON_LOSING && g.movesLeft[p].fetch_sub(1, std::memory_order_relaxed) <= 1) {
+                    int loss = verifyLoss(g, board, epBoard, p);
+                    if (loss > 0 && g.resolve(p, (uint8_t)(LOSS + loss))) found.push_back(std::make_pair(loss, (uint32_t)p));
+                }
+            });
+        }
+        g.merge(g.level, found);
+        g.merge(g.exitWin, deferred);
+    }
+
+    // Counts a double push as lost for the positions whose opponent wins at distance d by taking
+    // en passant, unless the child itself was resolved as a win by then and already counted
+    static void enPassantLosses(Generation& g, int d) {
+        Board board, epBoard;
+        for (const std::pair<uint32_t, uint32_t>& e : g.epReplyWin[d]) {
+            uint32_t p = e.first;
+            uint8_t child = g.value[e.second].load(std::memory_order_relaxed);
+            if (isWin(child) && child <= d) continue;
+            if (g.value[p].load(std::memory_order_relaxed) != UNKNOWN || g.exitLoss[p] == NON_LOSING) continue;
+            if (g.movesLeft[p].fetch_sub(1, std::memory_order_relaxed) <= 1) {
+                int loss = verifyLoss(g, board, epBoard, p);
+                if (loss > 0 && g.resolve(p, (uint8_t)(LOSS + loss))) g.level[loss].push_back(p);
+            }
+        }
+    }
+
+    static bool buildTable(const TableSpec& spec, int threads, std::vector<uint8_t>& result, int& longestMate) {
+        Generation g(spec);
+        parallelFor(threads, spec.size, [&](size_t begin, size_t end) { initPositions(g, begin, end); });
+        if (g.missingTable) {
+            std::cerr << "gentb: " << spec.name << " needs a table that is not loaded" << std::endl;
+            return false;
+        }
+
+        longestMate = 0;
+        for (int d = 0; d <= MAX_DTM; d++) {
+            std::vector<uint32_t>& current = g.level[d];
+            for (uint32_t idx : g.exitWin[d]) {
+                if (g.resolve(idx, (uint8_t)d)) current.push_back(idx);
+            }
+            enPassantLosses(g, d);
+            if (current.empty()) continue;
+            if (d == MAX_DTM) {
+                std::cerr << "gentb: " << spec.name << " exceeds the longest storable mate" << std::endl;
+                return false;
+            }
+            longestMate = d;
+            parallelFor(threads, current.size(), [&](size_t begin, size_t end) { retrograde(g, current, d, begin, end); });
+            std::vector<uint32_t>().swap(current);
+        }
+
+        result.resize(spec.size);
+        for (size_t idx = 0; idx < spec.size; idx++) {
+            uint8_t v = g.value[idx].load(std::memory_order_relaxed);
+            result[idx] = v == UNKNOWN ? DRAW : v; // Whatever cannot be forced either way is a draw
+        }
+        return true;
+    }
+
+    static bool writeTable(const std::string& path, const std::vector<uint8_t>& data) {
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        uint32_t header[HEADER_SIZE / 4] = {MAGIC, VERSION, (uint32_t)data.size(), 0};
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+        return (bool)out;
+    }
+
+    static void addWithDependencies(const std::string& name, bool requested, std::set<std::string>& wanted) {
+        if (wanted.count(name) || (!requested && isLoaded(name))) return;
+        wanted.insert(name);
+        TableSpec spec;
+        makeSpec(name, spec);
+        for (const std::string& dep : dependencies(spec)) addWithDependencies(dep, false, wanted);
+    }
+
+    bool generate(const std::string& dir, int threads, const std::vector<std::string>& names) {
+#ifdef _WIN32
+        _mkdir(dir.c_str());
+#else
+        mkdir(dir.c_str(), 0755);
+#endif
+        load(dir);
+
+        std::vector<std::string> order = allTables();
+        std::set<std::string> wanted;
+        for (const std::string& name : names.empty() ? order : names) {
+            if (std::find(order.begin(), order.end(), name) == order.end()) {
+                std::cerr << "gentb: unknown table " << name << " (expected e.g. KRvKP)" << std::endl;
+                return false;
+            }
+            addWithDependencies(name, true, wanted);
+        }
+
+        for (const std::string& name : order) {
+            if (!wanted.count(name)) continue;
+            TableSpec spec;
+            makeSpec(name, spec);
+            removeTable(name); // Never rewrite a file that is still mapped
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<uint8_t> data;
+            int longestMate = 0;
+            if (!buildTable(spec, threads, data, longestMate)) return false;
+            std::string path = tablePath(dir, name);
+            if (!writeTable(path, data) || !addTable(path, spec)) {
+                std::cerr << "gentb: cannot write " << path << std::endl;
+                return false;
+            }
+            long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+            long long wins = 0, losses = 0, draws = 0;
+            for (uint8_t v : data) {
+                if (v == INVALID) continue;
+                if (v == DRAW) draws++;
+                else if (v < LOSS) wins++;
+                else losses++;
+            }
+            std::cout << std::left << std::setw(8) << name
+                      << " positions " << (wins + losses + draws)
+                      << " wins " << wins << " draws " << draws << " losses " << losses
+                      << " longest mate " << longestMate << " plies"
+                      << " time " << ms << " ms" << std::endl;
+        }
+        return true;
+    }
+}
+
+void runGenTB(int argc, char* argv[]) {
+    std::string dir = "tb";
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> names;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-threads" && i + 1 < argc) threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg.find('v') != std::string::npos && arg[0] == 'K') names.push_back(arg);
+        else dir = arg;
+    }
+
+    std::cout << "Generating " << (names.empty() ? "all 3-4 piece" : "the requested") << " tablebases into "
+              << dir << " with " << threads << " threads" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    bool ok = Tablebases::generate(dir, threads, names);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << (ok ? "Done" : "Failed") << " in " << seconds << " s" << std::endl;
+}
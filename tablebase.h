@@ -0,0 +1,44 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include "piece.h"
+#include <string>
+#include <vector>
+
+class Board;
+
+// Distance-to-mate tablebases for every material combination of up to four pieces, built
+// offline by retrograde analysis (`./chess gentb`) and memory-mapped at runtime. A table holds
+// one byte per position from the side to move's point of view: DRAW, a win in 1..LOSS-1 plies,
+// or LOSS + n for being mated in n plies. Positions with en passant or castling rights are not
+// covered, but a double push is scored with the opponent's en passant reply.
+namespace Tablebases {
+    const int MAX_PIECES = 4;
+    const uint8_t DRAW = 0;
+    const uint8_t LOSS = 128;
+    const uint8_t INVALID = 255;
+
+    // Set false to search endgames without probing, e.g. to compare node counts
+    extern bool enabled;
+
+    // Names ("KRvKP") of all 3-4 piece tables, in an order where every table's captures and
+    // promotions lead only to tables listed before it
+    std::vector<std::string> allTables();
+
+    // Generates the named tables (all of them when empty) into dir, along with any table they
+    // depend on that dir does not already hold. Returns false if a table could not be written.
+    bool generate(const std::string& dir, int threads, const std::vector<std::string>& names);
+
+    // Maps every table present in dir, replacing the previous set; returns the number found
+    int load(const std::string& dir);
+    int loadedCount();
+
+    // Exact result of the position, as a mate score relative to ply (0 for a draw) from the
+    // side to move's point of view. Returns false when no loaded table covers it.
+    bool probe(const Board& board, int ply, int& score);
+}
+
+// Usage: ./chess gentb [dir] [-threads N] [table ...]
+void runGenTB(int argc, char* argv[]);
+
+#endif // TABLEBASE_H
@@ -0,0 +1,215 @@
+#include "board.h"
+#include "chess_ai.h"
+#include "bitbase.h"
+#include "endgame.h"
+#include "zobrist.h"
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+
+struct KPKCase {
+    const char* fen;
+    bool win; // Verdict for the side with the pawn
+};
+
+// Theoretical verdicts, covering both colours, both sides to move and mirrored files
+static const KPKCase KPK_CASES[] = {
+    {"4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", true},   // King on the sixth in front of the pawn
+    {"4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", true},
+    {"4k3/8/4P3/4K3/8/8/8/8 w - - 0 1", false},  // King behind the pawn on the sixth: stalemate
+    {"4k3/8/4P3/4K3/8/8/8/8 b - - 0 1", false},
+    {"k7/8/8/8/8/8/P7/K7 w - - 0 1", false},     // Rook pawn, defending king in the corner
+    {"8/8/8/8/8/8/3kP3/7K b - - 0 1", false},    // The pawn falls
+    {"8/8/8/8/8/k7/6P1/K7 w - - 0 1", true},     // Outside the square
+    {"8/8/8/8/4p3/4k3/8/4K3 b - - 0 1", true},   // Black pawn, mirrored opposition win
+    {"8/8/8/8/4k3/4p3/4K3/8 w - - 0 1", false},  // Black pawn, king behind it: the defender holds
+    {"8/8/8/3k4/8/8/3P4/3K4 w - - 0 1", false},  // Defending king in front of the pawn
+};
+
+// Material key rebuilt from the piece bitboards, independently of the incremental pieceCount
+static unsigned long long recomputedMaterialKey(const Board& board) {
+    unsigned long long key = 0;
+    for (int c = WHITE; c <= BLACK; c++) {
+        for (int t = PAWN; t <= QUEEN; t++) {
+            int n = std::min(__builtin_popcountll(board.pieces[t] & board.colors[c]), Zobrist::MAX_PIECE_COUNT);
+            for (int i = 0; i < n; i++) key ^= Zobrist::materialKeys[c][t][i];
+        }
+    }
+    return key;
+}
+
+// Root score from the side to move's point of view
+static int searchScore(ChessAI& ai, const char* fen, int depth) {
+    Board board;
+    Color turn = board.loadFEN(fen);
+    ai.tt.clear();
+    ai.getBestMove(board, turn, depth);
+    return ai.lastScore;
+}
+
+void run_kpk_tests() {
+    std::cout << "--- Starting KPK Bitbase Tests ---" << std::endl;
+    Bitbases::init();
+
+    // 1. Bitbase verdicts against theory, through Board::evaluate
+    std::cout << "Test 1 [Known Verdicts]: ";
+    for (const KPKCase& c : KPK_CASES) {
+        Board board;
+        board.loadFEN(c.fen);
+        int eval = board.evaluate();
+        bool win = std::abs(eval) > Endgame::KNOWN_WIN;
+        if (win != c.win || (!c.win && eval != 0)) {
+            std::cout << "FAIL (" << c.fen << " eval " << eval << ")" << std::endl;
+            assert(false);
+        }
+    }
+    std::cout << "PASS" << std::endl;
+
+    // 2. Verdicts against search without the bitbase: a win must let search find the
+    // promotion, a draw must never show a promotion score
+    ChessAI ai;
+    ai.timeLimitMs = 100000;
+    Bitbases::enabled = false;
+    std::cout << "Test 2 [Search Agreement]: ";
+    for (const KPKCase& c : KPK_CASES) {
+        int score = searchScore(ai, c.fen, 16);
+        Board board;
+        Color turn = board.loadFEN(c.fen);
+        bool moverHasPawn = (board.pieces[PAWN] & board.colors[turn]) != 0;
+        bool searchWin = moverHasPawn ? score >= 500 : score <= -500;
+        if (searchWin != c.win) {
+            std::cout << "FAIL (" << c.fen << " search score " << score << ")" << std::endl;
+            assert(false);
+        }
+    }
+    Bitbases::enabled = true;
+    std::cout << "PASS" << std::endl;
+
+    // 3. Generation time
+    auto start = std::chrono::high_resolution_clock::now();
+    int wins = Bitbases::generate();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << "Test 3 [Generation]: " << wins << " wins in " << ms << " ms: ";
+    if (wins > 0 && wins < Bitbases::KPK_SIZE) {
+        std::cout << "PASS" << std::endl;
+    } else {
+        std::cout << "FAIL" << std::endl;
+        assert(false);
+    }
+
+    // 4. Bare kings have material key 0, which must not match an empty material hash slot
+    std::cout << "Test 4 [Bare Kings]: ";
+    Board bare;
+    bare.loadFEN("8/8/8/3k4/8/8/8/3K4 w - - 0 1");
+    bool bareDraw = bare.isInsufficientMaterial() && bare.isDraw() && bare.evaluate() == 0;
+    Board capture;
+    capture.loadFEN("8/8/8/8/8/3k4/3n4/3K4 w - - 0 1");
+    capture.makeMove(Move(0, 3, 1, 3)); // Kxd2
+    if (!bareDraw || !capture.isInsufficientMaterial() || !capture.isDraw()) {
+        std::cout << "FAIL" << std::endl;
+        assert(false);
+    }
+    std::cout << "PASS" << std::endl;
+
+    // 5. Wrong-colour bishop: a rook pawn whose promotion square the bishop cannot cover, with
+    // the defending king next to it, is a dead draw; the right bishop keeps the win
+    std::cout << "Test 5 [Wrong Bishop]: ";
+    Board wrong, right;
+    wrong.loadFEN("1k6/8/8/P7/8/8/8/2B1K3 w - - 0 1");   // Dark bishop, a8 is light
+    right.loadFEN("1k6/8/8/P7/8/8/8/4KB2 w - - 0 1");    // Light bishop
+    int wrongScale = Endgame::scaleFactor(wrong, wrong.materialEntry(), WHITE);
+    int rightScale = Endgame::scaleFactor(right, right.materialEntry(), WHITE);
+    int wrongEval = wrong.evaluate(), rightEval = right.evaluate();
+    if (wrongScale != 0 || rightScale != Endgame::SCALE_NORMAL || std::abs(wrongEval) > 25 || rightEval < 200) {
+        std::cout << "FAIL (scales " << wrongScale << "/" << rightScale << ", evals " << wrongEval << "/" << rightEval << ")" << std::endl;
+        assert(false);
+    }
+    std::cout << "PASS" << std::endl;
+
+    // 6. Opposite-coloured bishops: an extra passed pawn counts for much less than with
+    // same-coloured ones
+    std::cout << "Test 6 [Opposite Bishops]: ";
+    Board opposite, same;
+    opposite.loadFEN("2b3k1/5ppp/8/8/8/8/P4PPP/2B3K1 w - - 0 1");
+    same.loadFEN("5bk1/5ppp/8/8/8/8/P4PPP/2B3K1 w - - 0 1");
+    int oppositeScale = Endgame::scaleFactor(opposite, opposite.materialEntry(), WHITE);
+    int sameScale = Endgame::scaleFactor(same, same.materialEntry(), WHITE);
+    int oppositeEval = opposite.evaluate(), sameEval = same.evaluate();
+    if (oppositeScale >= Endgame::SCALE_NORMAL / 2 || sameScale != Endgame::SCALE_NORMAL
+        || oppositeEval <= 0 || oppositeEval * 2 > sameEval) {
+        std::cout << "FAIL (scales " << oppositeScale << "/" << sameScale << ", evals " << oppositeEval << "/" << sameEval << ")" << std::endl;
+        assert(false);
+    }
+    std::cout << "PASS" << std::endl;
+
+    // 7. KBNK: the defending king scores worse in a corner of the bishop's colour than in the
+    // other pair, for either colour of bishop and either strong side
+    std::cout << "Test 7 [KBNK Corner]: ";
+    const char* KBNK_PAIRS[][2] = {
+        {"k7/8/2K5/8/8/8/8/4NB2 w - - 0 1", "7k/8/5K2/8/8/8/8/4NB2 w - - 0 1"},     // Light bishop: a8 over h8
+        {"7k/8/5K2/8/8/8/8/2BN4 w - - 0 1", "k7/8/2K5/8/8/8/8/2BN4 w - - 0 1"},     // Dark bishop: h8 over a8
+        {"4nb2/8/8/8/8/2k5/8/K7 b - - 0 1", "4nb2/8/8/8/8/5k2/8/7K b - - 0 1"},     // Black, dark bishop: a1 over h1
+    };
+    for (const auto& pair : KBNK_PAIRS) {
+        Board good, bad;
+        good.loadFEN(pair[0]);
+        bad.loadFEN(pair[1]);
+        Color strong = (good.pieces[BISHOP] & good.colors[WHITE]) ? WHITE : BLACK;
+        int goodEval = strong == WHITE ? good.evaluate() : -good.evaluate();
+        int badEval = strong == WHITE ? bad.evaluate() : -bad.evaluate();
+        if (goodEval <= Endgame::KNOWN_WIN || badEval <= Endgame::KNOWN_WIN || goodEval <= badEval) {
+            std::cout << "FAIL (" << pair[0] << " " << goodEval << " vs " << badEval << ")" << std::endl;
+            assert(false);
+        }
+    }
+    std::cout << "PASS" << std::endl;
+
+    // 8. Random playouts through captures, promotions, en passant and castling: the incremental
+    // material key always matches one rebuilt from the bitboards, and undo restores it
+    std::cout << "Test 8 [Material Key]: ";
+    const char* PLAYOUT_FENS[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/PPP4k/8/8/8/8/4Kppp/8 w - - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    };
+    std::mt19937 rng(37);
+    long long playoutMoves = 0;
+    for (const char* fen : PLAYOUT_FENS) {
+        for (int game = 0; game < 50; game++) {
+            Board board;
+            Color turn = board.loadFEN(fen);
+            for (int ply = 0; ply < 200; ply++) {
+                Board::MoveList moves;
+                board.generateLegalMoves(turn, moves);
+                if (moves.empty()) break;
+                const Move& m = moves[rng() % moves.size()];
+                unsigned long long before = board.gameState.materialKey;
+                GameState prevState = board.gameState;
+                Piece captured = board.getPiece(m.toX, m.toY);
+                board.makeMove(m);
+                bool ok = board.gameState.materialKey == recomputedMaterialKey(board);
+                board.undoMove(m, captured, prevState);
+                ok = ok && board.gameState.materialKey == before && before == recomputedMaterialKey(board);
+                if (!ok) {
+                    std::cout << "FAIL (" << fen << " game " << game << " ply " << ply << ")" << std::endl;
+                    assert(false);
+                }
+                board.makeMove(m);
+                turn = turn == WHITE ? BLACK : WHITE;
+                playoutMoves++;
+            }
+        }
+    }
+    std::cout << playoutMoves << " moves: PASS" << std::endl;
+
+    std::cout << "--- All KPK Bitbase Tests Passed ---" << std::endl;
+}
+
+int main() {
+    run_kpk_tests();
+    return 0;
+}
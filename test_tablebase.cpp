@@ -0,0 +1,204 @@
+#include "board.h"
+#include "chess_ai.h"
+#include "bitbase.h"
+#include "tablebase.h"
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+
+static const char* TB_DIR = "tb_test";
+static const char* TB_EP_DIR = "tb_test_kpkp"; // KPvKP pulls in most 4-piece tables; kept apart from the KPK set
+
+static std::string fenFor(int whiteKing, int whitePawn, int blackKing, Color stm, int blackPawn = -1) {
+    char grid[64] = {};
+    grid[whiteKing] = 'K';
+    grid[whitePawn] = 'P';
+    grid[blackKing] = 'k';
+    if (blackPawn >= 0) grid[blackPawn] = 'p';
+    std::string fen;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            char c = grid[rank * 8 + file];
+            if (!c) { empty++; continue; }
+            if (empty) fen += (char)('0' + empty);
+            empty = 0;
+            fen += c;
+        }
+        if (empty) fen += (char)('0' + empty);
+        if (rank) fen += '/';
+    }
+    return fen + (stm == WHITE ? " w - - 0 1" : " b - - 0 1");
+}
+
+// Exact score relative to ply: the table where it covers the position, otherwise (en passant
+// rights) the best move by the same rule
+static int exactScore(Board& board, int ply) {
+    int score;
+    if (Tablebases::probe(board, ply, score)) return score;
+    Color us = board.gameState.sideToMove;
+    Board::MoveList moves;
+    board.generateLegalMoves(us, moves);
+    if (moves.empty()) return board.isInCheck(us) ? -10000 + ply : 0;
+    int best = -10001;
+    for (int i = 0; i < moves.size(); i++) {
+        GameState prevState = board.gameState;
+        Piece captured = board.getPiece(moves[i].toX, moves[i].toY);
+        board.makeMove(moves[i]);
+        best = std::max(best, -exactScore(board, ply + 1));
+        board.undoMove(moves[i], captured, prevState);
+    }
+    return best;
+}
+
+void run_tablebase_tests() {
+    std::cout << "--- Starting Tablebase Tests ---" << std::endl;
+    Bitbases::init();
+
+    // 1. Generation of the KPK table and everything it promotes into
+    std::cout << "Test 1 [Generation]: ";
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::string> names(1, "KPvK");
+    bool generated = Tablebases::generate(TB_DIR, 2, names);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    if (!generated || Tablebases::load(TB_DIR) != 5) {
+        std::cout << "FAIL" << std::endl;
+        assert(false);
+    }
+    std::cout << "5 tables in " << ms << " ms: PASS" << std::endl;
+
+    // 2. Known distances to mate, for both colours
+    std::cout << "Test 2 [Mate Distances]: ";
+    struct MateCase { const char* fen; int score; };
+    const MateCase cases[] = {
+        {"k7/8/1K6/8/8/8/7Q/8 w - - 0 1", 10000 - 1},  // Qh8#
+        {"8/7q/8/8/8/1k6/8/K7 b - - 0 1", 10000 - 1},  // Mirrored with Black to move
+        {"K7/8/1k6/8/8/8/8/7q w - - 0 1", -10000 + 2}, // In check: Kb8 is forced, then Qb7#
+        {"8/8/8/8/8/8/8/kbK5 w - - 0 1", 0},            // Lone bishop
+    };
+    for (const MateCase& c : cases) {
+        Board board;
+        board.loadFEN(c.fen);
+        int score = 12345;
+        if (!Tablebases::probe(board, 0, score) || score != c.score) {
+            std::cout << "FAIL (" << c.fen << " score " << score << ")" << std::endl;
+            assert(false);
+        }
+    }
+    std::cout << "PASS" << std::endl;
+
+    // 3. Every KPK position against the bitbase verdict
+    std::cout << "Test 3 [KPK Agreement]: ";
+    int checked = 0;
+    for (int wk = 0; wk < 64; wk++) {
+        for (int bk = 0; bk < 64; bk++) {
+            for (int p = 8; p < 56; p++) {
+                if (wk == bk || wk == p || bk == p || (Attacks::kingAttacks[wk] & setBit(bk))) continue;
+                for (int stm = WHITE; stm <= BLACK; stm++) {
+                    if (stm == WHITE && (Attacks::pawnAttacks[WHITE][p] & setBit(bk))) continue;
+                    Board board;
+                    board.loadFEN(fenFor(wk, p, bk, (Color)stm));
+                    int score;
+                    if (!Tablebases::probe(board, 0, score)) {
+                        std::cout << "FAIL (not covered: " << fenFor(wk, p, bk, (Color)stm) << ")" << std::endl;
+                        assert(false);
+                    }
+                    int mirror = (p & 7) >= 4 ? 7 : 0;
+                    bool bitbaseWin = Bitbases::probeKPK(wk ^ mirror, p ^ mirror, bk ^ mirror, (Color)stm);
+                    bool tableWin = stm == WHITE ? score > 0 : score < 0;
+                    if (bitbaseWin != tableWin) {
+                        std::cout << "FAIL (" << fenFor(wk, p, bk, (Color)stm) << " score " << score << ")" << std::endl;
+                        assert(false);
+                    }
+                    checked++;
+                }
+            }
+        }
+    }
+    std::cout << checked << " positions: PASS" << std::endl;
+
+    // 4. Search plays the table at the root and probes it below
+    std::cout << "Test 4 [Search]: ";
+    ChessAI ai;
+    ai.timeLimitMs = 100000;
+    Board board;
+    Color turn = board.loadFEN("8/8/8/4k3/8/8/8/R3K3 w - - 0 1");
+    Move move = ai.getBestMove(board, turn, 6);
+    if (ai.lastScore < 10000 - 31 || ai.stats.tbHits == 0 || (move.fromX == move.toX && move.fromY == move.toY)) {
+        std::cout << "FAIL (KRK root score " << ai.lastScore << ")" << std::endl;
+        assert(false);
+    }
+    turn = board.loadFEN("8/8/3k4/8/8/3n4/8/K2R4 w - - 0 1"); // KRKN is not loaded; RxN reaches KRK
+    ai.tt.clear();
+    ai.getBestMove(board, turn, 4);
+    if (ai.stats.tbHits == 0 || ai.lastScore < 10000 - MAX_PLY) {
+        std::cout << "FAIL (KRKN score " << ai.lastScore << ", tbhits " << ai.stats.tbHits << ")" << std::endl;
+        assert(false);
+    }
+    std::cout << "PASS" << std::endl;
+
+    // 5. KPvKP: the entry before a double push must count the en passant reply. After a2-a4 the
+    // b4 pawn takes en passant and the ending is drawn, although a4 without the reply would win.
+    // Every position where a double push can be taken must agree with its moves one ply on.
+    std::cout << "Test 5 [En Passant]: ";
+    start = std::chrono::high_resolution_clock::now();
+    std::vector<std::string> kpkp(1, "KPvKP");
+    int threads = std::max(2, (int)std::thread::hardware_concurrency());
+    if (!Tablebases::generate(TB_EP_DIR, threads, kpkp)) {
+        std::cout << "FAIL (generation)" << std::endl;
+        assert(false);
+    }
+    Board epBoard;
+    epBoard.loadFEN("6k1/8/8/8/1p6/8/P7/K7 w - - 0 1");
+    int epScore = 12345;
+    if (!Tablebases::probe(epBoard, 0, epScore) || epScore != 0) {
+        std::cout << "FAIL (a2-a4 bxa3 draw scored " << epScore << ")" << std::endl;
+        assert(false);
+    }
+    int epChecked = 0;
+    for (int wp = 8; wp < 56; wp++) {
+        for (int bp = 8; bp < 56; bp++) {
+            bool whitePush = (wp >> 3) == 1 && (bp >> 3) == 3;
+            bool blackPush = (bp >> 3) == 6 && (wp >> 3) == 4;
+            if ((!whitePush && !blackPush) || std::abs((wp & 7) - (bp & 7)) != 1) continue;
+            for (int wk = 0; wk < 64; wk++) {
+                for (int bk = 0; bk < 64; bk++) {
+                    if (wk == bk || wk == wp || wk == bp || bk == wp || bk == bp || (Attacks::kingAttacks[wk] & setBit(bk))) continue;
+                    Color stm = whitePush ? WHITE : BLACK;
+                    Board position;
+                    position.loadFEN(fenFor(wk, wp, bk, stm, bp));
+                    int score;
+                    if (position.isInCheck(stm == WHITE ? BLACK : WHITE) || !Tablebases::probe(position, 0, score)) continue;
+                    Board::MoveList moves;
+                    position.generateLegalMoves(stm, moves);
+                    int best = moves.empty() ? (position.isInCheck(stm) ? -10000 : 0) : -10001;
+                    for (int i = 0; i < moves.size(); i++) {
+                        GameState prevState = position.gameState;
+                        Piece captured = position.getPiece(moves[i].toX, moves[i].toY);
+                        position.makeMove(moves[i]);
+                        best = std::max(best, -exactScore(position, 1));
+                        position.undoMove(moves[i], captured, prevState);
+                    }
+                    if (best != score) {
+                        std::cout << "FAIL (" << fenFor(wk, wp, bk, stm, bp) << " table " << score << ", moves " << best << ")" << std::endl;
+                        assert(false);
+                    }
+                    epChecked++;
+                }
+            }
+        }
+    }
+    ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << epChecked << " positions in " << ms << " ms: PASS" << std::endl;
+
+    std::cout << "--- All Tablebase Tests Passed ---" << std::endl;
+}
+
+int main() {
+    run_tablebase_tests();
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "board.h"
+#include "uci.h"
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <vector>
+
+static const char* FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+};
+
+static bool sameMove(const Move& a, const Move& b) {
+    return a.fromX == b.fromX && a.fromY == b.fromY && a.toX == b.toX && a.toY == b.toY
+        && a.promotion == b.promotion && a.isEnPassant == b.isEnPassant && a.isCastle == b.isCastle;
+}
+
+// Every square pair and promotion suffix must parse exactly when a legal move matches it
+static int checkAllStrings(Board& board, Color turn) {
+    Board::MoveList legal;
+    board.generateLegalMoves(turn, legal);
+    std::vector<std::string> names;
+    for (int i = 0; i < legal.size(); i++) names.push_back(UCI::moveToString(legal[i]));
+    const char* suffixes[] = {"", "q", "r", "b", "n"};
+    int accepted = 0;
+    for (int from = 0; from < 64; from++) {
+        for (int to = 0; to < 64; to++) {
+            for (const char* suffix : suffixes) {
+                std::string str;
+                str += (char)('a' + from % 8);
+                str += (char)('1' + from / 8);
+                str += (char)('a' + to % 8);
+                str += (char)('1' + to / 8);
+                str += suffix;
+                Move parsed = UCI::parseMove(board, turn, str);
+                bool valid = !(parsed.fromX == 0 && parsed.fromY == 0 && parsed.toX == 0 && parsed.toY == 0);
+                bool found = false;
+                for (int i = 0; i < legal.size(); i++) {
+                    if (names[i] != str) continue;
+                    found = true;
+                    if (!valid || !sameMove(parsed, legal[i])) return -1;
+                }
+                if (valid != found) return -1;
+                accepted += valid;
+            }
+        }
+    }
+    return accepted == legal.size() ? accepted : -1;
+}
+
+// Walks the tree to depth, checking every node; returns the number of moves accepted
+static long long walk(Board& board, Color turn, int depth) {
+    int accepted = checkAllStrings(board, turn);
+    if (accepted < 0) return -1;
+    long long total = accepted;
+    if (depth == 0) return total;
+    Board::MoveList legal;
+    board.generateLegalMoves(turn, legal);
+    for (int i = 0; i < legal.size(); i++) {
+        GameState prevState = board.gameState;
+        Piece captured = board.getPiece(legal[i].toX, legal[i].toY);
+        board.makeMove(legal[i]);
+        long long sub = walk(board, turn == WHITE ? BLACK : WHITE, depth - 1);
+        board.undoMove(legal[i], captured, prevState);
+        if (sub < 0) return -1;
+        total += sub;
+    }
+    return total;
+}
+
+void run_uci_tests() {
+    std::cout << "--- Starting UCI Robustness Tests ---" << std::endl;
+
+    // 1. Move parsing against the legal move list, on every reachable position to depth 1
+    std::cout << "Test 1 [Move Parsing]: ";
+    long long checked = 0;
+    for (const char* fen : FENS) {
+        Board board;
+        Color turn = board.loadFEN(fen);
+        long long n = walk(board, turn, 1);
+        if (n < 0) {
+            std::cout << "FAIL (" << fen << ")" << std::endl;
+            assert(false);
+        }
+        checked += n;
+    }
+    std::cout << checked << " moves: PASS" << std::endl;
+
+    // 2. Malformed input is rejected without touching the board
+    std::cout << "Test 2 [Malformed Moves]: ";
+    const char* bad[] = {"", "e2", "e2e", "e2e4x", "e2e4qq", "i2i4", "e0e1", "e2e9", "E2E4", "e7e8k", "0000"};
+    Board board;
+    board.setupBoard();
+    unsigned long long key = board.gameState.zobristKey;
+    for (const char* str : bad) {
+        Move m = UCI::parseMove(board, WHITE, str);
+        if (!(m.fromX == 0 && m.fromY == 0 && m.toX == 0 && m.toY == 0) || board.gameState.zobristKey != key) {
+            std::cout << "FAIL (accepted \"" << str << "\")" << std::endl;
+            assert(false);
+        }
+    }
+    std::cout << "PASS" << std::endl;
+
+    std::cout << "--- All UCI Robustness Tests Passed ---" << std::endl;
+}
+
+int main() {
+    run_uci_tests();
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include "uci.h"
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+typedef std::chrono::steady_clock Clock;
+
+// Blocking input buffer standing in for stdin: lines are fed by the test thread
+class InputPipe : public std::streambuf {
+public:
+    void send(const std::string& line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        data += line + "\n";
+        cv.notify_one();
+    }
+
+protected:
+    int_type underflow() override {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this]() { return !data.empty(); });
+        current = data;
+        data.clear();
+        setg(&current[0], &current[0], &current[0] + current.size());
+        return traits_type::to_int_type(current[0]);
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string data, current;
+};
+
+// Collects the engine's complete output lines (stdout and stderr) with their arrival time
+class OutputLog {
+public:
+    struct Line { std::string text; Clock::time_point time; };
+
+    void append(std::string& partial, char c) {
+        if (c != '\n') { partial += c; return; }
+        std::lock_guard<std::mutex> lock(mutex);
+        lines.push_back(Line{partial, Clock::now()});
+        partial.clear();
+        cv.notify_all();
+    }
+
+    // First line from index `from` on that starts with prefix; false on timeout
+    bool waitFor(const std::string& prefix, size_t& from, Line& found, int timeoutMs) {
+        std::unique_lock<std::mutex> lock(mutex);
+        Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (true) {
+            for (; from < lines.size(); from++) {
+                if (lines[from].text.compare(0, prefix.size(), prefix) == 0) {
+                    found = lines[from++];
+                    return true;
+                }
+            }
+            if (cv.wait_until(lock, deadline) == std::cv_status::timeout) return false;
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<Line> lines;
+};
+
+class LogBuf : public std::streambuf {
+public:
+    explicit LogBuf(OutputLog& log) : log(log) {}
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) log.append(partial, traits_type::to_char_type(c));
+        return c;
+    }
+
+private:
+    OutputLog& log;
+    std::string partial;
+};
+
+static double percentile(std::vector<double> v, double p) {
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+static double msBetween(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+void run_uci_latency_tests() {
+    std::cout << "--- Starting UCI Latency Tests ---" << std::endl;
+
+    InputPipe input;
+    OutputLog log;
+    LogBuf outBuf(log), errBuf(log);
+    std::streambuf* oldIn = std::cin.rdbuf(&input);
+    std::streambuf* oldOut = std::cout.rdbuf(&outBuf);
+    std::streambuf* oldErr = std::cerr.rdbuf(&errBuf);
+    std::thread engine(UCI::loop);
+
+    size_t cursor = 0;
+    OutputLog::Line line;
+    input.send("uci");
+    bool ready = log.waitFor("uciok", cursor, line, 5000);
+
+    const int ROUNDS = 20;
+    const int TIMEOUT_MS = 2000;
+    std::vector<double> goLatency, stopLatency;
+    std::string failure;
+    for (int i = 0; ready && i < ROUNDS && failure.empty(); i++) {
+        input.send(i % 2 ? "position startpos moves e2e4 e7e5 g1f3"
+                         : "position fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+        Clock::time_point sent = Clock::now();
+        input.send("go infinite");
+        if (!log.waitFor("info", cursor, line, TIMEOUT_MS)) { failure = "no info after go"; break; }
+        goLatency.push_back(msBetween(sent, line.time));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        sent = Clock::now();
+        input.send("stop");
+        if (!log.waitFor("bestmove", cursor, line, TIMEOUT_MS)) { failure = "no bestmove after stop"; break; }
+        stopLatency.push_back(msBetween(sent, line.time));
+        if (line.text.size() < 13) failure = "malformed " + line.text;
+    }
+
+    // A search that is stopped before it has started must still answer
+    input.send("position startpos");
+    input.send("go infinite");
+    input.send("stop");
+    if (failure.empty() && !log.waitFor("bestmove", cursor, line, TIMEOUT_MS)) failure = "stop right after go hung";
+
+    // Overshoot of bestmove past the movetime deadline
+    const int MOVETIMES[] = {10, 50, 100};
+    const int TIMED_ROUNDS = 10;
+    std::vector<double> overshoot[3];
+    for (int t = 0; t < 3 && failure.empty(); t++) {
+        for (int i = 0; i < TIMED_ROUNDS; i++) {
+            input.send(i % 2 ? "position startpos"
+                             : "position fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+            Clock::time_point sent = Clock::now();
+            input.send("go movetime " + std::to_string(MOVETIMES[t]));
+            if (!log.waitFor("bestmove", cursor, line, MOVETIMES[t] + TIMEOUT_MS)) {
+                failure = "no bestmove at movetime " + std::to_string(MOVETIMES[t]);
+                break;
+            }
+            overshoot[t].push_back(msBetween(sent, line.time) - MOVETIMES[t]);
+        }
+    }
+
+    // A deep perft runs on the search worker: isready is answered meanwhile and stop ends it
+    double perftReadyMs = -1, perftStopMs = -1;
+    if (failure.empty()) {
+        input.send("position startpos");
+        input.send("go perft 10");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        Clock::time_point sent = Clock::now();
+        input.send("isready");
+        if (log.waitFor("readyok", cursor, line, TIMEOUT_MS)) perftReadyMs = msBetween(sent, line.time);
+        sent = Clock::now();
+        input.send("stop");
+        if (log.waitFor("info string perft stopped", cursor, line, TIMEOUT_MS)) perftStopMs = msBetween(sent, line.time);
+    }
+
+    input.send("quit");
+    engine.join();
+    std::cin.rdbuf(oldIn);
+    std::cout.rdbuf(oldOut);
+    std::cerr.rdbuf(oldErr);
+
+    std::cout << "Test 1 [Handshake]: ";
+    if (!ready) {
+        std::cout << "FAIL (no uciok)" << std::endl;
+        assert(false);
+    }
+    std::cout << "PASS" << std::endl;
+
+    std::cout << "Test 2 [Go/Stop Rounds]: ";
+    if (!failure.empty()) {
+        std::cout << "FAIL (" << failure << ")" << std::endl;
+        assert(false);
+    }
+    std::cout << ROUNDS << " rounds: PASS" << std::endl;
+
+    std::cout << "go -> first info:  median " << percentile(goLatency, 0.5) << " ms, max "
+              << percentile(goLatency, 1.0) << " ms" << std::endl;
+    std::cout << "stop -> bestmove:  median " << percentile(stopLatency, 0.5) << " ms, max "
+              << percentile(stopLatency, 1.0) << " ms" << std::endl;
+
+    std::cout << "Test 3 [Movetime Overshoot]: ";
+    for (int t = 0; t < 3; t++) {
+        if (percentile(overshoot[t], 1.0) > 50) {
+            std::cout << "FAIL (movetime " << MOVETIMES[t] << " overshot by " << percentile(overshoot[t], 1.0) << " ms)" << std::endl;
+            assert(false);
+        }
+    }
+    std::cout << "PASS" << std::endl;
+    for (int t = 0; t < 3; t++) {
+        std::cout << "movetime " << MOVETIMES[t] << " overshoot: median " << percentile(overshoot[t], 0.5)
+                  << " ms, p90 " << percentile(overshoot[t], 0.9) << " ms, max " << percentile(overshoot[t], 1.0)
+                  << " ms" << std::endl;
+    }
+
+    std::cout << "Test 4 [Perft Stop]: ";
+    if (perftReadyMs < 0 || perftStopMs < 0) {
+        std::cout << "FAIL (" << (perftReadyMs < 0 ? "no readyok" : "perft not stopped") << " during go perft)" << std::endl;
+        assert(false);
+    }
+    std::cout << "isready " << perftReadyMs << " ms, stop " << perftStopMs << " ms: PASS" << std::endl;
+
+    std::cout << "--- All UCI Latency Tests Passed ---" << std::endl;
+}
+
+int main() {
+    run_uci_latency_tests();
+    return 0;
+}
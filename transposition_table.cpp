@@ -1,30 +1,59 @@
 #include "transposition_table.h"
 #include <cstring>
+#include <cstdlib>
+#include <new>
+#include <atomic>
 
-TranspositionTable::TranspositionTable(int numEntries) {
-    size = numEntries;
-    table = new TTEntry[size];
-    for(int i=0; i<size; i++) {
-        table[i] = TTEntry();
-    }
+TranspositionTable::TranspositionTable(int mb) : table(nullptr), size(0), megabytes(0), generation(1) {
+    resize(mb);
 }
 
 TranspositionTable::~TranspositionTable() {
-    delete[] table;
+    std::free(table);
+}
+
+void TranspositionTable::resize(int mb) {
+    size_t entries = 1;
+    while (entries * 2 * sizeof(TTEntry) <= (size_t)mb * 1024 * 1024) entries *= 2;
+    std::free(table);
+    table = nullptr;
+    generation = 1;
+    size = (int)entries;
+    megabytes = mb;
+}
+
+void TranspositionTable::allocate() {
+    table = static_cast<TTEntry*>(std::calloc(size, sizeof(TTEntry)));
+    if (!table) throw std::bad_alloc();
+}
+
+void TranspositionTable::prefault() {
+    if (!table) allocate();
+    std::memset(static_cast<void*>(table), 0, sizeof(TTEntry) * size);
+    generation = 1;
 }
 
 void TranspositionTable::clear() {
-    for(int i=0; i<size; i++) {
-        table[i] = TTEntry();
+    if (!table) return;
+    // Every stale entry has an older generation; only a wrap-around needs the table rewritten
+    if (++generation == 0) {
+        std::memset(static_cast<void*>(table), 0, sizeof(TTEntry) * size);
+        generation = 1;
     }
 }
 
-void TranspositionTable::store(unsigned long long key, int depth, int ply, int score, Bound bound, Move bestMove, bool& collision) {
+void TranspositionTable::store(unsigned long long key, int depth, int ply, int score, Bound bound, Move bestMove, bool& collision, int staticEval) {
+    if (!table) allocate();
     int index = key & (size - 1);
     // Check collision (valid entry and different key)
-    collision = table[index].valid && table[index].key != key;
+    collision = table[index].generation == generation && table[index].key != key;
+    
+    // Always replace scheme, except that quiescence results must not evict deeper entries
+    if (depth <= 0 && table[index].generation == generation && table[index].depth > depth) {
+        collision = false;
+        return;
+    }
     
-    // Always replace scheme
     table[index].key = key;
     // Normalize mate scores to be relative to the node, not the root
     if (score > 9000) score += ply;
@@ -32,19 +61,22 @@ void TranspositionTable::store(unsigned long long key, int depth, int ply, int s
 
     table[index].depth = depth;
     table[index].score = score;
+    table[index].staticEval = staticEval;
     table[index].bound = bound;
     table[index].bestMove = bestMove;
-    table[index].valid = true;
+    table[index].generation = generation;
 }
 
-bool TranspositionTable::probe(unsigned long long key, int depth, int ply, int alpha, int beta, int& returnScore, Move& bestMove, bool& hit) {
+bool TranspositionTable::probe(unsigned long long key, int depth, int ply, int alpha, int beta, int& returnScore, Move& bestMove, bool& hit, int* staticEval) {
+    hit = false;
+    if (!table) return false;
     int index = key & (size - 1);
     TTEntry& entry = table[index];
 
-    hit = false;
-    if (entry.valid && entry.key == key) {
+    if (entry.generation == generation && entry.key == key) {
         hit = true;
         bestMove = entry.bestMove;
+        if (staticEval) *staticEval = entry.staticEval;
         if (entry.depth >= depth) {
             // Reconstruct the root-relative score from the node-relative score stored in TT
             int score = entry.score;
@@ -66,15 +98,54 @@ bool TranspositionTable::probe(unsigned long long key, int depth, int ply, int a
     return false;
 }
 
-PawnEntry PawnTable::table[131072] = {0};
-void PawnTable::store(unsigned long long key, int mgScore, int egScore) {
-    int index = key % 131072;
-    table[index].key = key;
-    table[index].mgScore = mgScore;
-    table[index].egScore = egScore;
+static std::atomic<int> pawnHashMB(PawnHashTable::DEFAULT_MB);
+
+PawnHashTable::PawnHashTable(int mb) : table(nullptr), size(0), megabytes(0) {
+    resize(mb);
 }
-std::pair<int, int> PawnTable::probe(unsigned long long key) {
-    int index = key % 131072;
-    if (table[index].key == key) return {table[index].mgScore, table[index].egScore};
-    return {-1000000, -1000000};
+
+PawnHashTable::~PawnHashTable() {
+    delete[] table;
+}
+
+void PawnHashTable::resize(int mb) {
+    // Largest power of two number of entries that fits in the budget
+    size_t entries = 1;
+    while (entries * 2 * sizeof(PawnEntry) <= (size_t)mb * 1024 * 1024) entries *= 2;
+    delete[] table;
+    size = (int)entries;
+    megabytes = mb;
+    table = new PawnEntry[size];
+    clear();
+}
+
+void PawnHashTable::clear() {
+    std::memset(table, 0, sizeof(PawnEntry) * size);
+}
+
+PawnHashTable& PawnHashTable::local() {
+    static thread_local PawnHashTable table;
+    int mb = pawnHashMB.load(std::memory_order_relaxed);
+    if (table.megabytes != mb) table.resize(mb);
+    return table;
+}
+
+void PawnHashTable::setSizeMB(int mb) {
+    pawnHashMB.store(mb, std::memory_order_relaxed);
+}
+
+int PawnHashTable::getSizeMB() {
+    return pawnHashMB.load(std::memory_order_relaxed);
+}
+
+MaterialHashTable::MaterialHashTable() : table(SIZE) {
+    std::memset(table.data(), 0, sizeof(MaterialEntry) * SIZE);
+    // An empty slot holds a key that indexes a different slot, so no signature can match it.
+    // A zero key would match bare kings, whose signature is 0.
+    for (int i = 0; i < SIZE; i++) table[i].key = (unsigned long long)(i ^ 1);
+}
+
+MaterialHashTable& MaterialHashTable::local() {
+    static thread_local MaterialHashTable table;
+    return table;
 }
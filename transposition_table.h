@@ -5,42 +5,125 @@
 
 enum Bound { EXACT, UPPER_BOUND, LOWER_BOUND };
 
+const int SCORE_NONE = -32000; // Sentinel for "no static eval" (side to move in check)
+
+// An entry is live only while its generation matches the table's; generation 0 is never
+// current, so an all-zero entry is empty and the table can come straight from zeroed pages.
 struct TTEntry {
     unsigned long long key;
     int depth;
     int score;
+    int staticEval;
     Bound bound;
     Move bestMove;
-    bool valid;
+    uint8_t generation;
 
-    TTEntry() : key(0), depth(0), score(0), bound(EXACT), bestMove(0,0,0,0), valid(false) {}
+    TTEntry() : key(0), depth(0), score(0), staticEval(SCORE_NONE), bound(EXACT), bestMove(0,0,0,0), generation(0) {}
 };
 
+// Main search hash. Memory is obtained zero-filled (calloc, so large tables are demand-paged
+// by the OS) on the first store rather than at construction, so processes that never search
+// do not pay for it. clear() bumps the generation instead of rewriting the table.
 class TranspositionTable {
 private:
     TTEntry* table;
     int size;
+    int megabytes;
+    uint8_t generation;
+    void allocate();
 
 public:
-    TranspositionTable(int numEntries);
+    static const int DEFAULT_MB = 256; // 2^22 entries
+
+    explicit TranspositionTable(int mb = DEFAULT_MB);
     ~TranspositionTable();
 
-    void store(unsigned long long key, int depth, int ply, int score, Bound bound, Move bestMove, bool& collision);
-    bool probe(unsigned long long key, int depth, int ply, int alpha, int beta, int& returnScore, Move& bestMove, bool& hit);
+    // Quiescence entries are stored with depth <= 0 and never evict deeper main-search entries.
+    // staticEval caches Board::evaluate (side to move relative) so a repeat visit can skip it.
+    void store(unsigned long long key, int depth, int ply, int score, Bound bound, Move bestMove, bool& collision, int staticEval = SCORE_NONE);
+    bool probe(unsigned long long key, int depth, int ply, int alpha, int beta, int& returnScore, Move& bestMove, bool& hit, int* staticEval = nullptr);
     void clear();
+    void resize(int mb); // Largest power of two number of entries within mb; allocated lazily
+    void prefault();     // Allocates now and touches every page, so no search pays page faults
+    int getSizeMB() const { return megabytes; }
 };
 
+// Pawn structure cache entry, keyed by the pawn key (pawns and both king squares).
+// Bitboards cover both colors; mask with Board::colors to split them.
 struct PawnEntry {
     unsigned long long key;
-    int mgScore;
+    Bitboard passed;
+    Bitboard isolated;
+    Bitboard backward;
+    Bitboard attackSpan[2];  // Squares each side's pawns attack now or after advancing
+    int mgScore;             // Doubled, isolated, backward and passed pawn terms (White relative)
     int egScore;
+    int shelter[2][2];       // [color][mg/eg] king shelter penalty for that color
+    int storm[2][2];         // [color][mg/eg] penalty for enemy pawns storming that color's king
 };
 
-class PawnTable {
+// Per-thread pawn hash. Each thread's table follows the size set by setSizeMB
+// (PawnHash UCI option) the next time it is fetched with local().
+class PawnHashTable {
+private:
+    PawnEntry* table;
+    int size;
+    int megabytes;
+
 public:
-    static PawnEntry table[131072];
-    static void store(unsigned long long key, int mgScore, int egScore);
-    static std::pair<int, int> probe(unsigned long long key);
+    static const int DEFAULT_MB = 2;
+
+    explicit PawnHashTable(int mb = DEFAULT_MB);
+    ~PawnHashTable();
+
+    void resize(int mb);
+    void clear();
+    // Returns the slot for key; found tells whether it already holds that key
+    PawnEntry* probe(unsigned long long key, bool& found) {
+        PawnEntry* entry = &table[key & (size - 1)];
+        found = entry->key == key;
+        return entry;
+    }
+
+    static PawnHashTable& local();
+    static void setSizeMB(int mb);
+    static int getSizeMB();
+};
+
+enum MaterialFlags {
+    MATERIAL_DRAW = 1,   // Neither side can force mate
+    MATERIAL_SCALED = 2  // The endgame score may be scaled down (see Endgame::scaleFactor)
+};
+
+// Material configuration cache entry, keyed by the material key (piece counts of both sides)
+struct MaterialEntry {
+    unsigned long long key;
+    int16_t imbalanceMg;  // White relative
+    int16_t imbalanceEg;
+    uint8_t phase;        // 0 (bare kings) .. 24 (all pieces)
+    uint8_t flags;        // MaterialFlags
+    uint8_t endgame;      // Endgame::Type with a specialised evaluator, or Endgame::NONE
+    uint8_t strongSide;   // Side the specialised evaluator plays for
+    uint8_t scale[2];     // Endgame scale when that side is ahead, out of Endgame::SCALE_NORMAL
+    uint8_t scaleFn[2];   // Endgame::ScaleType refining the scale per position when that side is ahead
+};
+
+// Per-thread material hash. A few hundred signatures cover a whole game, so it has a fixed size.
+class MaterialHashTable {
+private:
+    std::vector<MaterialEntry> table;
+
+public:
+    static const int SIZE = 8192;
+
+    MaterialHashTable();
+    MaterialEntry* probe(unsigned long long key, bool& found) {
+        MaterialEntry* entry = &table[key & (SIZE - 1)];
+        found = entry->key == key;
+        return entry;
+    }
+
+    static MaterialHashTable& local();
 };
 
 #endif // TT_H
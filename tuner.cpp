@@ -0,0 +1,589 @@
+#include "tuner.h"
+#include "board.h"
+#include "eval_params.h"
+#include "zobrist.h"
+#include "endgame.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+    // One block of parameters in eval_params.h. Every block has a midgame and an endgame
+    // half, so terms that are currently midgame-only can pick up an endgame weight too.
+    enum TermKind { TERM_SCALAR, TERM_ARRAY, TERM_TABLE };
+
+    struct Term {
+        const char* mgName;
+        const char* egName;
+        TermKind kind;
+        int size;
+        const int* mg;
+        const int* eg;
+    };
+
+    // TERMS[PAWN..KING] are the piece-square tables, so a PieceType indexes its own table
+    enum TermId {
+        T_VALUE, T_PST_PAWN, T_PST_KNIGHT, T_PST_BISHOP, T_PST_ROOK, T_PST_QUEEN, T_PST_KING,
+        T_DOUBLED_PAWN, T_ISOLATED_PAWN, T_BISHOP_PAIR, T_ROOK_OPEN_FILE, T_ROOK_SEMI_OPEN_FILE,
+        T_UNDEVELOPED_MINOR, T_CASTLED_KING, T_PASSED_PAWN, T_SHELTER_KINGSIDE, T_SHELTER_QUEENSIDE,
+        T_SHELTER_FIANCHETTO, T_KING_IN_CENTER, T_MOBILITY, T_KING_ATTACK,
+        T_BACKWARD_PAWN, T_PAWN_STORM, NUM_TERMS
+    };
+
+    const Term TERMS[NUM_TERMS] = {
+        { "MG_VALUE", "EG_VALUE", TERM_ARRAY, 7, EvalParams::MG_VALUE, EvalParams::EG_VALUE },
+        { "PAWN_MG", "PAWN_EG", TERM_TABLE, 64, &EvalParams::PAWN_MG[0][0], &EvalParams::PAWN_EG[0][0] },
+        { "KNIGHT_MG", "KNIGHT_EG", TERM_TABLE, 64, &EvalParams::KNIGHT_MG[0][0], &EvalParams::KNIGHT_EG[0][0] },
+        { "BISHOP_MG", "BISHOP_EG", TERM_TABLE, 64, &EvalParams::BISHOP_MG[0][0], &EvalParams::BISHOP_EG[0][0] },
+        { "ROOK_MG", "ROOK_EG", TERM_TABLE, 64, &EvalParams::ROOK_MG[0][0], &EvalParams::ROOK_EG[0][0] },
+        { "QUEEN_MG", "QUEEN_EG", TERM_TABLE, 64, &EvalParams::QUEEN_MG[0][0], &EvalParams::QUEEN_EG[0][0] },
+        { "KING_MG", "KING_EG", TERM_TABLE, 64, &EvalParams::KING_MG[0][0], &EvalParams::KING_EG[0][0] },
+        { "DOUBLED_PAWN_MG", "DOUBLED_PAWN_EG", TERM_SCALAR, 1, &EvalParams::DOUBLED_PAWN_MG, &EvalParams::DOUBLED_PAWN_EG },
+        { "ISOLATED_PAWN_MG", "ISOLATED_PAWN_EG", TERM_SCALAR, 1, &EvalParams::ISOLATED_PAWN_MG, &EvalParams::ISOLATED_PAWN_EG },
+        { "BISHOP_PAIR_MG", "BISHOP_PAIR_EG", TERM_SCALAR, 1, &EvalParams::BISHOP_PAIR_MG, &EvalParams::BISHOP_PAIR_EG },
+        { "ROOK_OPEN_FILE_MG", "ROOK_OPEN_FILE_EG", TERM_SCALAR, 1, &EvalParams::ROOK_OPEN_FILE_MG, &EvalParams::ROOK_OPEN_FILE_EG },
+        { "ROOK_SEMI_OPEN_FILE_MG", "ROOK_SEMI_OPEN_FILE_EG", TERM_SCALAR, 1, &EvalParams::ROOK_SEMI_OPEN_FILE_MG, &EvalParams::ROOK_SEMI_OPEN_FILE_EG },
+        { "UNDEVELOPED_MINOR_MG", "UNDEVELOPED_MINOR_EG", TERM_SCALAR, 1, &EvalParams::UNDEVELOPED_MINOR_MG, &EvalParams::UNDEVELOPED_MINOR_EG },
+        { "CASTLED_KING_MG", "CASTLED_KING_EG", TERM_SCALAR, 1, &EvalParams::CASTLED_KING_MG, &EvalParams::CASTLED_KING_EG },
+        { "PASSED_PAWN_MG", "PASSED_PAWN_EG", TERM_ARRAY, 8, EvalParams::PASSED_PAWN_MG, EvalParams::PASSED_PAWN_EG },
+        { "KING_SHELTER_KINGSIDE_MG", "KING_SHELTER_KINGSIDE_EG", TERM_ARRAY, 3, EvalParams::KING_SHELTER_KINGSIDE_MG, EvalParams::KING_SHELTER_KINGSIDE_EG },
+        { "KING_SHELTER_QUEENSIDE_MG", "KING_SHELTER_QUEENSIDE_EG", TERM_ARRAY, 3, EvalParams::KING_SHELTER_QUEENSIDE_MG, EvalParams::KING_SHELTER_QUEENSIDE_EG },
+        { "KING_SHELTER_FIANCHETTO_MG", "KING_SHELTER_FIANCHETTO_EG", TERM_SCALAR, 1, &EvalParams::KING_SHELTER_FIANCHETTO_MG, &EvalParams::KING_SHELTER_FIANCHETTO_EG },
+        { "KING_IN_CENTER_MG", "KING_IN_CENTER_EG", TERM_SCALAR, 1, &EvalParams::KING_IN_CENTER_MG, &EvalParams::KING_IN_CENTER_EG },
+        { "MOBILITY_MG", "MOBILITY_EG", TERM_ARRAY, 7, EvalParams::MOBILITY_MG, EvalParams::MOBILITY_EG },
+        { "KING_ATTACK_MG", "KING_ATTACK_EG", TERM_ARRAY, 7, EvalParams::KING_ATTACK_MG, EvalParams::KING_ATTACK_EG },
+        { "BACKWARD_PAWN_MG", "BACKWARD_PAWN_EG", TERM_SCALAR, 1, &EvalParams::BACKWARD_PAWN_MG, &EvalParams::BACKWARD_PAWN_EG },
+        { "PAWN_STORM_MG", "PAWN_STORM_EG", TERM_ARRAY, 8, EvalParams::PAWN_STORM_MG, EvalParams::PAWN_STORM_EG }
+    };
+
+    int termOffset[NUM_TERMS + 1];
+
+    void initTermOffsets() {
+        termOffset[0] = 0;
+        for (int t = 0; t < NUM_TERMS; t++) termOffset[t + 1] = termOffset[t] + TERMS[t].size;
+    }
+
+    inline int numParams() { return termOffset[NUM_TERMS]; }
+
+    // Compact per-position record: the position itself is discarded after tracing and only
+    // its non-zero parameter coefficients (White count minus Black count) are kept.
+    struct Coefficient {
+        uint16_t index;
+        int16_t value;
+    };
+
+    struct TunePosition {
+        uint32_t begin;  // First coefficient in the shared coefficient array
+        uint16_t count;
+        uint8_t phase;   // 0 (bare kings) .. 24 (all pieces), as in Board::evaluate
+        uint8_t scale;   // Endgame scale of the eg score, out of Endgame::SCALE_NORMAL
+        float result;    // 1.0 White win, 0.5 draw, 0.0 Black win
+        float offset;    // Board::evaluate() minus the traced linear eval (rounding and untraced terms)
+    };
+
+    // Mirrors Board::evaluate term by term, recording how often each parameter applies.
+    // Penalties enter with a negative coefficient, exactly as they are subtracted there.
+    void traceEvaluation(const Board& b, std::vector<int>& coef) {
+        std::fill(coef.begin(), coef.end(), 0);
+
+        for (int sq = 0; sq < 64; sq++) {
+            const Piece& p = b.pieceList[sq];
+            if (p.type == EMPTY) continue;
+            int sign = (p.color == WHITE) ? 1 : -1;
+            int pRank = (p.color == WHITE) ? 7 - sq / 8 : sq / 8;
+            coef[termOffset[T_VALUE] + p.type] += sign;
+            coef[termOffset[p.type] + pRank * 8 + sq % 8] += sign;
+        }
+
+        if (b.pieceCount[WHITE][BISHOP] >= 2) coef[termOffset[T_BISHOP_PAIR]]++;
+        if (b.pieceCount[BLACK][BISHOP] >= 2) coef[termOffset[T_BISHOP_PAIR]]--;
+
+        for (int c = WHITE; c <= BLACK; c++) {
+            int sign = (c == WHITE) ? 1 : -1;
+            Bitboard ownPawns = b.pieces[PAWN] & b.colors[c];
+            Bitboard oppPawns = b.pieces[PAWN] & b.colors[c ^ 1];
+            Bitboard rooks = b.pieces[ROOK] & b.colors[c];
+            while (rooks) {
+                int sq = __builtin_ctzll(rooks);
+                Bitboard fileMask = 0x0101010101010101ULL << (sq % 8);
+                bool ownPawn = (ownPawns & fileMask) != 0;
+                bool oppPawn = (oppPawns & fileMask) != 0;
+                if (!ownPawn && !oppPawn) coef[termOffset[T_ROOK_OPEN_FILE]] += sign;
+                else if (!ownPawn) coef[termOffset[T_ROOK_SEMI_OPEN_FILE]] += sign;
+                rooks &= rooks - 1;
+            }
+        }
+
+        const int whiteMinorSquares[4] = { 1, 6, 2, 5 };
+        const int blackMinorSquares[4] = { 57, 62, 58, 61 };
+        for (int i = 0; i < 4; i++) {
+            PieceType minor = i < 2 ? KNIGHT : BISHOP;
+            const Piece& wp = b.pieceList[whiteMinorSquares[i]];
+            const Piece& bp = b.pieceList[blackMinorSquares[i]];
+            if (wp.type == minor && wp.color == WHITE) coef[termOffset[T_UNDEVELOPED_MINOR]]--;
+            if (bp.type == minor && bp.color == BLACK) coef[termOffset[T_UNDEVELOPED_MINOR]]++;
+        }
+
+        if (!(b.gameState.castlingRights & WHITE_CASTLING)) {
+            if ((b.pieceList[6].type == KING && b.pieceList[6].color == WHITE) || (b.pieceList[2].type == KING && b.pieceList[2].color == WHITE)) {
+                coef[termOffset[T_CASTLED_KING]]++;
+            }
+        }
+        if (!(b.gameState.castlingRights & BLACK_CASTLING)) {
+            if ((b.pieceList[62].type == KING && b.pieceList[62].color == BLACK) || (b.pieceList[58].type == KING && b.pieceList[58].color == BLACK)) {
+                coef[termOffset[T_CASTLED_KING]]--;
+            }
+        }
+
+        const AttackInfo& ai = b.attacks();
+        for (int t = PAWN; t <= QUEEN; t++) {
+            coef[termOffset[T_MOBILITY] + t] += ai.mobility[WHITE][t] - ai.mobility[BLACK][t];
+            coef[termOffset[T_KING_ATTACK] + t] += ai.kingAttacks[WHITE][t] - ai.kingAttacks[BLACK][t];
+        }
+
+        // Pawn structure, king shelter and pawn storms, as in Board::computePawnEntry. The
+        // classification bitboards come from the pawn hash entry itself.
+        const PawnEntry& pe = b.pawnEntry();
+        Bitboard pawns[2] = { b.pieces[PAWN] & b.colors[WHITE], b.pieces[PAWN] & b.colors[BLACK] };
+        for (int c = WHITE; c <= BLACK; c++) {
+            int sign = (c == WHITE) ? 1 : -1;
+            for (int f = 0; f < 8; f++) {
+                int onFile = __builtin_popcountll(pawns[c] & (0x0101010101010101ULL << f));
+                if (onFile > 1) coef[termOffset[T_DOUBLED_PAWN]] -= sign * (onFile - 1);
+            }
+            coef[termOffset[T_ISOLATED_PAWN]] -= sign * __builtin_popcountll(pe.isolated & pawns[c]);
+            coef[termOffset[T_BACKWARD_PAWN]] -= sign * __builtin_popcountll(pe.backward & pawns[c]);
+            for (Bitboard bb = pe.passed & pawns[c]; bb; bb &= bb - 1) {
+                int sq = __builtin_ctzll(bb);
+                coef[termOffset[T_PASSED_PAWN] + (c == WHITE ? sq / 8 : 7 - sq / 8)] += sign;
+            }
+        }
+
+        for (int c = WHITE; c <= BLACK; c++) {
+            int kf = b.kingPos[c].second;
+            int sign = (c == WHITE) ? 1 : -1;
+            int flip = (c == WHITE) ? 0 : 56;
+            if (kf >= 5) {
+                for (int i = 0; i < 3; i++) {
+                    const Piece& p = b.pieceList[(13 + i) ^ flip];
+                    if (p.type != PAWN || p.color != c) coef[termOffset[T_SHELTER_KINGSIDE] + i] -= sign;
+                }
+                const Piece& fianchetto = b.pieceList[22 ^ flip];
+                if (fianchetto.type == PAWN && fianchetto.color == c) coef[termOffset[T_SHELTER_FIANCHETTO]] += sign;
+            } else if (kf <= 2) {
+                for (int i = 0; i < 3; i++) {
+                    const Piece& p = b.pieceList[(8 + i) ^ flip];
+                    if (p.type != PAWN || p.color != c) coef[termOffset[T_SHELTER_QUEENSIDE] + i] -= sign;
+                }
+            } else {
+                coef[termOffset[T_KING_IN_CENTER]] -= sign;
+            }
+            int centre = kf < 1 ? 1 : (kf > 6 ? 6 : kf);
+            for (int f = centre - 1; f <= centre + 1; f++) {
+                Bitboard stormers = pawns[c ^ 1] & (0x0101010101010101ULL << f);
+                if (!stormers) continue;
+                int sq = (c == WHITE) ? __builtin_ctzll(stormers) : 63 - __builtin_clzll(stormers);
+                coef[termOffset[T_PAWN_STORM] + (c == WHITE ? 7 - sq / 8 : sq / 8)] -= sign;
+            }
+        }
+    }
+
+    int gamePhase(const Board& b) {
+        int phase = b.pieceCount[WHITE][KNIGHT] + b.pieceCount[BLACK][KNIGHT]
+                  + b.pieceCount[WHITE][BISHOP] + b.pieceCount[BLACK][BISHOP]
+                  + 2 * (b.pieceCount[WHITE][ROOK] + b.pieceCount[BLACK][ROOK])
+                  + 4 * (b.pieceCount[WHITE][QUEEN] + b.pieceCount[BLACK][QUEEN]);
+        return phase > 24 ? 24 : phase;
+    }
+
+    // Capture-only quiescence search that keeps its principal variation, so each training
+    // position can be replaced by the quiet position at the end of its PV before tracing.
+    const int RESOLVE_MAX_PLY = 24;
+
+    struct Resolver {
+        Move pv[RESOLVE_MAX_PLY + 1][RESOLVE_MAX_PLY + 1];
+        int pvLength[RESOLVE_MAX_PLY + 1];
+
+        int search(Board& board, Color turn, int alpha, int beta, int ply) {
+            pvLength[ply] = 0;
+            int standPat = board.evaluate();
+            if (turn == BLACK) standPat = -standPat;
+            if (ply >= RESOLVE_MAX_PLY || standPat >= beta) return standPat;
+            if (standPat > alpha) alpha = standPat;
+
+            Board::MoveList moves;
+            board.generateMoves(turn, moves);
+            Move captures[256];
+            int scores[256];
+            int n = 0;
+            for (int i = 0; i < moves.size(); i++) {
+                const Move& m = moves[i];
+                Piece victim = board.getPiece(m.toX, m.toY);
+                if (victim.type == EMPTY && !m.isEnPassant && m.promotion == EMPTY) continue;
+                if (board.see(m) < 0) continue;
+                captures[n] = m;
+                scores[n] = Board::SEE_VALUE[m.isEnPassant ? PAWN : victim.type] + Board::SEE_VALUE[m.promotion];
+                n++;
+            }
+
+            Color opp = (turn == WHITE) ? BLACK : WHITE;
+            for (int i = 0; i < n; i++) {
+                int best = i;
+                for (int j = i + 1; j < n; j++) if (scores[j] > scores[best]) best = j;
+                std::swap(captures[i], captures[best]);
+                std::swap(scores[i], scores[best]);
+                const Move& m = captures[i];
+
+                GameState prevState = board.gameState;
+                Piece captured = board.getPiece(m.toX, m.toY);
+                board.makeMove(m);
+                if (board.isInCheck(turn)) {
+                    board.undoMove(m, captured, prevState);
+                    continue;
+                }
+                int score = -search(board, opp, -beta, -alpha, ply + 1);
+                board.undoMove(m, captured, prevState);
+
+                if (score > alpha) {
+                    alpha = score;
+                    pv[ply][0] = m;
+                    for (int k = 0; k < pvLength[ply + 1]; k++) pv[ply][k + 1] = pv[ply + 1][k];
+                    pvLength[ply] = pvLength[ply + 1] + 1;
+                    if (score >= beta) break;
+                }
+            }
+            return alpha;
+        }
+    };
+
+    // Splits a dataset line into a FEN and a White-relative result. Accepts EPD/FEN followed by
+    // "1-0" / "0-1" / "1/2-1/2" (optionally quoted, e.g. c9 "1-0";) or [1.0] / [0.5] / [0.0].
+    bool parseLine(const std::string& line, std::string& fen, float& result) {
+        if (line.find("1/2-1/2") != std::string::npos) result = 0.5f;
+        else if (line.find("1-0") != std::string::npos) result = 1.0f;
+        else if (line.find("0-1") != std::string::npos) result = 0.0f;
+        else {
+            size_t open = line.find('[');
+            if (open == std::string::npos) return false;
+            result = (float)std::atof(line.c_str() + open + 1);
+        }
+
+        std::istringstream iss(line);
+        std::string field;
+        std::vector<std::string> fields;
+        while (fields.size() < 6 && iss >> field) fields.push_back(field);
+        if (fields.size() < 4) return false;
+
+        fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+        bool hasClocks = fields.size() == 6
+            && fields[4].find_first_not_of("0123456789") == std::string::npos
+            && fields[5].find_first_not_of("0123456789") == std::string::npos;
+        fen += hasClocks ? " " + fields[4] + " " + fields[5] : " 0 1";
+        return true;
+    }
+
+    struct TraceBatch {
+        std::vector<TunePosition> positions;
+        std::vector<Coefficient> coefficients;
+    };
+
+    void traceLines(const std::vector<std::string>& lines, size_t begin, size_t end, TraceBatch& out) {
+        Board* board = new Board(); // Kept off the thread stack along with the resolver
+        Resolver* resolver = new Resolver();
+        std::vector<int> coef(numParams());
+        std::string fen;
+        float result;
+
+        for (size_t i = begin; i < end; i++) {
+            if (!parseLine(lines[i], fen, result)) continue;
+            Color turn = board->loadFEN(fen);
+            if (board->kingPos[WHITE].first < 0 || board->kingPos[BLACK].first < 0) continue;
+
+            resolver->search(*board, turn, -30000, 30000, 0);
+            for (int k = 0; k < resolver->pvLength[0]; k++) board->makeMove(resolver->pv[0][k]);
+            // Specialised endgame evaluators use none of the tuned terms
+            const MaterialEntry& me = board->materialEntry();
+            if (me.endgame != Endgame::NONE) continue;
+
+            traceEvaluation(*board, coef);
+            TunePosition pos;
+            pos.begin = (uint32_t)out.coefficients.size();
+            pos.count = 0;
+            pos.phase = (uint8_t)gamePhase(*board);
+            pos.result = result;
+
+            double mg = 0.0, eg = 0.0;
+            for (int p = 0; p < numParams(); p++) {
+                if (coef[p] == 0) continue;
+                Coefficient c;
+                c.index = (uint16_t)p;
+                c.value = (int16_t)coef[p];
+                out.coefficients.push_back(c);
+                pos.count++;
+                int t = (int)(std::upper_bound(termOffset, termOffset + NUM_TERMS + 1, p) - termOffset) - 1;
+                mg += coef[p] * TERMS[t].mg[p - termOffset[t]];
+                eg += coef[p] * TERMS[t].eg[p - termOffset[t]];
+            }
+            pos.scale = (uint8_t)Endgame::SCALE_NORMAL;
+            if (me.flags & MATERIAL_SCALED) pos.scale = (uint8_t)Endgame::scaleFactor(*board, me, eg > 0 ? WHITE : BLACK);
+            eg = eg * pos.scale / Endgame::SCALE_NORMAL;
+            pos.offset = (float)(board->evaluate() - (mg * pos.phase + eg * (24 - pos.phase)) / 24.0);
+            out.positions.push_back(pos);
+        }
+        delete resolver;
+        delete board;
+    }
+
+    template <typename Fn>
+    void parallelFor(int threads, size_t n, Fn fn) {
+        std::vector<std::thread> pool;
+        size_t chunk = (n + threads - 1) / threads;
+        for (int t = 0; t < threads; t++) {
+            size_t begin = std::min(n, t * chunk);
+            size_t end = std::min(n, begin + chunk);
+            pool.push_back(std::thread(fn, t, begin, end));
+        }
+        for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+    }
+
+    struct Dataset {
+        std::vector<TunePosition> positions;
+        std::vector<Coefficient> coefficients;
+    };
+
+    bool loadDataset(const std::string& path, int threads, Dataset& data) {
+        std::ifstream in(path.c_str());
+        if (!in) return false;
+
+        // Lines are read in batches so memory stays bounded by the compact traces
+        const size_t BATCH = 1 << 18;
+        std::vector<std::string> lines;
+        std::string line;
+        bool more = true;
+        while (more) {
+            lines.clear();
+            while (lines.size() < BATCH && (more = (bool)std::getline(in, line))) {
+                if (!line.empty()) lines.push_back(line);
+            }
+            std::vector<TraceBatch> batches(threads);
+            parallelFor(threads, lines.size(), [&](int t, size_t begin, size_t end) {
+                traceLines(lines, begin, end, batches[t]);
+            });
+            // Concatenate in thread order so the dataset layout is independent of scheduling
+            for (int t = 0; t < threads; t++) {
+                uint32_t base = (uint32_t)data.coefficients.size();
+                for (size_t i = 0; i < batches[t].positions.size(); i++) {
+                    TunePosition pos = batches[t].positions[i];
+                    pos.begin += base;
+                    data.positions.push_back(pos);
+                }
+                data.coefficients.insert(data.coefficients.end(), batches[t].coefficients.begin(), batches[t].coefficients.end());
+            }
+        }
+        return true;
+    }
+
+    // params holds (mg, eg) pairs: params[2 * i] and params[2 * i + 1]
+    inline double linearEval(const TunePosition& pos, const Coefficient* coef, const double* params) {
+        double mg = 0.0, eg = 0.0;
+        for (int k = 0; k < pos.count; k++) {
+            mg += coef[k].value * params[2 * coef[k].index];
+            eg += coef[k].value * params[2 * coef[k].index + 1];
+        }
+        return (mg * pos.phase + eg * pos.scale / Endgame::SCALE_NORMAL * (24 - pos.phase)) / 24.0 + pos.offset;
+    }
+
+    inline double sigmoid(double K, double eval) {
+        return 1.0 / (1.0 + std::pow(10.0, -K * eval / 400.0));
+    }
+
+    double computeLoss(const Dataset& data, const std::vector<double>& params, double K, int threads) {
+        std::vector<double> partial(threads, 0.0);
+        parallelFor(threads, data.positions.size(), [&](int t, size_t begin, size_t end) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; i++) {
+                const TunePosition& pos = data.positions[i];
+                double err = pos.result - sigmoid(K, linearEval(pos, &data.coefficients[pos.begin], params.data()));
+                sum += err * err;
+            }
+            partial[t] = sum;
+        });
+        double total = 0.0;
+        for (int t = 0; t < threads; t++) total += partial[t];
+        return total / data.positions.size();
+    }
+
+    void computeGradient(const Dataset& data, const std::vector<double>& params, double K, int threads, std::vector<double>& gradient) {
+        // One gradient slice per thread, summed in thread order for reproducible results
+        const size_t n = params.size();
+        std::vector<double> partial(threads * n, 0.0);
+        parallelFor(threads, data.positions.size(), [&](int t, size_t begin, size_t end) {
+            double* g = &partial[t * n];
+            for (size_t i = begin; i < end; i++) {
+                const TunePosition& pos = data.positions[i];
+                const Coefficient* coef = &data.coefficients[pos.begin];
+                double s = sigmoid(K, linearEval(pos, coef, params.data()));
+                // d/d(eval) of (result - s)^2
+                double d = -2.0 * (pos.result - s) * s * (1.0 - s) * K * std::log(10.0) / 400.0;
+                double dMg = d * pos.phase / 24.0;
+                double dEg = d * (24 - pos.phase) / 24.0 * pos.scale / Endgame::SCALE_NORMAL;
+                for (int k = 0; k < pos.count; k++) {
+                    g[2 * coef[k].index] += dMg * coef[k].value;
+                    g[2 * coef[k].index + 1] += dEg * coef[k].value;
+                }
+            }
+        });
+        std::fill(gradient.begin(), gradient.end(), 0.0);
+        for (int t = 0; t < threads; t++) {
+            for (size_t p = 0; p < n; p++) gradient[p] += partial[t * n + p];
+        }
+        for (size_t p = 0; p < gradient.size(); p++) gradient[p] /= data.positions.size();
+    }
+
+    // Scaling constant K of the eval -> win probability mapping that best fits the dataset
+    double fitK(const Dataset& data, const std::vector<double>& params, int threads) {
+        double lo = 0.05, hi = 3.0;
+        for (int iter = 0; iter < 30; iter++) {
+            double m1 = lo + (hi - lo) / 3.0;
+            double m2 = hi - (hi - lo) / 3.0;
+            if (computeLoss(data, params, m1, threads) < computeLoss(data, params, m2, threads)) hi = m2;
+            else lo = m1;
+        }
+        return (lo + hi) / 2.0;
+    }
+
+    void writeValues(std::ostream& out, const std::vector<double>& params, int first, int count, int half) {
+        for (int i = 0; i < count; i++) {
+            out << (i ? ", " : "") << (int)std::lround(params[2 * (first + i) + half]);
+        }
+    }
+
+    // Writes the parameters in the layout of eval_params.h
+    bool writeHeader(const std::string& path, const std::vector<double>& params) {
+        std::ofstream out(path.c_str());
+        if (!out) return false;
+        out << "// Evaluation parameters. Written by \"./chess tune <dataset>\"; a tuned header can\n"
+            << "// replace this file directly. Piece-square tables are indexed [rank][file] from\n"
+            << "// the owner's point of view (row 0 is the eighth rank for White).\n"
+            << "#ifndef EVAL_PARAMS_H\n"
+            << "#define EVAL_PARAMS_H\n\n"
+            << "namespace EvalParams {\n";
+        for (int t = 0; t < NUM_TERMS; t++) {
+            const Term& term = TERMS[t];
+            int first = termOffset[t];
+            if (term.kind == TERM_TABLE || (t > 0 && TERMS[t - 1].kind == TERM_TABLE)) out << "\n";
+            for (int half = 0; half < 2; half++) {
+                const char* name = half ? term.egName : term.mgName;
+                if (term.kind == TERM_SCALAR) {
+                    out << "    const int " << name << " = " << (int)std::lround(params[2 * first + half]) << ";\n";
+                } else if (term.kind == TERM_ARRAY) {
+                    out << "    const int " << name << "[" << term.size << "] = { ";
+                    writeValues(out, params, first, term.size, half);
+                    out << " };\n";
+                } else {
+                    if (half) out << "\n";
+                    out << "    const int " << name << "[8][8] = {\n";
+                    for (int r = 0; r < 8; r++) {
+                        out << "        {";
+                        for (int f = 0; f < 8; f++) {
+                            char buf[8];
+                            std::snprintf(buf, sizeof(buf), "%4d", (int)std::lround(params[2 * (first + r * 8 + f) + half]));
+                            out << (f ? "," : "") << buf;
+                        }
+                        out << (r < 7 ? "},\n" : "}\n");
+                    }
+                    out << "    };\n";
+                }
+            }
+        }
+        out << "}\n\n#endif // EVAL_PARAMS_H\n";
+        return true;
+    }
+}
+
+void runTuner(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: ./chess tune <dataset> [-epochs N] [-lr X] [-threads N] [-out file.h]" << std::endl;
+        return;
+    }
+    std::string datasetPath = argv[2];
+    std::string outPath = "eval_params_tuned.h";
+    int epochs = 1000;
+    double learningRate = 1.0;
+    int threads = std::max(1, (int)std::thread::hardware_concurrency());
+
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "-epochs") epochs = std::atoi(argv[i + 1]);
+        else if (arg == "-lr") learningRate = std::atof(argv[i + 1]);
+        else if (arg == "-threads") threads = std::max(1, std::atoi(argv[i + 1]));
+        else if (arg == "-out") outPath = argv[i + 1];
+    }
+
+    Zobrist::init();
+    initTermOffsets();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    Dataset data;
+    if (!loadDataset(datasetPath, threads, data) || data.positions.empty()) {
+        std::cout << "No positions loaded from " << datasetPath << std::endl;
+        return;
+    }
+    double loadSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    size_t untraced = 0;
+    for (size_t i = 0; i < data.positions.size(); i++) {
+        // Integer rounding in Board::evaluate (tapering, endgame scaling) stays below 2cp
+        if (std::fabs(data.positions[i].offset) >= 2.0f) untraced++;
+    }
+    size_t bytes = data.positions.size() * sizeof(TunePosition) + data.coefficients.size() * sizeof(Coefficient);
+    std::cout << "Positions: " << data.positions.size() << " (" << threads << " threads, " << loadSeconds << "s)" << std::endl;
+    std::cout << "Parameters: " << numParams() << " x 2 (mg, eg)" << std::endl;
+    std::cout << "Memory: " << bytes / 1024 << " KB (" << (double)bytes / data.positions.size() << " bytes/position)" << std::endl;
+    std::cout << "Positions with untraced eval terms (held fixed): " << untraced << std::endl;
+
+    std::vector<double> params(2 * numParams());
+    for (int t = 0; t < NUM_TERMS; t++) {
+        for (int i = 0; i < TERMS[t].size; i++) {
+            params[2 * (termOffset[t] + i)] = TERMS[t].mg[i];
+            params[2 * (termOffset[t] + i) + 1] = TERMS[t].eg[i];
+        }
+    }
+
+    double K = fitK(data, params, threads);
+    std::cout << "K: " << K << "  initial loss: " << computeLoss(data, params, K, threads) << std::endl;
+
+    // Adam
+    const double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8;
+    std::vector<double> gradient(params.size(), 0.0);
+    std::vector<double> moments(2 * params.size(), 0.0); // First and second moment per parameter
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        computeGradient(data, params, K, threads, gradient);
+        double correction1 = 1.0 - std::pow(beta1, epoch);
+        double correction2 = 1.0 - std::pow(beta2, epoch);
+        for (size_t p = 0; p < params.size(); p++) {
+            double& m = moments[2 * p];
+            double& v = moments[2 * p + 1];
+            m = beta1 * m + (1.0 - beta1) * gradient[p];
+            v = beta2 * v + (1.0 - beta2) * gradient[p] * gradient[p];
+            params[p] -= learningRate * (m / correction1) / (std::sqrt(v / correction2) + epsilon);
+        }
+        if (epoch % 50 == 0 || epoch == epochs) {
+            double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            std::cout << "Epoch " << epoch << "  loss: " << computeLoss(data, params, K, threads)
+                      << "  (" << elapsed << "s)" << std::endl;
+            writeHeader(outPath, params);
+        }
+    }
+
+    if (writeHeader(outPath, params)) std::cout << "Parameters written to " << outPath << std::endl;
+    else std::cout << "Failed to write " << outPath << std::endl;
+}
@@ -0,0 +1,10 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+// Texel tuning of the evaluation parameters in eval_params.h.
+// Usage: ./chess tune <dataset> [-epochs N] [-lr X] [-threads N] [-out file.h]
+// Each dataset line holds a FEN/EPD position and a game result ("1-0", "0-1", "1/2-1/2",
+// or [1.0] / [0.5] / [0.0]) from White's point of view.
+void runTuner(int argc, char* argv[]);
+
+#endif // TUNER_H
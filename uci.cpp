@@ -1,9 +1,213 @@
 #include "uci.h"
+#include "nnue.h"
+#include "transposition_table.h"
+#include "tablebase.h"
+#include "perft.h"
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstdlib>
+#include <algorithm>
+
+namespace {
+    // Search parameters exposed as UCI spin options so they can be tuned externally
+    struct SpinOption {
+        const char* name;
+        int ChessAI::SearchParams::* field;
+        int minValue;
+        int maxValue;
+    };
+
+    const SpinOption spinOptions[] = {
+        {"LMRBase",           &ChessAI::SearchParams::lmrBase,           0, 300},
+        {"LMRDivisor",        &ChessAI::SearchParams::lmrDivisor,       50, 600},
+        {"LMRMinDepth",       &ChessAI::SearchParams::lmrMinDepth,       1, 10},
+        {"LMRMinMoves",       &ChessAI::SearchParams::lmrMinMoves,       0, 20},
+        {"LMRPvNode",         &ChessAI::SearchParams::lmrPvNode,         0, 300},
+        {"LMRImproving",      &ChessAI::SearchParams::lmrImproving,      0, 300},
+        {"LMRCutNode",        &ChessAI::SearchParams::lmrCutNode,        0, 300},
+        {"LMRTTCapture",      &ChessAI::SearchParams::lmrTTCapture,      0, 300},
+        {"LMRKiller",         &ChessAI::SearchParams::lmrKiller,         0, 300},
+        {"LMRHistoryDivisor", &ChessAI::SearchParams::lmrHistoryDivisor, 256, 65536},
+        {"LMRHistoryLimit",   &ChessAI::SearchParams::lmrHistoryLimit,   0, 600},
+        {"QDeltaMargin",      &ChessAI::SearchParams::qDeltaMargin,      0, 1000},
+        {"QFutilityMargin",   &ChessAI::SearchParams::qFutilityMargin,   0, 1000},
+        {"LazyEvalMargin",    &ChessAI::SearchParams::lazyEvalMargin,    0, 2000},
+    };
+
+    // UseNNUE as last set by the GUI, which may send it before EvalFile
+    bool nnueRequested = NNUE::enabled;
+
+    void printOptions(const ChessAI& ai) {
+        std::cout << "option name UseNNUE type check default " << (NNUE::enabled ? "true" : "false") << std::endl;
+        std::cout << "option name EvalFile type string default <empty>" << std::endl;
+        std::cout << "option name TBPath type string default <empty>" << std::endl;
+        std::cout << "option name Hash type spin default " << ai.tt.getSizeMB() << " min 1 max 4096" << std::endl;
+        std::cout << "option name PawnHash type spin default " << PawnHashTable::getSizeMB() << " min 1 max 256" << std::endl;
+        for (const SpinOption& opt : spinOptions) {
+            std::cout << "option name " << opt.name << " type spin default " << ai.params.*(opt.field)
+                      << " min " << opt.minValue << " max " << opt.maxValue << std::endl;
+        }
+    }
+
+    void setOption(ChessAI& ai, const std::string& name, const std::string& value) {
+        if (name == "EvalFile") {
+            if (NNUE::load(value)) {
+                NNUE::enabled = nnueRequested;
+                std::cout << "info string NNUE network loaded from " << value << " (" << NNUE::simdName() << ")" << std::endl;
+            } else {
+                std::cout << "info string failed to load NNUE network " << value << std::endl;
+            }
+            return;
+        }
+        if (name == "UseNNUE") {
+            nnueRequested = value == "true";
+            NNUE::enabled = nnueRequested && NNUE::isLoaded();
+            if (nnueRequested && !NNUE::isLoaded()) {
+                std::cout << "info string UseNNUE takes effect once EvalFile is loaded" << std::endl;
+            }
+            return;
+        }
+        if (name == "TBPath") {
+            int count = Tablebases::load(value);
+            std::cout << "info string " << count << " tablebases loaded from " << value << std::endl;
+            return;
+        }
+        if (name == "Hash") {
+            int mb = std::atoi(value.c_str());
+            ai.tt.resize(mb < 1 ? 1 : (mb > 4096 ? 4096 : mb));
+            return;
+        }
+        if (name == "PawnHash") {
+            int mb = std::atoi(value.c_str());
+            PawnHashTable::setSizeMB(mb < 1 ? 1 : (mb > 256 ? 256 : mb));
+            return;
+        }
+        for (const SpinOption& opt : spinOptions) {
+            if (name != opt.name) continue;
+            int v = std::atoi(value.c_str());
+            if (v < opt.minValue) v = opt.minValue;
+            if (v > opt.maxValue) v = opt.maxValue;
+            ai.params.*(opt.field) = v;
+            ai.initReductions();
+            return;
+        }
+    }
+
+    // Long-lived search thread: sleeps on a condition variable between searches and searches
+    // the loop's own board, which is only touched again once the worker is idle. go perft
+    // runs here too, so the loop keeps answering isready and stop meanwhile.
+    class SearchWorker {
+    public:
+        explicit SearchWorker(ChessAI& ai) : ai(ai), board(nullptr), turn(WHITE), depth(0), perftDepth(0),
+                                             searching(false), quit(false) {
+            thread = std::thread(&SearchWorker::idleLoop, this);
+        }
+
+        ~SearchWorker() {
+            stop();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                quit = true;
+            }
+            cv.notify_all();
+            thread.join();
+        }
+
+        void start(Board& b, Color c, int d) {
+            std::lock_guard<std::mutex> lock(mutex);
+            board = &b;
+            turn = c;
+            depth = d;
+            perftDepth = 0;
+            searching = true;
+            cv.notify_all();
+        }
+
+        // Divide output for the board, printed when done; stop abandons it
+        void startPerft(Board& b, Color c, int d) {
+            std::lock_guard<std::mutex> lock(mutex);
+            board = &b;
+            turn = c;
+            perftDepth = d;
+            ai.stopSearch = false;
+            searching = true;
+            cv.notify_all();
+        }
+
+        // Returns once bestmove has been printed. The flag is raised again on every wake-up
+        // because a search that has not started yet clears it on entry.
+        void stop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (searching) {
+                ai.stopSearch = true;
+                cv.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+
+    private:
+        void idleLoop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                cv.wait(lock, [this]() { return searching || quit; });
+                if (quit) return;
+                lock.unlock();
+                if (perftDepth > 0) {
+                    PerftTable table;
+                    int threads = std::max(1, (int)std::thread::hardware_concurrency());
+                    perftDivide(*board, turn, perftDepth, threads, &table, &ai.stopSearch);
+                } else {
+                    Move best = ai.getBestMove(*board, turn, depth);
+                    std::cout << "bestmove " << UCI::moveToString(best) << std::endl;
+                }
+                lock.lock();
+                searching = false;
+                cv.notify_all();
+            }
+        }
+
+        ChessAI& ai;
+        Board* board;
+        Color turn;
+        int depth;
+        int perftDepth;
+        bool searching;
+        bool quit;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::thread thread;
+    };
+
+    // Lines read from stdin by the reader thread, handed to the loop in order
+    class CommandQueue {
+    public:
+        void push(const std::string& line) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                lines.push_back(line);
+            }
+            cv.notify_one();
+        }
+
+        std::string pop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return !lines.empty(); });
+            std::string line = lines.front();
+            lines.pop_front();
+            return line;
+        }
+
+    private:
+        std::deque<std::string> lines;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+}
 
 std::string UCI::moveToString(const Move& m) {
     std::string s = "";
@@ -21,28 +225,65 @@ std::string UCI::moveToString(const Move& m) {
 }
 
 Move UCI::parseMove(Board& board, Color color, const std::string& moveStr) {
-    Board::MoveList moves;
-    board.generateLegalMoves(color, moves);
-    for (const Move& m : moves) {
-        if (moveToString(m) == moveStr) {
-            return m;
+    const Move none(0,0,0,0);
+    if (moveStr.size() != 4 && moveStr.size() != 5) return none;
+    int fromY = moveStr[0] - 'a', fromX = moveStr[1] - '1';
+    int toY = moveStr[2] - 'a', toX = moveStr[3] - '1';
+    if (fromY < 0 || fromY > 7 || fromX < 0 || fromX > 7 || toY < 0 || toY > 7 || toX < 0 || toX > 7) return none;
+    
+    PieceType promotion = EMPTY;
+    if (moveStr.size() == 5) {
+        switch (moveStr[4]) {
+            case 'q': promotion = QUEEN; break;
+            case 'r': promotion = ROOK; break;
+            case 'b': promotion = BISHOP; break;
+            case 'n': promotion = KNIGHT; break;
+            default: return none;
         }
     }
-    return Move(0,0,0,0);
+    
+    // The flags follow from the piece: a king moving two files castles, a pawn moving
+    // diagonally onto an empty square captures en passant
+    Piece p = board.getPiece(fromX, fromY);
+    bool castle = p.type == KING && std::abs(toY - fromY) == 2;
+    bool enPassant = p.type == PAWN && toY != fromY && board.getPiece(toX, toY).type == EMPTY;
+    Move m(fromX, fromY, toX, toY, promotion, enPassant, castle);
+    
+    bool valid = color == WHITE ? board.isPseudoLegal<WHITE>(m) && board.isLegal<WHITE>(m)
+                                : board.isPseudoLegal<BLACK>(m) && board.isLegal<BLACK>(m);
+    return valid ? m : none;
 }
 
 void UCI::loop() {
-    std::string line;
     Board board;
     ChessAI ai;
     Color turn = WHITE;
+    // Base ("startpos" or a FEN) and moves of the position the board currently holds
+    std::string positionBase;
+    std::vector<std::string> positionMoves;
     
-    std::thread searchThread;
+    SearchWorker worker(ai);
+    CommandQueue queue;
     
-    std::setvbuf(stdin, NULL, _IONBF, 0);
     std::setvbuf(stdout, NULL, _IONBF, 0);
     
-    while (std::getline(std::cin, line)) {
+    // stop and quit raise the flag as soon as they are read, so a search ends promptly even
+    // while the loop is still busy with earlier commands. EOF counts as quit.
+    std::thread reader([&ai, &queue]() {
+        std::string input;
+        while (std::getline(std::cin, input)) {
+            std::istringstream iss(input);
+            std::string command;
+            iss >> command;
+            if (command == "stop" || command == "quit") ai.stopSearch = true;
+            queue.push(input);
+            if (command == "quit") return;
+        }
+        queue.push("quit");
+    });
+    
+    while (true) {
+        std::string line = queue.pop();
         std::istringstream iss(line);
         std::string command;
         iss >> command;
@@ -50,54 +291,83 @@ void UCI::loop() {
         if (command == "uci") {
             std::cout << "id name Chess-Player-AI" << std::endl;
             std::cout << "id author Harsh Gupta" << std::endl;
+            printOptions(ai);
             std::cout << "uciok" << std::endl;
         }
         else if (command == "isready") {
             std::cout << "readyok" << std::endl;
         }
+        else if (command == "setoption") {
+            worker.stop();
+            
+            // setoption name <id> [value <x>]
+            std::string token, name, value;
+            iss >> token;
+            while (iss >> token && token != "value") {
+                name += (name.empty() ? "" : " ") + token;
+            }
+            // The value is the rest of the line, so paths may contain spaces
+            std::getline(iss >> std::ws, value);
+            value.erase(value.find_last_not_of(" \t\r") + 1);
+            setOption(ai, name, value);
+        }
         else if (command == "ucinewgame") {
-            ai.stopSearch = true;
-            if (searchThread.joinable()) searchThread.join();
+            worker.stop();
             ai.tt.clear();
         }
         else if (command == "position") {
-            ai.stopSearch = true;
-            if (searchThread.joinable()) searchThread.join();
+            worker.stop();
             
-            std::string arg;
+            std::string arg, base;
             iss >> arg;
             if (arg == "startpos") {
-                board.setupBoard();
-                turn = WHITE;
+                base = arg;
                 iss >> arg;
             } else if (arg == "fen") {
-                std::string fen = "", token;
+                std::string token;
                 for (int i=0; i<6; i++) {
-                    if (iss >> token) fen += token + (i < 5 ? " " : "");
+                    if (iss >> token) base += token + (i < 5 ? " " : "");
                 }
-                turn = board.loadFEN(fen);
                 iss >> arg;
             }
             
+            std::vector<std::string> moves;
             if (arg == "moves") {
                 std::string moveStr;
-                while (iss >> moveStr) {
-                    Move m = parseMove(board, turn, moveStr);
-                    // Abort parsing if move is invalid to prevent board corruption
-                    if (m.fromX == 0 && m.fromY == 0 && m.toX == 0 && m.toY == 0 && m.promotion == EMPTY) break;
-                    board.makeMove(m);
-                    turn = (turn == WHITE) ? BLACK : WHITE;
+                while (iss >> moveStr) moves.push_back(moveStr);
+            }
+            
+            // GUIs resend the whole game every move: when it extends the position already on
+            // the board, only the new moves are played
+            size_t first = 0;
+            if (!base.empty() && base == positionBase && moves.size() >= positionMoves.size()
+                && std::equal(positionMoves.begin(), positionMoves.end(), moves.begin())) {
+                first = positionMoves.size();
+            } else {
+                if (base == "startpos") {
+                    board.setupBoard();
+                    turn = WHITE;
+                } else if (!base.empty()) {
+                    turn = board.loadFEN(base);
                 }
+                positionBase = base;
+                positionMoves.clear();
+            }
+            
+            for (size_t i = first; i < moves.size(); i++) {
+                Move m = parseMove(board, turn, moves[i]);
+                // Abort parsing if move is invalid to prevent board corruption
+                if (m.fromX == 0 && m.fromY == 0 && m.toX == 0 && m.toY == 0 && m.promotion == EMPTY) break;
+                board.makeMove(m);
+                turn = (turn == WHITE) ? BLACK : WHITE;
+                positionMoves.push_back(moves[i]);
             }
         }
         else if (command == "stop") {
-            ai.stopSearch = true;
-            if (searchThread.joinable()) searchThread.join();
+            worker.stop();
         }
         else if (command == "go") {
-            ai.stopSearch = true;
-            if (searchThread.joinable()) searchThread.join();
-            ai.stopSearch = false;
+            worker.stop();
             
             int depth = 4; // Default to 4 if absolutely no args are provided
             bool useTime = false;
@@ -106,10 +376,14 @@ void UCI::loop() {
             long long increment = 0;
             long long exactMovetime = 0;
             bool useExactMovetime = false;
+            long long nodes = 0;
             
             std::string arg;
+            int perftDepth = 0;
             while (iss >> arg) {
-                if (arg == "depth") { iss >> depth; }
+                if (arg == "perft") { iss >> perftDepth; }
+                else if (arg == "depth") { iss >> depth; }
+                else if (arg == "nodes") { iss >> nodes; }
                 else if (arg == "infinite") { infinite = true; }
                 else if (arg == "movetime") { iss >> exactMovetime; useExactMovetime = true; useTime = true; }
                 else if (arg == "wtime" && turn == WHITE) { iss >> timeRemaining; useTime = true; }
@@ -122,6 +396,12 @@ void UCI::loop() {
                 }
             }
             
+            // Move generation check: divide output instead of a bestmove
+            if (perftDepth > 0) {
+                worker.startPerft(board, turn, perftDepth);
+                continue;
+            }
+            
             if (infinite) {
                 ai.timeLimitMs = 1000000000; // Large arbitrary limit
                 depth = 64;
@@ -149,23 +429,18 @@ void UCI::loop() {
                 ai.timeLimitMs = 1000000000; // Practically infinite if no time limit
             }
             
-            // Pass copies to thread so main thread parsing doesn't interfere
-            Board threadBoard = board;
-            Color threadTurn = turn;
+            // A node budget alone searches as deep as it allows; it stops the search at the same
+            // point on every run, unlike a time limit
+            ai.nodeLimit = nodes > 0 ? nodes : std::numeric_limits<long long>::max();
+            if (nodes > 0 && depth == 4 && !useTime) depth = 64;
             
-            searchThread = std::thread([&ai, threadBoard, threadTurn, depth]() mutable {
-                Move best = ai.getBestMove(threadBoard, threadTurn, depth);
-                std::cout << "bestmove " << UCI::moveToString(best) << std::endl;
-            });
+            worker.start(board, turn, depth);
         }
         else if (command == "quit") {
-            ai.stopSearch = true;
-            if (searchThread.joinable()) searchThread.join();
+            worker.stop();
             break;
         }
     }
     
-    // Ensure thread is joined before exiting UCI loop (e.g. EOF)
-    ai.stopSearch = true;
-    if (searchThread.joinable()) searchThread.join();
+    reader.join();
 }
@@ -1,13 +1,18 @@
 #include "zobrist.h"
 #include "board.h"
 #include <random>
+#include <mutex>
+#include <utility>
 
 namespace Zobrist {
     unsigned long long pieceKeys[2][7][64];
     unsigned long long enPassantKeys[8];
     unsigned long long castleKeys[16];
     unsigned long long sideKey;
-    static bool initialized = false;
+    unsigned long long materialKeys[2][7][MAX_PIECE_COUNT];
+    unsigned long long cuckoo[CUCKOO_SIZE];
+    unsigned short cuckooMove[CUCKOO_SIZE];
+    static std::once_flag initFlag;
 
     unsigned long long random64() {
         static std::mt19937_64 rng(1337); // Fixed seed for reproducible hashes
@@ -15,9 +20,43 @@ namespace Zobrist {
         return dist(rng);
     }
 
-    void init() {
-        if (initialized) return;
-        initialized = true;
+    static void initCuckoo() {
+        for (int i = 0; i < CUCKOO_SIZE; i++) {
+            cuckoo[i] = 0;
+            cuckooMove[i] = 0;
+        }
+        
+        // 3668 reversible moves in total, comfortably below the table size
+        for (int c = 0; c < 2; c++) {
+            for (int p = KNIGHT; p <= KING; p++) {
+                for (int s1 = 0; s1 < 64; s1++) {
+                    Bitboard reach;
+                    switch (p) {
+                        case KNIGHT: reach = Attacks::knightAttacks[s1]; break;
+                        case BISHOP: reach = Attacks::getBishopAttacks(s1, 0); break;
+                        case ROOK:   reach = Attacks::getRookAttacks(s1, 0); break;
+                        case QUEEN:  reach = Attacks::getQueenAttacks(s1, 0); break;
+                        default:     reach = Attacks::kingAttacks[s1]; break;
+                    }
+                    for (int s2 = s1 + 1; s2 < 64; s2++) {
+                        if (!(reach & setBit(s2))) continue;
+                        unsigned long long key = pieceKeys[c][p][s1] ^ pieceKeys[c][p][s2] ^ sideKey;
+                        unsigned short move = (unsigned short)(s1 | (s2 << 6));
+                        // Cuckoo insertion: displace the occupant to its alternate slot until one is free
+                        int i = cuckooH1(key);
+                        while (true) {
+                            std::swap(cuckoo[i], key);
+                            std::swap(cuckooMove[i], move);
+                            if (key == 0) break;
+                            i = (i == cuckooH1(key)) ? cuckooH2(key) : cuckooH1(key);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    static void generateKeys() {
         for (int c = 0; c < 2; c++) {
             for (int p = 0; p < 7; p++) {
                 for (int s = 0; s < 64; s++) {
@@ -32,6 +71,19 @@ namespace Zobrist {
             castleKeys[i] = random64();
         }
         sideKey = random64();
+        for (int c = 0; c < 2; c++) {
+            for (int p = 0; p < 7; p++) {
+                for (int n = 0; n < MAX_PIECE_COUNT; n++) {
+                    materialKeys[c][p][n] = random64();
+                }
+            }
+        }
+        initCuckoo();
+    }
+
+    void init() {
+        // Search threads and tablebase workers may race to the first Board; the keys are drawn once
+        std::call_once(initFlag, generateKeys);
     }
 
     unsigned long long computeHash(const Board& board, Color turn) {
@@ -47,15 +99,10 @@ namespace Zobrist {
             }
         }
         
-        int castleState = 0;
-        if (board.gameState.whiteCanCastleKingside) castleState |= 1;
-        if (board.gameState.whiteCanCastleQueenside) castleState |= 2;
-        if (board.gameState.blackCanCastleKingside) castleState |= 4;
-        if (board.gameState.blackCanCastleQueenside) castleState |= 8;
-        h ^= castleKeys[castleState];
+        h ^= castleKeys[board.gameState.castlingRights];
         
-        if (board.gameState.hasEnPassant) {
-            h ^= enPassantKeys[board.gameState.enPassantY];
+        if (board.gameState.hasEnPassant()) {
+            h ^= enPassantKeys[board.gameState.epSquare % 8];
         }
         
         if (turn == BLACK) {
@@ -10,8 +10,19 @@ namespace Zobrist {
     extern unsigned long long enPassantKeys[8];
     extern unsigned long long castleKeys[16];
     extern unsigned long long sideKey;
+    // Material signature: a side with n pieces of a type contributes materialKeys[c][t][0..n-1]
+    const int MAX_PIECE_COUNT = 16;
+    extern unsigned long long materialKeys[2][7][MAX_PIECE_COUNT];
 
-    void init();
+    // Cuckoo hash of every reversible (non-pawn) piece move on an empty board, keyed by
+    // pieceKeys[from] ^ pieceKeys[to] ^ sideKey, for upcoming-repetition detection.
+    const int CUCKOO_SIZE = 8192;
+    extern unsigned long long cuckoo[CUCKOO_SIZE];
+    extern unsigned short cuckooMove[CUCKOO_SIZE]; // fromSq | (toSq << 6)
+    inline int cuckooH1(unsigned long long key) { return (int)(key & (CUCKOO_SIZE - 1)); }
+    inline int cuckooH2(unsigned long long key) { return (int)((key >> 16) & (CUCKOO_SIZE - 1)); }
+
+    void init(); // Thread-safe; generates the keys on the first call only
     unsigned long long computeHash(const Board& board, Color turn);
 }
 